@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "assets/assets.h"
 #include "logic/pakfile.h"
+#include "logic/compactor.h"
 
 const char startupVersion[] = {
     "RePak - Built "
@@ -18,7 +19,49 @@ int main(int argc, char** argv)
         Error("invalid usage\n");
 
     CPakFile pakFile(8);
-    pakFile.BuildFromMap(argv[1]);
+
+    // -compact: remove unreferenced data from the starpaks of the given rpaks instead of building
+    bool compact = false;
+    // -compactshared: with -compact, also compact starpaks that other rpaks or the game wrote
+    bool compactShared = false;
+
+    std::vector<std::string> inputPaths;
+    for (int i = 1; i < argc; ++i)
+    {
+        // -j N: build assets on N worker threads (0 = one per hardware thread)
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            int numThreads = atoi(argv[++i]);
+
+            if (numThreads <= 0)
+                numThreads = std::thread::hardware_concurrency();
+
+            if (numThreads <= 0)
+                numThreads = 1;
+
+            pakFile.SetNumThreads(numThreads);
+        }
+        // -stream: write page data to disk as soon as it is final to bound memory usage
+        else if (!strcmp(argv[i], "-stream"))
+            pakFile.AddFlags(PF_STREAM_PAGES);
+        // -directio: write the output files without going through the system file cache
+        else if (!strcmp(argv[i], "-directio"))
+            pakFile.AddFlags(PF_DIRECT_IO);
+        else if (!strcmp(argv[i], "-compact"))
+            compact = true;
+        else if (!strcmp(argv[i], "-compactshared"))
+            compactShared = true;
+        else
+            inputPaths.push_back(argv[i]);
+    }
+
+    if (inputPaths.empty() || (!compact && inputPaths.size() > 1))
+        Error("invalid usage\n");
+
+    if (compact)
+        Compactor::CompactStarpaks(&pakFile, inputPaths, compactShared);
+    else
+        pakFile.BuildFromMap(inputPaths[0]);
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
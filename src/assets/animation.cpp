@@ -33,13 +33,10 @@ void Assets::AddAnimSeqAsset_v7(CPakFile* pak, std::vector<RPakAssetEntry>* asse
 
     // begin rseq input
     BinaryIO rseqInput;
-    rseqInput.open(rseqFilePath, BinaryIOMode::Read);
-
-    // go back to the beginning of the file to read all the data
-    rseqInput.seek(0);
+    rseqInput.open(rseqFilePath, BinaryIOMode::Read, BIO_MAPPED);
 
     // write the rseq data into the data buffer
-    rseqInput.getReader()->read(pDataBuf + fileNameDataSize, rseqFileSize);
+    rseqInput.readBytes(pDataBuf + fileNameDataSize, rseqFileSize);
     rseqInput.close();
 
     mstudioseqdesc_t seqdesc = *reinterpret_cast<mstudioseqdesc_t*>(pDataBuf + fileNameDataSize);
@@ -59,6 +56,7 @@ void Assets::AddAnimSeqAsset_v7(CPakFile* pak, std::vector<RPakAssetEntry>* asse
     pak->AddPointer(subhdrinfo.index, offsetof(AnimSequenceHeader, data));
 
     std::vector<RPakGuidDescriptor> guids{};
+    std::vector<RPakAssetDependency> dependencies{};
 
     rmem dataBuf(pDataBuf);
     dataBuf.seek(fileNameDataSize + seqdesc.autolayerindex, rseekdir::beg);
@@ -73,10 +71,8 @@ void Assets::AddAnimSeqAsset_v7(CPakFile* pak, std::vector<RPakAssetEntry>* asse
         if (autolayer->guid != 0)
             pak->AddGuidDescriptor(&guids, dataseginfo.index, dataBuf.getPosition() + offsetof(mstudioautolayer_t, guid));
 
-        RPakAssetEntry* asset = pak->GetAssetByGuid(autolayer->guid);
-
-        if (asset)
-            asset->AddRelation(assetEntries->size());
+        if (autolayer->guid != 0)
+            dependencies.push_back(autolayer->guid);
     }
 
     RPakRawDataBlock shdb{ subhdrinfo.index, subhdrinfo.size, (uint8_t*)pHdr };
@@ -96,6 +92,7 @@ void Assets::AddAnimSeqAsset_v7(CPakFile* pak, std::vector<RPakAssetEntry>* asse
     asset.unk1 = 2;
 
     asset.AddGuids(&guids);
+    asset.AddDependencies(&dependencies);
 
     assetEntries->push_back(asset);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #define RMDL_VERSION 10
 #define MATL_VERSION 15
 
+struct TextureStreamingLimits;
+
 namespace Assets
 {
 	//void AddTextureAsset(std::vector<RPakAssetEntryV7>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry);
@@ -25,4 +27,7 @@ namespace Assets
 	void AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry);
 	void AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry);
 	void AddAnimSeqAsset_v7(CPakFile* pak, std::vector<RPakAssetEntry>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry);
+
+	bool GetTextureStreamingLimits(CPakFile* pak, const char* assetPath, rapidjson::Value& mapEntry, TextureStreamingLimits& limits);
+	bool FindTextureSource(CPakFile* pak, const char* assetPath, std::string& filePath);
 };
@@ -173,6 +173,8 @@ void Assets::AddDataTableAsset_v0(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
     char* stringEntryBuf = new char[stringEntriesSize];
 
+    uint32_t nextStringEntryOffset = 0;
+
     for (size_t rowIdx = 0; rowIdx < rowCount - 1; ++rowIdx)
     {
         for (size_t colIdx = 0; colIdx < columnCount; ++colIdx)
@@ -237,8 +239,6 @@ void Assets::AddDataTableAsset_v0(CPakFile* pak, std::vector<RPakAssetEntry>* as
             case dtblcoltype_t::Asset:
             case dtblcoltype_t::AssetNoPrecache:
             {
-                static uint32_t nextStringEntryOffset = 0;
-
                 RPakPtr stringPtr{ stringsinfo.index, nextStringEntryOffset };
 
                 std::string val = doc.GetCell<std::string>(colIdx, rowIdx);
@@ -397,6 +397,8 @@ void Assets::AddDataTableAsset_v1(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
     char* stringEntryBuf = new char[stringEntriesSize];
 
+    uint32_t nextStringEntryOffset = 0;
+
     for (size_t rowIdx = 0; rowIdx < rowCount - 1; ++rowIdx)
     {
         for (size_t colIdx = 0; colIdx < columnCount; ++colIdx)
@@ -461,8 +463,6 @@ void Assets::AddDataTableAsset_v1(CPakFile* pak, std::vector<RPakAssetEntry>* as
             case dtblcoltype_t::Asset:
             case dtblcoltype_t::AssetNoPrecache:
             {
-                static uint32_t nextStringEntryOffset = 0;
-
                 RPakPtr stringPtr{ stringsinfo.index, nextStringEntryOffset };
 
                 std::string val = doc.GetCell<std::string>(colIdx, rowIdx);
@@ -169,6 +169,7 @@ void Assets::AddMaterialAsset_v12(CPakFile* pak, std::vector<RPakAssetEntry>* as
     size_t guidPageOffset = sAssetPath.length() + 1 + assetPathAlignment;
 
     std::vector<RPakGuidDescriptor> guids{};
+    std::vector<RPakAssetDependency> dependencies{};
 
     int textureIdx = 0;
     int fileRelationIdx = -1;
@@ -180,12 +181,7 @@ void Assets::AddMaterialAsset_v12(CPakFile* pak, std::vector<RPakAssetEntry>* as
             *(uint64_t*)dataBuf = textureGUID;
             pak->AddGuidDescriptor(&guids, dataseginfo.index, guidPageOffset + (textureIdx * sizeof(uint64_t))); // Register GUID descriptor for current texture index.
 
-            RPakAssetEntry* txtrAsset = pak->GetAssetByGuid(textureGUID, nullptr);
-
-            if (txtrAsset)
-                txtrAsset->AddRelation(assetEntries->size());
-            else
-                Warning("unable to find texture '%s' for material '%s' within the local assets\n", it.GetString(), assetPath);
+            dependencies.push_back({ textureGUID, it.GetStdString() });
 
             assetUsesCount++;
         }
@@ -539,10 +535,7 @@ void Assets::AddMaterialAsset_v12(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
     if (mtlHdr->ShaderSetGUID != 0)
     {
-        RPakAssetEntry* asset = pak->GetAssetByGuid(mtlHdr->ShaderSetGUID);
-
-        if (asset)
-            asset->AddRelation(assetEntries->size());
+        dependencies.push_back(mtlHdr->ShaderSetGUID);
     }
 
     // Is this a colpass asset?
@@ -565,10 +558,7 @@ void Assets::AddMaterialAsset_v12(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
         if (guid != 0)
         {
-            RPakAssetEntry* asset = pak->GetAssetByGuid(guid);
-
-            if (asset)
-                asset->AddRelation(assetEntries->size());
+            dependencies.push_back(guid);
         }
     }
 
@@ -684,6 +674,7 @@ void Assets::AddMaterialAsset_v12(CPakFile* pak, std::vector<RPakAssetEntry>* as
     asset.unk1 = assetUsesCount + 1;
 
     asset.AddGuids(&guids);
+    asset.AddDependencies(&dependencies);
 
     assetEntries->push_back(asset);
 }
@@ -767,6 +758,7 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
     size_t guidPageOffset = sAssetPath.length() + 1 + assetPathAlignment;
 
     std::vector<RPakGuidDescriptor> guids{};
+    std::vector<RPakAssetDependency> dependencies{};
 
     int textureIdx = 0;
     for (auto& it : mapEntry["textures"].GetArray()) // Now we setup the first TextureGUID Map.
@@ -777,12 +769,7 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
             *(uint64_t*)dataBuf = textureGUID;
             pak->AddGuidDescriptor(&guids, dataseginfo.index, guidPageOffset + (textureIdx * sizeof(uint64_t))); // Register GUID descriptor for current texture index.
 
-            RPakAssetEntry* txtrAsset = pak->GetAssetByGuid(textureGUID, nullptr);
-
-            if (txtrAsset)
-                txtrAsset->AddRelation(assetEntries->size());
-            else
-                Warning("unable to find texture '%s' for material '%s' within the local assets\n", it.GetString(), assetPath);
+            dependencies.push_back({ textureGUID, it.GetStdString() });
 
             assetUsesCount++;
         }
@@ -868,10 +855,7 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
     if (mtlHdr->m_pShaderSet != 0)
     {
-        RPakAssetEntry* asset = pak->GetAssetByGuid(mtlHdr->m_pShaderSet);
-
-        if (asset)
-            asset->AddRelation(assetEntries->size());
+        dependencies.push_back(mtlHdr->m_pShaderSet);
     }
 
     // Is this a colpass asset?
@@ -893,10 +877,7 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
         if (guid != 0)
         {
-            RPakAssetEntry* asset = pak->GetAssetByGuid(guid);
-
-            if (asset)
-                asset->AddRelation(assetEntries->size());
+            dependencies.push_back(guid);
         }
     }
 
@@ -937,8 +918,9 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
 
         dxStaticBuf = new char[dxStaticBufSize];
 
-        std::ifstream cpuIn(cpuPath, std::ios::in | std::ios::binary);
-        cpuIn.read(dxStaticBuf, dxStaticBufSize);
+        BinaryIO cpuIn;
+        cpuIn.open(cpuPath, BinaryIOMode::Read, BIO_MAPPED);
+        cpuIn.readBytes(dxStaticBuf, dxStaticBufSize);
         cpuIn.close();
     }
     else {
@@ -1021,6 +1003,7 @@ void Assets::AddMaterialAsset_v15(CPakFile* pak, std::vector<RPakAssetEntry>* as
     asset.unk1 = bColpass ? 7 : 8; // what
 
     asset.AddGuids(&guids);
+    asset.AddDependencies(&dependencies);
 
     assetEntries->push_back(asset);
 }
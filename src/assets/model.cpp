@@ -30,10 +30,16 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
     REQUIRE_FILE(vgFilePath);
 
     // begin rmdl input
+    // the source files are mapped and their headers are parsed in place
     BinaryIO rmdlInput;
-    rmdlInput.open(rmdlFilePath, BinaryIOMode::Read);
+    rmdlInput.open(rmdlFilePath, BinaryIOMode::Read, BIO_MAPPED);
 
-    studiohdr_t mdlhdr = rmdlInput.read<studiohdr_t>();
+    const studiohdr_t* pStudioHdr = rmdlInput.view<studiohdr_t>();
+
+    if (!pStudioHdr)
+        Error("invalid file size for model asset '%s'. file is smaller than its header\n", sAssetName.c_str());
+
+    const studiohdr_t& mdlhdr = *pStudioHdr;
 
     if (mdlhdr.id != 0x54534449) // "IDST"
         Error("invalid file magic for model asset '%s'. expected %x, found %x\n", sAssetName.c_str(), 0x54534449, mdlhdr.id);
@@ -41,27 +47,27 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
     if (mdlhdr.version != 54)
         Error("invalid version for model asset '%s'. expected %i, found %i\n", sAssetName.c_str(), 54, mdlhdr.version);
 
+    if (mdlhdr.length > rmdlInput.getSize())
+        Error("invalid file size for model asset '%s'. expected %i bytes, found %lld\n", sAssetName.c_str(), mdlhdr.length, rmdlInput.getSize());
+
     ///--------------------
     // Add VG data
     BinaryIO vgInput;
-    vgInput.open(vgFilePath, BinaryIOMode::Read);
+    vgInput.open(vgFilePath, BinaryIOMode::Read, BIO_MAPPED);
 
-    BasicRMDLVGHeader bvgh = vgInput.read<BasicRMDLVGHeader>();
+    const BasicRMDLVGHeader* pVGHdr = vgInput.view<BasicRMDLVGHeader>();
 
-    if (bvgh.magic != 0x47567430)
-        Error("invalid vg file magic for model asset '%s'. expected %x, found %x\n", sAssetName.c_str(), 0x47567430, bvgh.magic);
+    if (!pVGHdr)
+        Error("invalid vg file size for model asset '%s'. file is smaller than its header\n", sAssetName.c_str());
 
-    if (bvgh.version != 1)
-        Error("invalid vg version for model asset '%s'. expected %i, found %i\n", sAssetName.c_str(), 1, bvgh.version);
+    if (pVGHdr->magic != 0x47567430)
+        Error("invalid vg file magic for model asset '%s'. expected %x, found %x\n", sAssetName.c_str(), 0x47567430, pVGHdr->magic);
 
-    vgInput.seek(0, std::ios::end);
+    if (pVGHdr->version != 1)
+        Error("invalid vg version for model asset '%s'. expected %i, found %i\n", sAssetName.c_str(), 1, pVGHdr->version);
 
-    uint32_t vgFileSize = vgInput.tell();
-    char* pVGBuf = new char[vgFileSize];
-
-    vgInput.seek(0);
-    vgInput.getReader()->read(pVGBuf, vgFileSize);
-    vgInput.close();
+    // the vg data itself is copied from the source file when the starpak entry is written
+    uint32_t vgFileSize = vgInput.getSize();
 
     //
     // Physics
@@ -72,16 +78,13 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
     if (mapEntry.HasMember("usePhysics") && mapEntry["usePhysics"].GetBool())
     {
         BinaryIO phyInput;
-        phyInput.open(phyFilePath, BinaryIOMode::Read);
-
-        phyInput.seek(0, std::ios::end);
+        phyInput.open(phyFilePath, BinaryIOMode::Read, BIO_MAPPED);
 
-        phyFileSize = phyInput.tell();
+        phyFileSize = phyInput.getSize();
 
         phyBuf = new char[phyFileSize];
 
-        phyInput.seek(0);
-        phyInput.getReader()->read(phyBuf, phyFileSize);
+        phyInput.readBytes(phyBuf, phyFileSize);
         phyInput.close();
     }
 
@@ -90,6 +93,8 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
     //
     char* pAnimRigBuf = nullptr;
 
+    std::vector<RPakAssetDependency> dependencies{};
+
     if (mapEntry.HasMember("animrigs"))
     {
         if (!mapEntry["animrigs"].IsArray())
@@ -114,34 +119,13 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
 
             arigBuf.write<uint64_t>(guid);
 
-            // check if anim rig is a local asset so that the relation can be added
-            RPakAssetEntry* asset = pak->GetAssetByGuid(guid);
-
-            if (asset)
-                asset->AddRelation(assetEntries->size());
+            // if the anim rig is a local asset, the relation gets added once all assets are known
+            dependencies.push_back({ guid, it.GetStdString() });
 
             i++;
         }
     }
 
-    //
-    // Starpak
-    //
-    std::string starpakPath = pak->GetPrimaryStarpakPath();
-
-    if (mapEntry.HasMember("starpakPath") && mapEntry["starpakPath"].IsString())
-        starpakPath = mapEntry["starpakPath"].GetStdString();
-
-    if (starpakPath.length() == 0)
-        Error("attempted to add asset '%s' as a streaming asset, but no starpak files were available.\n-- to fix: add 'starpakPath' as an rpak-wide variable\n-- or: add 'starpakPath' as an asset specific variable\n", assetPath);
-
-    pak->AddStarpakReference(starpakPath);
-
-    StreamableDataEntry de{ 0, vgFileSize, (uint8_t*)pVGBuf };
-    de = pak->AddStarpakDataEntry(de);
-
-    pHdr->alignedStreamingSize = de.m_nDataSize;
-
     size_t extraDataSize = 0;
 
     if (mdlhdr.flags & 0x10) // STATIC_PROP
@@ -157,21 +141,33 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
     snprintf(pDataBuf + mdlhdr.length, fileNameDataSize, "%s", sAssetName.c_str());
 
     // copy rmdl data into data buffer
-    {
-        // go back to the beginning of the file to read all the data
-        rmdlInput.seek(0);
-
-        // write the skeleton data into the data buffer
-        rmdlInput.getReader()->read(pDataBuf, mdlhdr.length);
-        rmdlInput.close();
-    }
+    // this is the only copy of the rmdl that is made, as material guids get patched in it below
+    memcpy_s(pDataBuf, mdlhdr.length, rmdlInput.getData(), mdlhdr.length);
 
     // copy static prop data into data buffer (if needed)
     if (mdlhdr.flags & 0x10) // STATIC_PROP
     {
-        memcpy_s(pDataBuf + fileNameDataSize + mdlhdr.length, vgFileSize, de.m_nDataPtr, vgFileSize);
+        memcpy_s(pDataBuf + fileNameDataSize + mdlhdr.length, vgFileSize, vgInput.getData(), vgFileSize);
     }
 
+    vgInput.close();
+
+    //
+    // Starpak
+    //
+    std::string starpakPath = pak->GetPrimaryStarpakPath();
+
+    if (mapEntry.HasMember("starpakPath") && mapEntry["starpakPath"].IsString())
+        starpakPath = mapEntry["starpakPath"].GetStdString();
+
+    if (starpakPath.length() == 0)
+        Error("attempted to add asset '%s' as a streaming asset, but no starpak files were available.\n-- to fix: add 'starpakPath' as an rpak-wide variable\n-- or: add 'starpakPath' as an asset specific variable\n", assetPath);
+
+    StreamableDataEntry de{ 0, vgFileSize, nullptr, vgFilePath, { { 0, vgFileSize } } };
+    de = pak->AddStarpakDataEntry(de, starpakPath);
+
+    pHdr->alignedStreamingSize = de.GetPaddedSize();
+
     // Segments
     // asset header
     _vseginfo_t subhdrinfo = pak->CreateNewSegment(sizeof(ModelHeader), SF_HEAD, 16);
@@ -252,10 +248,8 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
         if (material->guid != 0)
             pak->AddGuidDescriptor(&guids, dataseginfo.index, dataBuf.getPosition() + offsetof(materialref_t, guid));
 
-        RPakAssetEntry* asset = pak->GetAssetByGuid(material->guid);
-
-        if (asset)
-            asset->AddRelation(assetEntries->size());
+        if (material->guid != 0)
+            dependencies.push_back(material->guid);
     }
 
     RPakRawDataBlock shdb{ subhdrinfo.index, subhdrinfo.size, (uint8_t*)pHdr };
@@ -282,13 +276,17 @@ void Assets::AddModelAsset_v9(CPakFile* pak, std::vector<RPakAssetEntry>* assetE
 
     RPakAssetEntry asset;
 
-    asset.InitAsset(RTech::StringToGuid(sAssetName.c_str()), subhdrinfo.index, 0, subhdrinfo.size, -1, 0, de.m_nOffset, -1, (std::uint32_t)AssetType::RMDL);
+    asset.InitAsset(RTech::StringToGuid(sAssetName.c_str()), subhdrinfo.index, 0, subhdrinfo.size, -1, 0, de.GetAssetOffset(), -1, (std::uint32_t)AssetType::RMDL);
     asset.version = RMDL_VERSION;
     // i have literally no idea what these are
     asset.pageEnd = lastPageIdx + 1;
     asset.unk1 = 2;
 
     asset.AddGuids(&guids);
+    asset.AddDependencies(&dependencies);
 
     assetEntries->push_back(asset);
+
+    // mdlhdr points into the mapped rmdl, so it can only be unmapped now
+    rmdlInput.close();
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "assets.h"
 #include "utils/dxutils.h"
+#include "utils/imageloader.h"
 #include "public/texture.h"
 
 void Assets::AddUIImageAsset_v10(CPakFile* pak, std::vector<RPakAssetEntry>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry)
@@ -55,29 +56,52 @@ void Assets::AddUIImageAsset_v10(CPakFile* pak, std::vector<RPakAssetEntry>* ass
     }
 
     // get the info for the ui atlas image
-    std::string sAtlasFilePath = pak->GetAssetPath() + mapEntry["atlas"].GetStdString() + ".dds";
     std::string sAtlasAssetName = mapEntry["atlas"].GetStdString() + ".rpak";
     uint64_t atlasGuid = RTech::StringToGuid(sAtlasAssetName.c_str());
 
-    // get the txtr asset that this asset is using
-    RPakAssetEntry* atlasAsset = pak->GetAssetByGuid(atlasGuid, nullptr);
+    uint32_t nTexturesCount = mapEntry["textures"].GetArray().Size();
 
-    if (!atlasAsset)
-        Error("Atlas asset was not found when trying to add uimg asset '%s'. Make sure that the txtr is above the uimg in your map file. Exiting...\n", assetPath);
+    // the atlas is found the same way as the source of the atlas txtr asset
+    std::string sAtlasFilePath;
+    bool bAtlasIsImage = Assets::FindTextureSource(pak, mapEntry["atlas"].GetString(), sAtlasFilePath);
 
-    uint32_t nTexturesCount = mapEntry["textures"].GetArray().Size();
+    if (!FILE_EXISTS(sAtlasFilePath))
+        Error("Failed to find atlas source file for uimg asset '%s' with atlas '%s'. Exiting...\n", assetPath, mapEntry["atlas"].GetString());
 
     // grab the dimensions of the atlas
-    BinaryIO atlas;
-    atlas.open(sAtlasFilePath, BinaryIOMode::Read);
-    atlas.seek(4, std::ios::beg);
-    DDS_HEADER ddsh = atlas.read<DDS_HEADER>();
+    uint32_t nAtlasWidth = 0;
+    uint32_t nAtlasHeight = 0;
+
+    if (bAtlasIsImage)
+    {
+        bool bMayHaveAlpha = false;
+
+        if (!ImageLoader::GetImageInfo(sAtlasFilePath, nAtlasWidth, nAtlasHeight, bMayHaveAlpha) || nAtlasWidth == 0 || nAtlasHeight == 0)
+            Error("Attempted to add uimg asset '%s' with atlas '%s' that was not a valid image file. Exiting...\n", assetPath, sAtlasFilePath.c_str());
+    }
+    else
+    {
+        BinaryIO atlas;
+
+        if (!atlas.open(sAtlasFilePath, BinaryIOMode::Read, BIO_MAPPED))
+            Error("Failed to open atlas '%s' for uimg asset '%s'. Exiting...\n", sAtlasFilePath.c_str(), assetPath);
 
-    atlas.close();
+        atlas.seek(4, std::ios::beg);
+
+        const DDS_HEADER* pDDSHeader = atlas.view<DDS_HEADER>();
+
+        if (!pDDSHeader)
+            Error("Attempted to add uimg asset '%s' with atlas '%s' that was not a valid DDS file (truncated header). Exiting...\n", assetPath, sAtlasFilePath.c_str());
+
+        nAtlasWidth = pDDSHeader->dwWidth;
+        nAtlasHeight = pDDSHeader->dwHeight;
+
+        atlas.close();
+    }
 
     UIImageHeader* pHdr = new UIImageHeader();
-    pHdr->width = ddsh.dwWidth;
-    pHdr->height = ddsh.dwHeight;
+    pHdr->width = nAtlasWidth;
+    pHdr->height = nAtlasHeight;
 
     pHdr->widthRatio = 1 / pHdr->width;
     pHdr->heightRatio = 1 / pHdr->height;
@@ -167,12 +191,6 @@ void Assets::AddUIImageAsset_v10(CPakFile* pak, std::vector<RPakAssetEntry>* ass
         //nextStringTableOffset += it["path"].GetStringLength();
     }
 
-    // add the file relation from this uimg asset to the atlas txtr
-    if (atlasAsset)
-        atlasAsset->AddRelation(assetEntries->size());
-    else
-        Warning("unable to find texture asset locally for uimg asset. assuming it is external...\n");
-
     char* pUVBuf = new char[nTexturesCount * sizeof(UIImageUV)];
     rmem uvBuf(pUVBuf);
 
@@ -212,6 +230,9 @@ void Assets::AddUIImageAsset_v10(CPakFile* pak, std::vector<RPakAssetEntry>* ass
     // this asset only has one guid reference so im just gonna do it here
     asset.AddGuid({ subhdrinfo.index, offsetof(UIImageHeader, atlasGUID) });
 
+    // add the file relation from this uimg asset to the atlas txtr, which has to be in this pak
+    asset.AddDependency({ atlasGuid, mapEntry["atlas"].GetStdString(), true });
+
     // add the asset entry
     assetEntries->push_back(asset);
 }
@@ -1,13 +1,431 @@
 #include "pch.h"
 #include "assets.h"
 #include "utils/dxutils.h"
+#include "utils/imageloader.h"
+#include "utils/bcencoder.h"
+#include "utils/mipgen.h"
 #include "public/texture.h"
 
+// number of mips that stay in the rpak when the texture is streamed, unless a budget says otherwise
+#define TXTR_DEFAULT_RESIDENT_MIPS 9
+
+// mip chain of a texture source, largest mip first like in a dds payload
+struct TextureSource
+{
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+
+    const uint8_t* pPayload = nullptr;
+    // offset of the payload in the source file and the size of the file, streamed mips are copied straight from there
+    uint64_t payloadOffset = 0;
+    uint64_t sourceSize = 0;
+
+    // payloads that were encoded during the build only exist here
+    std::vector<uint8_t> encodedPayload;
+
+    bool IsEncoded() const { return !encodedPayload.empty(); };
+};
+
+//-----------------------------------------------------------------------------
+// purpose: parses the headers of a mapped dds file
+//-----------------------------------------------------------------------------
+static void ParseDDSSource(BinaryIO& input, const char* assetPath, TextureSource& src)
+{
+    // headers are parsed in place from the mapped file
+    const int* pMagic = input.view<int>();
+
+    if (!pMagic || *pMagic != 0x20534444) // b'DDS '
+        Error("Attempted to add txtr asset '%s' that was not a valid DDS file (invalid magic). Exiting...\n", assetPath);
+
+    const DDS_HEADER* pDDSHeader = input.view<DDS_HEADER>();
+
+    if (!pDDSHeader)
+        Error("Attempted to add txtr asset '%s' that was not a valid DDS file (truncated header). Exiting...\n", assetPath);
+
+    const DDS_HEADER& ddsh = *pDDSHeader;
+
+    DXGI_FORMAT dxgiFormat;
+
+    switch (ddsh.ddspf.dwFourCC)
+    {
+    case '1TXD': // DXT1
+        dxgiFormat = DXGI_FORMAT_BC1_UNORM;
+        break;
+    case '3TXD': // DXT3
+        dxgiFormat = DXGI_FORMAT_BC2_UNORM;
+        break;
+    case '5TXD': // DXT5
+        dxgiFormat = DXGI_FORMAT_BC3_UNORM;
+        break;
+    case '1ITA':
+    case 'U4CB': // BC4U
+        dxgiFormat = DXGI_FORMAT_BC4_UNORM;
+        break;
+    case 'S4CB':
+        dxgiFormat = DXGI_FORMAT_BC4_SNORM;
+        break;
+    case '2ITA': // ATI2
+    case 'U5CB': // BC5U
+        dxgiFormat = DXGI_FORMAT_BC5_UNORM;
+        break;
+    case 'S5CB': // BC5S
+        dxgiFormat = DXGI_FORMAT_BC5_SNORM;
+        break;
+    case '01XD': // DX10
+        dxgiFormat = DXGI_FORMAT_UNKNOWN;
+        break;
+    // legacy format codes
+    case 36:
+        dxgiFormat = DXGI_FORMAT_R16G16B16A16_UNORM;
+        break;
+    case 110:
+        dxgiFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+        break;
+    case 111:
+        dxgiFormat = DXGI_FORMAT_R16_FLOAT;
+        break;
+    case 112:
+        dxgiFormat = DXGI_FORMAT_R16G16_FLOAT;
+        break;
+    case 113:
+        dxgiFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        break;
+    case 114:
+        dxgiFormat = DXGI_FORMAT_R32_FLOAT;
+        break;
+    case 115:
+        dxgiFormat = DXGI_FORMAT_R32G32_FLOAT;
+        break;
+    case 116:
+        dxgiFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
+        break;
+    default:
+        dxgiFormat = dxutils::GetFormatFromHeader(ddsh);
+        
+        if(dxgiFormat == DXGI_FORMAT_UNKNOWN)
+            Error("Attempted to add txtr asset '%s' that was not using a supported DDS type. Exiting...\n", assetPath);
+        
+        break;
+    }
+
+    // Go to the end of the main header.
+    input.seek(ddsh.dwSize + 4);
+
+    // this is used for some math later
+    uint32_t nDDSHeaderSize = ddsh.dwSize + 4;
+
+    // Go to the end of the DX10 header if it exists.
+    if (ddsh.ddspf.dwFourCC == '01XD')
+    {
+        const DDS_HEADER_DXT10* pDX10Header = input.view<DDS_HEADER_DXT10>();
+
+        if (!pDX10Header)
+            Error("Attempted to add txtr asset '%s' that was not a valid DDS file (truncated DX10 header). Exiting...\n", assetPath);
+
+        dxgiFormat = pDX10Header->dxgiFormat;
+
+        nDDSHeaderSize += 20;
+    }
+
+    src.format = dxgiFormat;
+    src.width = ddsh.dwWidth;
+    src.height = ddsh.dwHeight;
+    src.mipCount = ddsh.dwMipMapCount > 0 ? ddsh.dwMipMapCount : 1;
+
+    src.pPayload = input.getData() + nDDSHeaderSize;
+    src.payloadOffset = nDDSHeaderSize;
+    src.sourceSize = input.getSize();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: finds the source file of a texture, dds files are preferred over images
+// returns: true if the source is an uncompressed image that has to be encoded
+//-----------------------------------------------------------------------------
+bool Assets::FindTextureSource(CPakFile* pak, const char* assetPath, std::string& filePath)
+{
+    filePath = pak->GetAssetPath() + assetPath + ".dds";
+
+    if (FILE_EXISTS(filePath))
+        return false;
+
+    for (const char* ext : ImageLoader::s_SourceImageExtensions)
+    {
+        std::string imagePath = pak->GetAssetPath() + assetPath + "." + ext;
+
+        if (FILE_EXISTS(imagePath))
+        {
+            filePath = imagePath;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool ShouldGenerateMips(rapidjson::Value& mapEntry)
+{
+    return !mapEntry.HasMember("generateMips") || mapEntry["generateMips"].GetBool();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the format that an image source is encoded into
+//-----------------------------------------------------------------------------
+static DXGI_FORMAT GetImageSourceFormat(const char* assetPath, rapidjson::Value& mapEntry, bool hasAlpha)
+{
+    // without a format on the map entry, images with alpha get bc3 and everything else bc1
+    DXGI_FORMAT dxgiFormat = hasAlpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+
+    if (mapEntry.HasMember("format"))
+    {
+        if (!mapEntry["format"].IsString())
+            Error("found field 'format' on txtr asset '%s' with invalid type. expected 'string'\n", assetPath);
+
+        dxgiFormat = dxutils::GetFormatFromString(mapEntry["format"].GetStdString());
+
+        if (dxgiFormat == DXGI_FORMAT_UNKNOWN)
+            Error("Attempted to add txtr asset '%s' with unknown format '%s'. Exiting...\n", assetPath, mapEntry["format"].GetString());
+    }
+
+    if (!BCEncoder::IsFormatSupported(dxgiFormat))
+        Error("Attempted to add txtr asset '%s' with format '%s', which can't be encoded from an image. Use a DDS source for this format. Exiting...\n", assetPath, dxutils::GetFormatAsString(dxgiFormat).c_str());
+
+    return dxgiFormat;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: works out which mips of a texture may be streamed and how many stay
+//          in the rpak by default, taking 'disableStreaming' and 'maxResidentBytes'
+//          from the map entry into account
+//-----------------------------------------------------------------------------
+static void GetStreamingLimits(DXGI_FORMAT dxgiFormat, uint32_t width, uint32_t height, uint32_t mipCount, bool bEncoded, const char* assetPath, rapidjson::Value& mapEntry, TextureStreamingLimits& limits)
+{
+    limits.mipSizes.clear();
+    limits.minResidentMips = mipCount > 0 ? 1 : 0;
+
+    for (uint32_t ml = 0; ml < mipCount; ml++)
+    {
+        uint32_t nMipSize = dxutils::GetMipSize(dxgiFormat, width, height, ml);
+
+        // streamed mips of a dds are copied straight from the source file, so there is nothing
+        // to add the alignment padding to. this mip and all smaller ones have to stay in the rpak
+        if (!bEncoded && nMipSize != IALIGN16(nMipSize) && mipCount - ml > limits.minResidentMips)
+            limits.minResidentMips = mipCount - ml;
+
+        limits.mipSizes.push_back(IALIGN16(nMipSize));
+    }
+
+    if (mapEntry.HasMember("disableStreaming") && mapEntry["disableStreaming"].GetBool())
+        limits.minResidentMips = mipCount;
+
+    limits.residentMips = mipCount > TXTR_DEFAULT_RESIDENT_MIPS ? TXTR_DEFAULT_RESIDENT_MIPS : mipCount;
+
+    if (limits.residentMips < limits.minResidentMips)
+        limits.residentMips = limits.minResidentMips;
+
+    if (mapEntry.HasMember("maxResidentBytes"))
+    {
+        if (!mapEntry["maxResidentBytes"].IsUint64())
+            Error("found field 'maxResidentBytes' on txtr asset '%s' with invalid type. expected 'uint'\n", assetPath);
+
+        uint64_t nMaxResidentSize = mapEntry["maxResidentBytes"].GetUint64();
+
+        // the resident mips are the smallest ones at the end of the chain
+        uint64_t nResidentSize = 0;
+        for (uint32_t ml = mipCount - limits.residentMips; ml < mipCount; ml++)
+            nResidentSize += limits.mipSizes[ml];
+
+        while (limits.residentMips > limits.minResidentMips && nResidentSize > nMaxResidentSize)
+        {
+            nResidentSize -= limits.mipSizes[mipCount - limits.residentMips];
+            limits.residentMips--;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// purpose: builds the mip chain of an image and encodes it into the texture format
+//          if the top mip is already encoded, it is used as is and only the generated mips are encoded
+//-----------------------------------------------------------------------------
+static void EncodeTextureSource(CPakFile* pak, SourceImage image, DXGI_FORMAT dxgiFormat, const uint8_t* pEncodedTopMip, rapidjson::Value& mapEntry, TextureSource& src)
+{
+    std::vector<SourceImage> mips;
+
+    if (ShouldGenerateMips(mapEntry))
+    {
+        MipFilter filter = MipFilter::Box;
+
+        if (mapEntry.HasMember("mipFilter") && mapEntry["mipFilter"].IsString() && mapEntry["mipFilter"].GetStdString() == "kaiser")
+            filter = MipFilter::Kaiser;
+
+        // srgb textures are filtered in linear space so the smaller mips don't get darker
+        MipGen::GenerateMipChain(std::move(image), dxutils::IsFormatSRGB(dxgiFormat), filter, mips);
+    }
+    else
+    {
+        mips.push_back(std::move(image));
+    }
+
+    src.format = dxgiFormat;
+    src.width = mips[0].width;
+    src.height = mips[0].height;
+    src.mipCount = (uint32_t)mips.size();
+
+    size_t nPayloadSize = 0;
+    for (uint32_t ml = 0; ml < src.mipCount; ml++)
+        nPayloadSize += dxutils::GetMipSize(dxgiFormat, src.width, src.height, ml);
+
+    src.encodedPayload.resize(nPayloadSize);
+
+    size_t nPayloadOffset = 0;
+    for (uint32_t ml = 0; ml < src.mipCount; ml++)
+    {
+        uint8_t* pMipData = src.encodedPayload.data() + nPayloadOffset;
+        uint32_t nMipSize = dxutils::GetMipSize(dxgiFormat, src.width, src.height, ml);
+
+        if (ml == 0 && pEncodedTopMip)
+            memcpy_s(pMipData, nMipSize, pEncodedTopMip, nMipSize);
+        else
+            BCEncoder::EncodeSurface(mips[ml].pixels.data(), mips[ml].width, mips[ml].height, dxgiFormat, pMipData, pak->GetNumThreads());
+
+        nPayloadOffset += nMipSize;
+    }
+
+    src.pPayload = src.encodedPayload.data();
+    src.payloadOffset = 0;
+    src.sourceSize = src.encodedPayload.size();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: loads an uncompressed source image and encodes it into the texture format
+//-----------------------------------------------------------------------------
+static void EncodeImageSource(CPakFile* pak, const std::string& filePath, const char* assetPath, rapidjson::Value& mapEntry, TextureSource& src)
+{
+    SourceImage image;
+
+    // images that were decoded to plan the texture streaming aren't decoded again
+    if (!pak->GetImageCache() || !pak->GetImageCache()->Take(filePath, image))
+        ImageLoader::LoadImageFile(filePath, image);
+
+    if (image.width > UINT16_MAX || image.height > UINT16_MAX)
+        Error("Attempted to add txtr asset '%s' with dimensions %ix%i, which is larger than the maximum of %ix%i. Exiting...\n", assetPath, image.width, image.height, UINT16_MAX, UINT16_MAX);
+
+    DXGI_FORMAT dxgiFormat = GetImageSourceFormat(assetPath, mapEntry, image.hasAlpha);
+
+    Log("-> encoding %s\n", fs::path(filePath).filename().u8string().c_str());
+
+    EncodeTextureSource(pak, std::move(image), dxgiFormat, nullptr, mapEntry, src);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: generates the missing mips of a dds that only has its top level
+//-----------------------------------------------------------------------------
+static void GenerateDDSMips(CPakFile* pak, const char* assetPath, rapidjson::Value& mapEntry, TextureSource& src)
+{
+    if (!BCEncoder::IsDecodeSupported(src.format))
+    {
+        Warning("txtr asset '%s' has no mips and its format '%s' can't be decoded to generate them. it will not be streamed\n", assetPath, dxutils::GetFormatAsString(src.format).c_str());
+        return;
+    }
+
+    uint32_t nTopMipSize = dxutils::GetMipSize(src.format, src.width, src.height, 0);
+
+    if (src.payloadOffset + nTopMipSize > src.sourceSize)
+        Error("Attempted to add txtr asset '%s' with less mip data than described by its DDS header. Exiting...\n", assetPath);
+
+    Log("-> generating mips\n");
+
+    SourceImage image;
+    image.width = src.width;
+    image.height = src.height;
+    image.pixels.resize((size_t)src.width * src.height * 4);
+
+    BCEncoder::DecodeSurface(src.pPayload, src.width, src.height, src.format, image.pixels.data());
+
+    // the top mip is kept as it was exported instead of being encoded a second time
+    EncodeTextureSource(pak, std::move(image), src.format, src.pPayload, mapEntry, src);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the streaming limits of a texture from the headers of its source
+//          without building it, so that the mips of all textures can be planned up front
+// returns: false if the source can't be used, the build of the asset reports why
+//-----------------------------------------------------------------------------
+bool Assets::GetTextureStreamingLimits(CPakFile* pak, const char* assetPath, rapidjson::Value& mapEntry, TextureStreamingLimits& limits)
+{
+    std::string filePath;
+    bool bEncoded = FindTextureSource(pak, assetPath, filePath);
+
+    if (!FILE_EXISTS(filePath))
+        return false;
+
+    DXGI_FORMAT dxgiFormat;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 1;
+
+    if (bEncoded)
+    {
+        bool bHasAlpha = false;
+        ImageLoader::GetImageInfo(filePath, width, height, bHasAlpha);
+
+        // the build picks the format from the pixels, so an image that can store alpha
+        // has to be read here too, to plan the same format for it
+        if (bHasAlpha && !mapEntry.HasMember("format"))
+        {
+            SourceImage image;
+            ImageLoader::LoadImageFile(filePath, image);
+
+            bHasAlpha = image.hasAlpha;
+
+            // the build takes the decoded image instead of decoding it a second time
+            if (pak->GetImageCache())
+                pak->GetImageCache()->Store(filePath, std::move(image));
+        }
+
+        dxgiFormat = GetImageSourceFormat(assetPath, mapEntry, bHasAlpha);
+
+        if (ShouldGenerateMips(mapEntry))
+            mipCount = MipGen::GetFullMipCount(width, height);
+    }
+    else
+    {
+        BinaryIO input;
+        input.open(filePath, BinaryIOMode::Read, BIO_MAPPED);
+
+        TextureSource src;
+        ParseDDSSource(input, assetPath, src);
+
+        input.close();
+
+        dxgiFormat = src.format;
+        width = src.width;
+        height = src.height;
+        mipCount = src.mipCount;
+
+        if (mipCount == 1 && ShouldGenerateMips(mapEntry) && BCEncoder::IsDecodeSupported(dxgiFormat))
+        {
+            mipCount = MipGen::GetFullMipCount(width, height);
+            bEncoded = true;
+        }
+    }
+
+    if (!IsTxtrFormatSupported(dxgiFormat) || !dxutils::GetFormatTraits(dxgiFormat).HasSize())
+        return false;
+
+    GetStreamingLimits(dxgiFormat, width, height, mipCount, bEncoded, assetPath, mapEntry, limits);
+    return true;
+}
+
 void Assets::AddTextureAsset_v8(CPakFile* pak, std::vector<RPakAssetEntry>* assetEntries, const char* assetPath, rapidjson::Value& mapEntry)
 {
     Log("Adding txtr asset '%s'\n", assetPath);
 
-    std::string filePath = pak->GetAssetPath() + assetPath + ".dds";
+    std::string filePath;
+
+    // without a dds, the texture is encoded from an uncompressed image
+    bool bEncodeSource = FindTextureSource(pak, assetPath, filePath);
 
     if (!FILE_EXISTS(filePath))
         Error("Failed to find texture source file %s. Exiting...\n", filePath.c_str());
@@ -15,158 +433,130 @@ void Assets::AddTextureAsset_v8(CPakFile* pak, std::vector<RPakAssetEntry>* asse
     TextureHeader* hdr = new TextureHeader();
 
     BinaryIO input;
-    input.open(filePath, BinaryIOMode::Read);
+    TextureSource src;
 
-    uint64_t nInputFileSize = Utils::GetFileSize(filePath);
+    if (bEncodeSource)
+    {
+        EncodeImageSource(pak, filePath, assetPath, mapEntry, src);
+    }
+    else
+    {
+        input.open(filePath, BinaryIOMode::Read, BIO_MAPPED);
+        ParseDDSSource(input, assetPath, src);
+
+        // dds files exported without mips get a full chain built from their top level
+        if (src.mipCount == 1 && ShouldGenerateMips(mapEntry))
+            GenerateDDSMips(pak, assetPath, mapEntry, src);
+    }
 
     std::string sAssetName = assetPath;
 
-    uint32_t nLargestMipSize = 0;
     uint32_t nStreamedMipSize = 0;
-    uint32_t nDDSHeaderSize = 0;
+    uint32_t nOptStreamedMipSize = 0;
 
     bool bStreamable = false;
 
-    // parse input image file
-    {
-        int magic;
-        input.read(magic);
+    // the optional starpak is only used if there is a path for it
+    std::string optStarpakPath = pak->GetPrimaryOptStarpakPath();
 
-        if (magic != 0x20534444) // b'DDS '
-            Error("Attempted to add txtr asset '%s' that was not a valid DDS file (invalid magic). Exiting...\n", assetPath);
+    if (mapEntry.HasMember("optStarpakPath") && mapEntry["optStarpakPath"].IsString())
+        optStarpakPath = mapEntry["optStarpakPath"].GetStdString();
 
-        DDS_HEADER ddsh = input.read<DDS_HEADER>();
+    // where each mip is in the source payload and how much space it takes up in the rpak, largest mip first
+    std::vector<TextureMipLayout> mipLayout{};
 
-        int nStreamedMipCount = 0;
+    // lay out the mips of the source
+    {
+        DXGI_FORMAT dxgiFormat = src.format;
 
-        if (ddsh.dwMipMapCount > 9)
-        {
-            if (mapEntry.HasMember("disableStreaming") && mapEntry["disableStreaming"].GetBool())
-            {
-                nStreamedMipCount = 0;
-                bStreamable = false;
-            }
-            else
-            {
-                nStreamedMipCount = ddsh.dwMipMapCount - 9;
-                bStreamable = true;
-            }
-        }
+        if (!IsTxtrFormatSupported(dxgiFormat) || !dxutils::GetFormatTraits(dxgiFormat).HasSize())
+            Error("Attempted to add txtr asset '%s' using unsupported DDS type '%s'. Exiting...\n", assetPath, dxutils::GetFormatAsString(dxgiFormat).c_str());
 
-        uint32_t nTotalSize = 0;
-        for (unsigned int ml = 0; ml < ddsh.dwMipMapCount; ml++)
-        {
-            uint32_t nCurrentMipSize = (ddsh.dwPitchOrLinearSize / std::pow(4, ml));
+        Log("-> fmt: %s\n", dxutils::GetFormatAsString(dxgiFormat).c_str());
 
-            // add 16 bytes if mip data size is below 8 bytes else add calculated size
-            nTotalSize += (nCurrentMipSize <= 8 ? 16 : nCurrentMipSize);
+        hdr->imgFormat = s_txtrFormatMap[dxgiFormat];
 
-            // if this texture and mip are streaming
-            if (bStreamable && ml < (ddsh.dwMipMapCount - 9))
-                nStreamedMipSize += nCurrentMipSize;
-        }
+        TextureStreamingLimits limits;
+        GetStreamingLimits(dxgiFormat, src.width, src.height, src.mipCount, src.IsEncoded(), assetPath, mapEntry, limits);
 
-        hdr->dataSize = nTotalSize;
-        hdr->width = (uint16_t)ddsh.dwWidth;
-        hdr->height = (uint16_t)ddsh.dwHeight;
+        // the resident texture budget of the pak may have planned fewer mips in the rpak for this texture
+        uint32_t nResidentMipCount = pak->GetPlannedResidentMips(assetPath, limits.residentMips);
 
-        Log("-> dimensions: %ix%i\n", ddsh.dwWidth, ddsh.dwHeight);
+        if (nResidentMipCount < limits.minResidentMips)
+            nResidentMipCount = limits.minResidentMips;
+        else if (nResidentMipCount > src.mipCount)
+            nResidentMipCount = src.mipCount;
 
-        hdr->mipLevels = (uint8_t)(ddsh.dwMipMapCount - nStreamedMipCount);
-        hdr->streamedMipLevels = nStreamedMipCount;
+        uint32_t nStreamedMipCount = src.mipCount - nResidentMipCount;
 
-        Log("-> total mipmaps permanent:streamed : %i:%i\n", hdr->mipLevels, hdr->streamedMipLevels);
+        // the largest streamed mips go into the optional starpak, installs without it still have all other mips
+        uint32_t nOptStreamedMipCount = optStarpakPath.empty() ? 0 : pak->GetOptStreamedMipCount();
 
-        nLargestMipSize = ddsh.dwPitchOrLinearSize;
+        if (mapEntry.HasMember("optStreamedMips"))
+        {
+            if (!mapEntry["optStreamedMips"].IsUint())
+                Error("found field 'optStreamedMips' on txtr asset '%s' with invalid type. expected 'uint'\n", assetPath);
 
-        DXGI_FORMAT dxgiFormat;
+            nOptStreamedMipCount = mapEntry["optStreamedMips"].GetUint();
 
-        switch (ddsh.ddspf.dwFourCC)
-        {
-        case '1TXD': // DXT1
-            dxgiFormat = DXGI_FORMAT_BC1_UNORM;
-            break;
-        case '3TXD': // DXT3
-            dxgiFormat = DXGI_FORMAT_BC2_UNORM;
-            break;
-        case '5TXD': // DXT5
-            dxgiFormat = DXGI_FORMAT_BC3_UNORM;
-            break;
-        case '1ITA':
-        case 'U4CB': // BC4U
-            dxgiFormat = DXGI_FORMAT_BC4_UNORM;
-            break;
-        case 'S4CB':
-            dxgiFormat = DXGI_FORMAT_BC4_SNORM;
-            break;
-        case '2ITA': // ATI2
-        case 'U5CB': // BC5U
-            dxgiFormat = DXGI_FORMAT_BC5_UNORM;
-            break;
-        case 'S5CB': // BC5S
-            dxgiFormat = DXGI_FORMAT_BC5_SNORM;
-            break;
-        case '01XD': // DX10
-            dxgiFormat = DXGI_FORMAT_UNKNOWN;
-            break;
-        // legacy format codes
-        case 36:
-            dxgiFormat = DXGI_FORMAT_R16G16B16A16_UNORM;
-            break;
-        case 110:
-            dxgiFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
-            break;
-        case 111:
-            dxgiFormat = DXGI_FORMAT_R16_FLOAT;
-            break;
-        case 112:
-            dxgiFormat = DXGI_FORMAT_R16G16_FLOAT;
-            break;
-        case 113:
-            dxgiFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
-            break;
-        case 114:
-            dxgiFormat = DXGI_FORMAT_R32_FLOAT;
-            break;
-        case 115:
-            dxgiFormat = DXGI_FORMAT_R32G32_FLOAT;
-            break;
-        case 116:
-            dxgiFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
-            break;
-        default:
-            dxgiFormat = dxutils::GetFormatFromHeader(ddsh);
-            
-            if(dxgiFormat == DXGI_FORMAT_UNKNOWN)
-                Error("Attempted to add txtr asset '%s' that was not using a supported DDS type. Exiting...\n", assetPath);
-            
-            return;
+            if (nOptStreamedMipCount > 0 && optStarpakPath.empty())
+                Error("attempted to add asset '%s' with optional streamed mips, but no optional starpak files were available.\nto fix: add 'optStarpakPath' as an rpak-wide variable\nor: add 'optStarpakPath' as an asset specific variable\n", assetPath);
         }
 
-        // Go to the end of the main header.
-        input.seek(ddsh.dwSize + 4);
+        if (nOptStreamedMipCount > nStreamedMipCount)
+            nOptStreamedMipCount = nStreamedMipCount;
 
-        // this is used for some math later
-        nDDSHeaderSize = ddsh.dwSize + 4;
+        nStreamedMipCount -= nOptStreamedMipCount;
+        bStreamable = nStreamedMipCount > 0;
 
-        // Go to the end of the DX10 header if it exists.
-        if (ddsh.ddspf.dwFourCC == '01XD')
+        uint32_t nTotalSize = 0;
+        uint32_t nPayloadOffset = 0;
+        for (unsigned int ml = 0; ml < src.mipCount; ml++)
         {
-            DDS_HEADER_DXT10 ddsh_dx10 = input.read<DDS_HEADER_DXT10>();
+            TextureMipLayout mip{};
+            mip.ddsOffset = nPayloadOffset;
+
+            // mip data is 16 byte aligned in the rpak
+            mip.ddsSize = dxutils::GetMipSize(dxgiFormat, src.width, src.height, ml);
+            mip.rpakSize = limits.mipSizes[ml];
 
-            dxgiFormat = ddsh_dx10.dxgiFormat;
+            // if this texture and mip are streaming
+            mip.optStreamed = ml < nOptStreamedMipCount;
+            mip.streamed = !mip.optStreamed && ml < nOptStreamedMipCount + nStreamedMipCount;
 
-            if (s_txtrFormatMap.count(dxgiFormat) == 0)
-                Error("Attempted to add txtr asset '%s' using unsupported DDS type '%s'. Exiting...\n", assetPath, dxutils::GetFormatAsString(dxgiFormat).c_str());
+            nPayloadOffset += mip.ddsSize;
+            nTotalSize += mip.rpakSize;
 
-            nDDSHeaderSize += 20;
+            if (mip.optStreamed)
+                nOptStreamedMipSize += mip.rpakSize;
+            else if (mip.streamed)
+                nStreamedMipSize += mip.rpakSize;
+
+            mipLayout.push_back(mip);
         }
 
-        Log("-> fmt: %s\n", dxutils::GetFormatAsString(dxgiFormat).c_str());
+        hdr->dataSize = nTotalSize;
+        hdr->width = (uint16_t)src.width;
+        hdr->height = (uint16_t)src.height;
+
+        Log("-> dimensions: %ix%i\n", src.width, src.height);
+
+        hdr->mipLevels = (uint8_t)nResidentMipCount;
+        hdr->streamedMipLevels = (uint8_t)nStreamedMipCount;
+        hdr->optStreamedMipLevels = (uint8_t)nOptStreamedMipCount;
+
+        Log("-> total mipmaps permanent:streamed:optional : %i:%i:%i\n", hdr->mipLevels, hdr->streamedMipLevels, hdr->optStreamedMipLevels);
+
+        uint32_t nResidentSize = nTotalSize - nStreamedMipSize - nOptStreamedMipSize;
+
+        if (mapEntry.HasMember("maxResidentBytes") && nResidentSize > mapEntry["maxResidentBytes"].GetUint64())
+            Warning("txtr asset '%s' needs %i resident bytes, which is more than its 'maxResidentBytes' of %lld\n", assetPath, nResidentSize, mapEntry["maxResidentBytes"].GetUint64());
 
-        hdr->imgFormat = s_txtrFormatMap.at(dxgiFormat);
+        pak->AddTextureMemoryUsage(nResidentSize, nStreamedMipSize, nOptStreamedMipSize);
     }
 
+    uint32_t nResidentDataSize = hdr->dataSize - nStreamedMipSize - nOptStreamedMipSize;
+
     hdr->guid = RTech::StringToGuid((sAssetName + ".rpak").c_str());
 
     bool bSaveDebugName = pak->IsFlagSet(PF_KEEP_DEV) || (mapEntry.HasMember("saveDebugName") && mapEntry["saveDebugName"].GetBool());
@@ -188,47 +578,65 @@ void Assets::AddTextureAsset_v8(CPakFile* pak, std::vector<RPakAssetEntry>* asse
     // woo more segments
     // cpu data
 
-    _vseginfo_t dataseginfo = pak->CreateNewSegment(hdr->dataSize - nStreamedMipSize, SF_CPU | SF_TEMP, 16);
+    _vseginfo_t dataseginfo = pak->CreateNewSegment(nResidentDataSize, SF_CPU | SF_TEMP, 16);
+
+    char* databuf = new char[nResidentDataSize];
+
+    // streamed mips of a dds are not read here, they get copied from the source file when the starpak entry is written
+    std::vector<StreamableDataRange> streamedRanges{};
+    std::vector<StreamableDataRange> optStreamedRanges{};
+
+    // encoded mips only exist in memory, so streamed ones are gathered into a buffer for the starpak entry
+    uint8_t* streamedbuf = src.IsEncoded() && nStreamedMipSize > 0 ? new uint8_t[nStreamedMipSize] : nullptr;
+    uint8_t* optstreamedbuf = src.IsEncoded() && nOptStreamedMipSize > 0 ? new uint8_t[nOptStreamedMipSize] : nullptr;
+
+    // the whole payload is mapped, so it only has to be checked once
+    uint64_t nPayloadSize = mipLayout.empty() ? 0 : mipLayout.back().ddsOffset + mipLayout.back().ddsSize;
 
-    char* databuf = new char[hdr->dataSize - nStreamedMipSize];
+    if (src.payloadOffset + nPayloadSize > src.sourceSize)
+        Error("Attempted to add txtr asset '%s' with less mip data than described by its DDS header. Exiting...\n", assetPath);
 
-    char* streamedbuf = new char[nStreamedMipSize];
+    const uint8_t* pPayload = src.pPayload;
 
-    int currentDDSOffset = 0;
-    int remainingDDSData = hdr->dataSize;
-    int remainingStreamedData = nStreamedMipSize;
+    // the rpak stores mips smallest first, so the largest mip ends up at the end of the data
+    // scatter all mips into their place in one pass
+    uint32_t remainingDDSData = nResidentDataSize;
+    uint32_t remainingStreamedData = nStreamedMipSize;
+    uint32_t remainingOptStreamedData = nOptStreamedMipSize;
 
-    for (int ml = 0; ml < (hdr->mipLevels + hdr->streamedMipLevels); ml++)
+    // streamed mips are stored smallest first in their starpak entry too
+    auto gatherStreamedMip = [&](const TextureMipLayout& mip, uint8_t* buf, uint32_t& remaining, std::vector<StreamableDataRange>& ranges)
     {
-        uint32_t nCurrentMipSize = (unsigned int)(nLargestMipSize / std::pow(4, ml));
-        uint32_t mipSizeDDS = 0;
-        uint32_t mipSizeRpak = 0;
+        remaining -= mip.rpakSize;
 
-        if (nCurrentMipSize <= 8)
+        if (buf)
         {
-            currentDDSOffset += 8;
-            mipSizeDDS = 8;
-            mipSizeRpak = 16;
+            memcpy_s(buf + remaining, mip.ddsSize, pPayload + mip.ddsOffset, mip.ddsSize);
+            memset(buf + remaining + mip.ddsSize, 0, mip.rpakSize - mip.ddsSize);
         }
         else
         {
-            currentDDSOffset += nCurrentMipSize;
-            mipSizeDDS = nCurrentMipSize;
-            mipSizeRpak = nCurrentMipSize;
+            // each smaller mip goes in front of the previous ones
+            ranges.insert(ranges.begin(), { src.payloadOffset + mip.ddsOffset, mip.ddsSize });
         }
+    };
 
-        remainingDDSData -= mipSizeRpak;
-
-        input.seek(nDDSHeaderSize + (currentDDSOffset - mipSizeDDS), std::ios::beg);
-
-        if (bStreamable && ml < hdr->streamedMipLevels)
+    for (auto& mip : mipLayout)
+    {
+        if (mip.optStreamed)
+        {
+            gatherStreamedMip(mip, optstreamedbuf, remainingOptStreamedData, optStreamedRanges);
+        }
+        else if (mip.streamed)
         {
-            remainingStreamedData -= nCurrentMipSize;
-            input.getReader()->read(streamedbuf + remainingStreamedData, mipSizeDDS);
+            gatherStreamedMip(mip, streamedbuf, remainingStreamedData, streamedRanges);
         }
         else
         {
-            input.getReader()->read(databuf + remainingDDSData, mipSizeDDS);
+            remainingDDSData -= mip.rpakSize;
+
+            memcpy_s(databuf + remainingDDSData, mip.ddsSize, pPayload + mip.ddsOffset, mip.ddsSize);
+            memset(databuf + remainingDDSData + mip.ddsSize, 0, mip.rpakSize - mip.ddsSize);
         }
     }
 
@@ -254,21 +662,28 @@ void Assets::AddTextureAsset_v8(CPakFile* pak, std::vector<RPakAssetEntry>* asse
     {
         std::string starpakPath = pak->GetPrimaryStarpakPath();
 
-        // check per texture just in case for whatever reason you want stuff in different starpaks (if it ever gets fixed).
+        // textures can be put in different starpaks, e.g. to spread the streamed data over several disks
         if (mapEntry.HasMember("starpakPath"))
             starpakPath = mapEntry["starpakPath"].GetString();
 
         if (starpakPath.length() == 0)
             Error("attempted to add asset '%s' as a streaming asset, but no starpak files were available.\nto fix: add 'starpakPath' as an rpak-wide variable\nor: add 'starpakPath' as an asset specific variable\n", assetPath);
-       
-        pak->AddStarpakReference(starpakPath);
 
-        StreamableDataEntry de{ 0, nStreamedMipSize, (uint8_t*)streamedbuf };
-        de = pak->AddStarpakDataEntry(de);
-        starpakOffset = de.m_nOffset;
+        StreamableDataEntry de{ 0, nStreamedMipSize, streamedbuf, streamedbuf ? "" : filePath, streamedRanges };
+        de = pak->AddStarpakDataEntry(de, starpakPath);
+        starpakOffset = de.GetAssetOffset();
+    }
+
+    uint64_t optStarpakOffset = -1;
+
+    if (nOptStreamedMipSize > 0)
+    {
+        StreamableDataEntry de{ 0, nOptStreamedMipSize, optstreamedbuf, optstreamedbuf ? "" : filePath, optStreamedRanges };
+        de = pak->AddStarpakDataEntry(de, optStarpakPath, true);
+        optStarpakOffset = de.GetAssetOffset();
     }
 
-    asset.InitAsset(RTech::StringToGuid((sAssetName + ".rpak").c_str()), subhdrinfo.index, 0, subhdrinfo.size, dataseginfo.index, 0, starpakOffset, -1, (std::uint32_t)AssetType::TXTR);
+    asset.InitAsset(RTech::StringToGuid((sAssetName + ".rpak").c_str()), subhdrinfo.index, 0, subhdrinfo.size, dataseginfo.index, 0, starpakOffset, optStarpakOffset, (std::uint32_t)AssetType::TXTR);
     asset.version = TXTR_VERSION;
 
     asset.pageEnd = dataseginfo.index + 1; // number of the highest page that the asset references pageidx + 1
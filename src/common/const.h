@@ -2,4 +2,6 @@
 
 #define DEFAULT_RPAK_NAME "new"
 #define DEFAULT_RPAK_PATH "build/"
-#define PF_KEEP_DEV 1 << 0 // whether or not to keep debugging information
\ No newline at end of file
+#define PF_KEEP_DEV 1 << 0 // whether or not to keep debugging information
+#define PF_STREAM_PAGES 1 << 1 // whether or not to write page data to disk as soon as it is final, instead of keeping it in memory until the end
+#define PF_DIRECT_IO 1 << 2 // whether or not to bypass the system file cache when writing the rpak and starpak files
\ No newline at end of file
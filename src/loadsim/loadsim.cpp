@@ -0,0 +1,711 @@
+//=============================================================================//
+//
+// purpose: rpak loader simulator, loads a built rpak the way the engine lays it
+//          out in memory and reports what that costs, so layout changes can be
+//          compared without running the game
+//
+//          this is its own program. it only shares the segment placement in
+//          public/segmentlayout.h with RePak and doesn't use any windows
+//          headers, so it can be built anywhere, e.g.:
+//          g++ -std=c++17 -O2 src/loadsim/loadsim.cpp -o repak-loadsim
+//
+//=============================================================================//
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../public/segmentlayout.h"
+
+#define RPAK_MAGIC (('k'<<24)+('a'<<16)+('P'<<8)+'R')
+
+// sizes of the structures as they are stored in the file
+#define RPAK_HEADER_SIZE_V7 0x58
+#define RPAK_HEADER_SIZE_V8 0x80
+#define RPAK_VIRTUAL_SEGMENT_SIZE 0x10
+#define RPAK_PAGE_INFO_SIZE 0xC
+#define RPAK_DESCRIPTOR_SIZE 0x8
+#define RPAK_ASSET_ENTRY_SIZE_V7 0x48
+#define RPAK_ASSET_ENTRY_SIZE_V8 0x50
+#define RPAK_RELATION_SIZE 0x4
+
+// loaded rpak, with the tables that the loader uses
+struct SimRpak
+{
+	const uint8_t* m_pData = nullptr;
+	uint64_t m_nSize = 0;
+
+	short m_nVersion = 0;
+
+	struct Segment
+	{
+		uint32_t flags;
+		uint32_t alignment;
+		uint64_t dataSize;
+	};
+
+	struct Page
+	{
+		uint32_t segIdx;
+		uint32_t alignment;
+		uint32_t dataSize;
+		uint64_t fileOffset;
+	};
+
+	struct Ptr
+	{
+		uint32_t index;
+		uint32_t offset;
+	};
+
+	struct Asset
+	{
+		uint64_t guid;
+		int headIdx;
+		int cpuIdx;
+		uint16_t pageEnd;
+		uint32_t usesStartIdx;
+		uint32_t usesCount;
+		uint32_t id;
+	};
+
+	std::vector<Segment> m_vSegments;
+	std::vector<Page> m_vPages;
+	std::vector<Ptr> m_vDescriptors;
+	std::vector<Asset> m_vAssets;
+	std::vector<Ptr> m_vGuidDescriptors;
+
+	// size of the header and the tables before the page data
+	uint64_t m_nTablesSize = 0;
+};
+
+// what a single simulated load did
+struct SimResult
+{
+	double m_flAllocTime = 0;
+	double m_flPageTime = 0;
+	double m_flFixupTime = 0;
+	double m_flGuidTime = 0;
+	double m_flTotalTime = 0;
+
+	uint64_t m_nAllocCount = 0;
+	uint64_t m_nAllocatedBytes = 0;
+	uint64_t m_nBytesTouched = 0;
+
+	uint64_t m_nFixupCount = 0;
+	uint64_t m_nLocalGuids = 0;
+	uint64_t m_nExternalGuids = 0;
+
+	// problems with the layout that the engine would trip over
+	uint64_t m_nSegmentOverflows = 0;
+	uint64_t m_nUnsortedDescriptors = 0;
+	uint64_t m_nBadPointers = 0;
+	uint64_t m_nPagesPastEnd = 0;
+
+	// page data that has to be loaded before each asset can be used
+	std::vector<uint64_t> m_vAssetReadyBytes;
+};
+
+//-----------------------------------------------------------------------------
+// purpose: maps a file into memory for reading
+// returns: false if the file couldn't be mapped
+//-----------------------------------------------------------------------------
+static bool MapFile(const char* path, SimRpak& rpak)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size{};
+	GetFileSizeEx(file, &size);
+
+	HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+
+	if (!mapping)
+		return false;
+
+	rpak.m_pData = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	rpak.m_nSize = size.QuadPart;
+	CloseHandle(mapping);
+#else
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+		return false;
+
+	struct stat st{};
+	fstat(fd, &st);
+
+	void* data = st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	rpak.m_pData = (const uint8_t*)data;
+	rpak.m_nSize = st.st_size;
+#endif
+
+	return rpak.m_pData != nullptr;
+}
+
+static void UnmapFile(SimRpak& rpak)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(rpak.m_pData);
+#else
+	munmap((void*)rpak.m_pData, rpak.m_nSize);
+#endif
+}
+
+template <typename T>
+static T ReadValue(const uint8_t* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: reads the header and tables of a mapped rpak, field by field in the
+//          same order that CPakFile::WriteHeader and co write them
+// returns: error message, empty if the rpak can be simulated
+//-----------------------------------------------------------------------------
+static std::string ReadRpak(SimRpak& rpak)
+{
+	const uint8_t* data = rpak.m_pData;
+
+	if (rpak.m_nSize < RPAK_HEADER_SIZE_V7 || ReadValue<uint32_t>(data) != RPAK_MAGIC)
+		return "not a valid rpak file";
+
+	rpak.m_nVersion = ReadValue<short>(data + 4);
+
+	if (rpak.m_nVersion != 7 && rpak.m_nVersion != 8)
+		return "unsupported rpak version " + std::to_string(rpak.m_nVersion);
+
+	const bool v8 = rpak.m_nVersion == 8;
+	const uint64_t headerSize = v8 ? RPAK_HEADER_SIZE_V8 : RPAK_HEADER_SIZE_V7;
+
+	if (rpak.m_nSize < headerSize)
+		return "rpak file is truncated";
+
+	// magic, version, flags, file time, unk0
+	uint64_t pos = 0x18;
+
+	const uint64_t compressedSize = ReadValue<uint64_t>(data + pos);
+	pos += 8;
+
+	if (v8)
+		pos += 8; // embedded starpak offset
+
+	pos += 8; // unk1
+
+	const uint64_t decompressedSize = ReadValue<uint64_t>(data + pos);
+	pos += 8;
+
+	if (v8)
+		pos += 8; // embedded starpak size
+
+	pos += 8; // unk2
+
+	const uint16_t starpakPathsSize = ReadValue<uint16_t>(data + pos);
+	pos += 2;
+
+	uint16_t optStarpakPathsSize = 0;
+
+	if (v8)
+	{
+		optStarpakPathsSize = ReadValue<uint16_t>(data + pos);
+		pos += 2;
+	}
+
+	const uint16_t segmentCount = ReadValue<uint16_t>(data + pos);
+	const uint16_t pageCount = ReadValue<uint16_t>(data + pos + 2);
+	const uint16_t patchIndex = ReadValue<uint16_t>(data + pos + 4);
+	pos += 6;
+
+	if (v8)
+		pos += 2; // alignment
+
+	const uint32_t descriptorCount = ReadValue<uint32_t>(data + pos);
+	const uint32_t assetCount = ReadValue<uint32_t>(data + pos + 4);
+	const uint32_t guidDescriptorCount = ReadValue<uint32_t>(data + pos + 8);
+	const uint32_t relationCount = ReadValue<uint32_t>(data + pos + 12);
+	pos += 16;
+
+	if (!v8 && (ReadValue<uint32_t>(data + pos) != 0 || ReadValue<uint32_t>(data + pos + 4) != 0))
+		return "rpak has external tables, which are not supported";
+
+	if (compressedSize != decompressedSize || patchIndex != 0)
+		return "rpak is compressed or a patch rpak, which is not supported";
+
+	const uint64_t assetSize = v8 ? RPAK_ASSET_ENTRY_SIZE_V8 : RPAK_ASSET_ENTRY_SIZE_V7;
+
+	pos = headerSize + starpakPathsSize + optStarpakPathsSize;
+
+	const uint64_t tablesSize = pos + segmentCount * RPAK_VIRTUAL_SEGMENT_SIZE + pageCount * RPAK_PAGE_INFO_SIZE
+		+ descriptorCount * RPAK_DESCRIPTOR_SIZE + assetCount * assetSize + guidDescriptorCount * RPAK_DESCRIPTOR_SIZE
+		+ relationCount * RPAK_RELATION_SIZE;
+
+	if (tablesSize > rpak.m_nSize)
+		return "rpak file is truncated";
+
+	for (uint32_t i = 0; i < segmentCount; ++i, pos += RPAK_VIRTUAL_SEGMENT_SIZE)
+		rpak.m_vSegments.push_back({ ReadValue<uint32_t>(data + pos), ReadValue<uint32_t>(data + pos + 4), ReadValue<uint64_t>(data + pos + 8) });
+
+	// pages are stored back to back after the tables
+	uint64_t pageOffset = tablesSize;
+
+	for (uint32_t i = 0; i < pageCount; ++i, pos += RPAK_PAGE_INFO_SIZE)
+	{
+		SimRpak::Page page{ ReadValue<uint32_t>(data + pos), ReadValue<uint32_t>(data + pos + 4), ReadValue<uint32_t>(data + pos + 8), pageOffset };
+
+		if (page.segIdx >= segmentCount)
+			return "page " + std::to_string(i) + " is in segment " + std::to_string(page.segIdx) + ", which does not exist";
+
+		rpak.m_vPages.push_back(page);
+		pageOffset += page.dataSize;
+	}
+
+	if (pageOffset > rpak.m_nSize)
+		return "rpak file is truncated";
+
+	for (uint32_t i = 0; i < descriptorCount; ++i, pos += RPAK_DESCRIPTOR_SIZE)
+		rpak.m_vDescriptors.push_back({ ReadValue<uint32_t>(data + pos), ReadValue<uint32_t>(data + pos + 4) });
+
+	for (uint32_t i = 0; i < assetCount; ++i, pos += assetSize)
+	{
+		const uint8_t* asset = data + pos;
+		const uint64_t tail = v8 ? 0x30 : 0x28; // past the starpak offsets
+
+		rpak.m_vAssets.push_back({
+			ReadValue<uint64_t>(asset),
+			ReadValue<int>(asset + 0x10),
+			ReadValue<int>(asset + 0x18),
+			ReadValue<uint16_t>(asset + tail),
+			ReadValue<uint32_t>(asset + tail + 0x8),
+			ReadValue<uint32_t>(asset + tail + 0x10),
+			ReadValue<uint32_t>(asset + tail + 0x1C)
+		});
+	}
+
+	for (uint32_t i = 0; i < guidDescriptorCount; ++i, pos += RPAK_DESCRIPTOR_SIZE)
+		rpak.m_vGuidDescriptors.push_back({ ReadValue<uint32_t>(data + pos), ReadValue<uint32_t>(data + pos + 4) });
+
+	rpak.m_nTablesSize = tablesSize;
+
+	return "";
+}
+
+static double GetSeconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: places the pages in their segments with the placement that repak
+//          sizes its segments with
+// returns: size that each segment needs to hold its pages
+//-----------------------------------------------------------------------------
+static std::vector<uint64_t> PlacePages(const SimRpak& rpak, std::vector<uint64_t>& pageOffsets)
+{
+	return PlaceSegmentPages(rpak.m_vSegments.size(), rpak.m_vPages.size(),
+		[&](size_t i) { return SegmentPage{ rpak.m_vPages[i].segIdx, rpak.m_vPages[i].alignment, rpak.m_vPages[i].dataSize }; }, &pageOffsets);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: checks the page placement that repak and the simulator share against
+//          segments laid out by hand
+// returns: number of failed checks
+//-----------------------------------------------------------------------------
+static int RunSelfTest()
+{
+	struct SegmentCase
+	{
+		const char* name;
+		std::vector<SimRpak::Segment> segments;
+		std::vector<SimRpak::Page> pages;
+		std::vector<uint64_t> sizes;
+	};
+
+	const SegmentCase cases[] = {
+		// an unaligned sum of the pages would give 19 bytes, the gap in front of the second page has to be counted too
+		{ "gap before aligned page", { { 0, 16, 32 } }, { { 0, 1, 3, 0 }, { 0, 16, 16, 0 } }, { 32 } },
+		// packed pages of a merged segment keep their own alignment instead of the segment's
+		{ "merged segment alignments", { { 0, 64, 200 } }, { { 0, 8, 100, 0 }, { 0, 64, 10, 0 }, { 0, 8, 10, 0 } }, { 154 } },
+		// pages of different segments don't affect each other's placement
+		{ "interleaved segments", { { 0, 8, 24 }, { 1, 4096, 4097 } }, { { 0, 8, 5, 0 }, { 1, 4096, 4096, 0 }, { 0, 8, 16, 0 }, { 1, 1, 1, 0 } }, { 24, 4097 } },
+	};
+
+	int failures = 0;
+
+	for (auto& it : cases)
+	{
+		SimRpak rpak;
+		rpak.m_vSegments = it.segments;
+		rpak.m_vPages = it.pages;
+
+		std::vector<uint64_t> pageOffsets;
+		const std::vector<uint64_t> sizes = PlacePages(rpak, pageOffsets);
+
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			if (sizes[i] == it.sizes[i] && sizes[i] <= it.segments[i].dataSize)
+				continue;
+
+			printf("FAILED: %s: segment %zu needs %llu bytes, expected %llu\n", it.name, i, (unsigned long long)sizes[i], (unsigned long long)it.sizes[i]);
+			failures++;
+		}
+	}
+
+	printf("%i of %zu segment cases failed\n", failures, sizeof(cases) / sizeof(cases[0]));
+	return failures;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: loads the pages of an rpak like the engine does. each segment gets
+//          one allocation that its pages are placed in, aligned to their own
+//          alignment. pages are copied in order, the pointers in a page are
+//          fixed up once it is in, and each asset is made ready, which looks
+//          up the guids that it references, once all pages up to its page end
+//          are in
+//-----------------------------------------------------------------------------
+static void SimulateLoad(const SimRpak& rpak, SimResult& result)
+{
+	const auto loadStart = std::chrono::steady_clock::now();
+
+	// tables are read once up front
+	result.m_nBytesTouched += rpak.m_nTablesSize;
+
+	// place the pages in their segments, then allocate the segments
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<uint64_t> pageOffsets;
+	const std::vector<uint64_t> segmentSizes = PlacePages(rpak, pageOffsets);
+
+	std::vector<uint8_t*> segmentMemory(rpak.m_vSegments.size(), nullptr);
+	std::vector<uint8_t*> segmentBases(rpak.m_vSegments.size(), nullptr);
+
+	for (size_t i = 0; i < rpak.m_vSegments.size(); ++i)
+	{
+		const SimRpak::Segment& seg = rpak.m_vSegments[i];
+
+		// the pages need more than the segment declares, the engine would write past its allocation
+		if (segmentSizes[i] > seg.dataSize)
+			result.m_nSegmentOverflows++;
+
+		const uint64_t size = segmentSizes[i] > seg.dataSize ? segmentSizes[i] : seg.dataSize;
+		const uint64_t alignment = seg.alignment > 0 ? seg.alignment : 1;
+
+		if (size == 0)
+			continue;
+
+		segmentMemory[i] = (uint8_t*)malloc(size + alignment);
+		segmentBases[i] = (uint8_t*)(((uintptr_t)segmentMemory[i] + alignment - 1) / alignment * alignment);
+
+		result.m_nAllocCount++;
+		result.m_nAllocatedBytes += size;
+	}
+
+	std::vector<uint8_t*> pageMemory(rpak.m_vPages.size());
+
+	for (size_t i = 0; i < rpak.m_vPages.size(); ++i)
+		pageMemory[i] = segmentBases[rpak.m_vPages[i].segIdx] + pageOffsets[i];
+
+	result.m_flAllocTime += GetSeconds(start);
+
+	// assets that become ready after each page
+	std::vector<std::vector<uint32_t>> readyAssets(rpak.m_vPages.size() + 1);
+
+	for (uint32_t i = 0; i < rpak.m_vAssets.size(); ++i)
+	{
+		const SimRpak::Asset& asset = rpak.m_vAssets[i];
+		const uint32_t pageEnd = asset.pageEnd < rpak.m_vPages.size() ? asset.pageEnd : (uint32_t)rpak.m_vPages.size();
+
+		if (asset.pageEnd > rpak.m_vPages.size())
+			result.m_nPagesPastEnd++;
+
+		readyAssets[pageEnd].push_back(i);
+	}
+
+	std::unordered_map<uint64_t, uint32_t> assetsByGuid;
+	for (uint32_t i = 0; i < rpak.m_vAssets.size(); ++i)
+		assetsByGuid.emplace(rpak.m_vAssets[i].guid, i);
+
+	result.m_vAssetReadyBytes.assign(rpak.m_vAssets.size(), 0);
+
+	size_t descIdx = 0;
+	uint64_t loadedBytes = 0;
+
+	// the page end of an asset is exclusive, so assets with a page end of 0 are ready right away
+	for (uint32_t pageIdx = 0; pageIdx <= rpak.m_vPages.size(); ++pageIdx)
+	{
+		if (pageIdx > 0)
+		{
+			const uint32_t loadedPage = pageIdx - 1;
+			const SimRpak::Page& page = rpak.m_vPages[loadedPage];
+
+			start = std::chrono::steady_clock::now();
+			memcpy(pageMemory[loadedPage], rpak.m_pData + page.fileOffset, page.dataSize);
+			result.m_flPageTime += GetSeconds(start);
+
+			result.m_nBytesTouched += page.dataSize;
+			loadedBytes += page.dataSize;
+
+			// descriptors are processed in order as their pages come in, any that
+			// point into an earlier page would never get processed by the engine
+			start = std::chrono::steady_clock::now();
+
+			for (; descIdx < rpak.m_vDescriptors.size(); ++descIdx)
+			{
+				const SimRpak::Ptr& desc = rpak.m_vDescriptors[descIdx];
+
+				if (desc.index > loadedPage)
+					break;
+
+				if (desc.index < loadedPage)
+					result.m_nUnsortedDescriptors++;
+
+				if (desc.offset + sizeof(uint64_t) > rpak.m_vPages[desc.index].dataSize)
+				{
+					result.m_nBadPointers++;
+					continue;
+				}
+
+				uint8_t* location = pageMemory[desc.index] + desc.offset;
+				const SimRpak::Ptr target = ReadValue<SimRpak::Ptr>(location);
+
+				if (target.index >= rpak.m_vPages.size() || target.offset > rpak.m_vPages[target.index].dataSize)
+				{
+					result.m_nBadPointers++;
+					continue;
+				}
+
+				uint8_t* pointer = pageMemory[target.index] + target.offset;
+				memcpy(location, &pointer, sizeof(pointer));
+
+				result.m_nFixupCount++;
+				result.m_nBytesTouched += sizeof(pointer);
+			}
+
+			result.m_flFixupTime += GetSeconds(start);
+		}
+
+		start = std::chrono::steady_clock::now();
+
+		for (auto& assetIdx : readyAssets[pageIdx])
+		{
+			const SimRpak::Asset& asset = rpak.m_vAssets[assetIdx];
+			result.m_vAssetReadyBytes[assetIdx] = loadedBytes;
+
+			if ((asset.headIdx >= (int)pageIdx) || (asset.cpuIdx != -1 && asset.cpuIdx >= (int)pageIdx))
+				result.m_nPagesPastEnd++;
+
+			for (uint32_t i = 0; i < asset.usesCount; ++i)
+			{
+				const uint64_t guidIdx = (uint64_t)asset.usesStartIdx + i;
+
+				if (guidIdx >= rpak.m_vGuidDescriptors.size())
+				{
+					result.m_nBadPointers++;
+					continue;
+				}
+
+				const SimRpak::Ptr& desc = rpak.m_vGuidDescriptors[guidIdx];
+
+				if (desc.index >= pageIdx)
+				{
+					result.m_nPagesPastEnd++;
+					continue;
+				}
+
+				if (desc.offset + sizeof(uint64_t) > rpak.m_vPages[desc.index].dataSize)
+				{
+					result.m_nBadPointers++;
+					continue;
+				}
+
+				const uint64_t guid = ReadValue<uint64_t>(pageMemory[desc.index] + desc.offset);
+				result.m_nBytesTouched += sizeof(guid);
+
+				if (assetsByGuid.find(guid) != assetsByGuid.end())
+					result.m_nLocalGuids++;
+				else
+					result.m_nExternalGuids++;
+			}
+		}
+
+		result.m_flGuidTime += GetSeconds(start);
+	}
+
+	if (descIdx != rpak.m_vDescriptors.size())
+		result.m_nBadPointers += rpak.m_vDescriptors.size() - descIdx;
+
+	for (auto& it : segmentMemory)
+		free(it);
+
+	result.m_flTotalTime = GetSeconds(loadStart);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: prints the timings of the fastest run and the layout stats
+//-----------------------------------------------------------------------------
+static void PrintReport(const SimRpak& rpak, const std::vector<SimResult>& results)
+{
+	const SimResult* best = &results[0];
+	double totalTime = 0;
+
+	for (auto& it : results)
+	{
+		totalTime += it.m_flTotalTime;
+
+		if (it.m_flTotalTime < best->m_flTotalTime)
+			best = &it;
+	}
+
+	const SimResult& result = *best;
+
+	uint64_t dataSize = 0;
+	for (auto& it : rpak.m_vPages)
+		dataSize += it.dataSize;
+
+	printf("rpak_version=%i\n", rpak.m_nVersion);
+	printf("segments=%zu\n", rpak.m_vSegments.size());
+	printf("pages=%zu\n", rpak.m_vPages.size());
+	printf("page_bytes=%llu\n", (unsigned long long)dataSize);
+	printf("descriptors=%zu\n", rpak.m_vDescriptors.size());
+	printf("assets=%zu\n", rpak.m_vAssets.size());
+	printf("guid_descriptors=%zu\n", rpak.m_vGuidDescriptors.size());
+	printf("\n");
+
+	printf("runs=%zu\n", results.size());
+	printf("time_total_ms=%.3f\n", result.m_flTotalTime * 1000.0);
+	printf("time_total_mean_ms=%.3f\n", totalTime / results.size() * 1000.0);
+	printf("time_alloc_ms=%.3f\n", result.m_flAllocTime * 1000.0);
+	printf("time_pages_ms=%.3f\n", result.m_flPageTime * 1000.0);
+	printf("time_fixups_ms=%.3f\n", result.m_flFixupTime * 1000.0);
+	printf("time_guids_ms=%.3f\n", result.m_flGuidTime * 1000.0);
+	printf("\n");
+
+	printf("allocations=%llu\n", (unsigned long long)result.m_nAllocCount);
+	printf("allocated_bytes=%llu\n", (unsigned long long)result.m_nAllocatedBytes);
+	printf("bytes_touched=%llu\n", (unsigned long long)result.m_nBytesTouched);
+	printf("pointer_fixups=%llu\n", (unsigned long long)result.m_nFixupCount);
+	printf("guids_local=%llu\n", (unsigned long long)result.m_nLocalGuids);
+	printf("guids_external=%llu\n", (unsigned long long)result.m_nExternalGuids);
+	printf("\n");
+
+	// how much of the page data has to be in before the assets can be used
+	uint64_t pageEndSum = 0;
+	uint64_t pageEndMax = 0;
+	uint64_t readySum = 0;
+
+	for (size_t i = 0; i < rpak.m_vAssets.size(); ++i)
+	{
+		pageEndSum += rpak.m_vAssets[i].pageEnd;
+		pageEndMax = rpak.m_vAssets[i].pageEnd > pageEndMax ? rpak.m_vAssets[i].pageEnd : pageEndMax;
+		readySum += result.m_vAssetReadyBytes[i];
+	}
+
+	const size_t assetCount = rpak.m_vAssets.size() > 0 ? rpak.m_vAssets.size() : 1;
+
+	printf("page_end_mean=%.2f\n", (double)pageEndSum / assetCount);
+	printf("page_end_max=%llu\n", (unsigned long long)pageEndMax);
+	printf("ready_bytes_mean=%.0f\n", (double)readySum / assetCount);
+
+	// share of the assets that can be used once a share of the page data is in
+	const int steps[] = { 10, 25, 50, 75, 100 };
+
+	for (auto& step : steps)
+	{
+		const uint64_t loaded = dataSize * step / 100;
+		size_t ready = 0;
+
+		for (auto& it : result.m_vAssetReadyBytes)
+		{
+			if (it <= loaded)
+				ready++;
+		}
+
+		printf("assets_ready_at_%i%%=%.1f%%\n", step, 100.0 * ready / assetCount);
+	}
+
+	printf("\n");
+
+	printf("segment_overflows=%llu\n", (unsigned long long)result.m_nSegmentOverflows);
+	printf("unsorted_descriptors=%llu\n", (unsigned long long)result.m_nUnsortedDescriptors);
+	printf("bad_pointers=%llu\n", (unsigned long long)result.m_nBadPointers);
+	printf("pages_past_page_end=%llu\n", (unsigned long long)result.m_nPagesPastEnd);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: repak-loadsim <rpak path> [runs]\n");
+		printf("       repak-loadsim -selftest\n");
+		printf("simulates loading the rpak and prints timings, allocations and layout stats\n");
+		printf("exits with 2 if the layout has problems that the engine would run into\n");
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "-selftest"))
+		return RunSelfTest() > 0 ? 2 : 0;
+
+	const int runs = argc > 2 ? atoi(argv[2]) : 1;
+
+	if (runs < 1)
+	{
+		fprintf(stderr, "ERROR: invalid number of runs '%s'\n", argv[2]);
+		return 1;
+	}
+
+	SimRpak rpak;
+
+	if (!MapFile(argv[1], rpak))
+	{
+		fprintf(stderr, "ERROR: failed to open rpak file '%s'\n", argv[1]);
+		return 1;
+	}
+
+	const std::string error = ReadRpak(rpak);
+
+	if (!error.empty())
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", argv[1], error.c_str());
+		UnmapFile(rpak);
+		return 1;
+	}
+
+	std::vector<SimResult> results(runs);
+
+	for (auto& it : results)
+		SimulateLoad(rpak, it);
+
+	PrintReport(rpak, results);
+
+	const SimResult& result = results[0];
+	const bool hasProblems = result.m_nSegmentOverflows > 0 || result.m_nUnsortedDescriptors > 0 || result.m_nBadPointers > 0 || result.m_nPagesPastEnd > 0;
+
+	UnmapFile(rpak);
+
+	return hasProblems ? 2 : 0;
+}
@@ -0,0 +1,442 @@
+//=============================================================================//
+//
+// purpose: starpak compaction, drops data entries that no rpak references
+//          anymore and moves the remaining ones together
+//
+//=============================================================================//
+#include "pch.h"
+#include "compactor.h"
+#include "pakfile.h"
+
+// size of an asset entry as written by CPakFile::WriteAssets, version 7 has no optional starpak offset
+#define RPAK_ASSET_ENTRY_SIZE_V7 0x48
+#define RPAK_ASSET_ENTRY_SIZE_V8 0x50
+
+// positions of the mandatory and optional starpak offsets in an asset entry
+#define RPAK_ASSET_STARPAK_OFFSET_POS 0x20
+#define RPAK_ASSET_OPT_STARPAK_OFFSET_POS 0x28
+
+// asset table of an rpak and the starpaks that its assets reference
+struct CompactorRpak
+{
+	std::string m_Path;
+	short m_nVersion = 0;
+
+	std::vector<std::string> m_vStarpakPaths[2];
+
+	uint64_t m_nAssetsOffset = 0;
+	uint64_t m_nAssetSize = 0;
+	uint32_t m_nAssetCount = 0;
+
+	// mandatory and optional starpak offset of each asset
+	std::vector<__int64> m_vStarpakOffsets[2];
+
+	// index into the compacted starpak list for each path in m_vStarpakPaths, -1 if it isn't compacted
+	std::vector<int> m_vStarpakFiles[2];
+
+	// copy of the rpak with the new offsets, empty if none of them changed
+	std::string m_TempPath;
+};
+
+// starpak file that gets compacted
+struct CompactorStarpak
+{
+	std::string m_FilePath;
+
+	// rpaks that wrote data to the starpak, kept in the compacted file
+	std::vector<std::string> m_Creators;
+
+	// offsets of the entries that are still referenced, and where they are moved to
+	std::map<uint64_t, uint64_t> m_LiveEntries;
+
+	// compacted file, empty if no entries were removed
+	std::string m_TempPath;
+};
+
+//-----------------------------------------------------------------------------
+// purpose: gets the null terminated strings of a starpak path section
+//-----------------------------------------------------------------------------
+static std::vector<std::string> ReadStringSection(const uint8_t* data, size_t size)
+{
+	std::vector<std::string> strings;
+
+	for (size_t i = 0; i < size;)
+	{
+		const char* str = reinterpret_cast<const char*>(data + i);
+		size_t length = strnlen(str, size - i);
+
+		if (length > 0)
+			strings.emplace_back(str, length);
+
+		i += length + 1;
+	}
+
+	return strings;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: reads the starpak paths and the streamed data offsets of the assets
+//          of an rpak. the layout is the one that CPakFile::WriteHeader and
+//          CPakFile::WriteAssets produce
+//-----------------------------------------------------------------------------
+static void ReadRpak(const std::string& path, CompactorRpak& rpak)
+{
+	BinaryIO input;
+
+	if (!input.open(path, BinaryIOMode::Read, BIO_MAPPED))
+		Error("failed to open rpak file '%s'\n", path.c_str());
+
+	rpak.m_Path = path;
+
+	RPakFileHeader hdr{};
+
+	input.read(hdr.magic);
+	input.read(hdr.fileVersion);
+	input.read(hdr.flags);
+	input.read(hdr.fileTime);
+	input.read(hdr.unk0);
+	input.read(hdr.compressedSize);
+
+	if (hdr.fileVersion == 8)
+		input.read(hdr.embeddedStarpakOffset);
+
+	input.read(hdr.unk1);
+	input.read(hdr.decompressedSize);
+
+	if (hdr.fileVersion == 8)
+		input.read(hdr.embeddedStarpakSize);
+
+	input.read(hdr.unk2);
+	input.read(hdr.starpakPathsSize);
+
+	if (hdr.fileVersion == 8)
+		input.read(hdr.optStarpakPathsSize);
+
+	input.read(hdr.virtualSegmentCount);
+	input.read(hdr.pageCount);
+	input.read(hdr.patchIndex);
+
+	if (hdr.fileVersion == 8)
+		input.read(hdr.alignment);
+
+	input.read(hdr.descriptorCount);
+	input.read(hdr.assetCount);
+	input.read(hdr.guidDescriptorCount);
+	input.read(hdr.relationCount);
+
+	if (hdr.fileVersion == 7)
+	{
+		input.read(hdr.unk7count);
+		input.read(hdr.unk8count);
+	}
+	else if (hdr.fileVersion == 8)
+		input.read(hdr.unk3);
+
+	if (hdr.magic != RPAK_MAGIC || (hdr.fileVersion != 7 && hdr.fileVersion != 8) || input.eof())
+		Error("'%s' is not a valid rpak file\n", path.c_str());
+
+	// the asset table can only be patched in place if it is stored as is
+	if (hdr.compressedSize != hdr.decompressedSize || hdr.patchIndex != 0)
+		Error("rpak file '%s' is compressed or a patch rpak, which can't be compacted\n", path.c_str());
+
+	rpak.m_nVersion = hdr.fileVersion;
+
+	const uint8_t* data = input.getData();
+	uint64_t offset = input.tell();
+
+	if (offset + hdr.starpakPathsSize + hdr.optStarpakPathsSize > input.getSize())
+		Error("rpak file '%s' is truncated\n", path.c_str());
+
+	rpak.m_vStarpakPaths[0] = ReadStringSection(data + offset, hdr.starpakPathsSize);
+	offset += hdr.starpakPathsSize;
+
+	rpak.m_vStarpakPaths[1] = ReadStringSection(data + offset, hdr.optStarpakPathsSize);
+	offset += hdr.optStarpakPathsSize;
+
+	offset += hdr.virtualSegmentCount * sizeof(RPakVirtualSegment);
+	offset += hdr.pageCount * sizeof(RPakPageInfo);
+	offset += hdr.descriptorCount * sizeof(RPakDescriptor);
+
+	rpak.m_nAssetsOffset = offset;
+	rpak.m_nAssetCount = hdr.assetCount;
+	rpak.m_nAssetSize = rpak.m_nVersion == 8 ? RPAK_ASSET_ENTRY_SIZE_V8 : RPAK_ASSET_ENTRY_SIZE_V7;
+
+	if (rpak.m_nAssetsOffset + rpak.m_nAssetCount * rpak.m_nAssetSize > input.getSize())
+		Error("rpak file '%s' is truncated\n", path.c_str());
+
+	for (uint32_t i = 0; i < rpak.m_nAssetCount; ++i)
+	{
+		const uint8_t* asset = data + rpak.m_nAssetsOffset + i * rpak.m_nAssetSize;
+
+		__int64 starpakOffset = -1;
+		__int64 optStarpakOffset = -1;
+
+		memcpy(&starpakOffset, asset + RPAK_ASSET_STARPAK_OFFSET_POS, sizeof(starpakOffset));
+
+		if (rpak.m_nVersion == 8)
+			memcpy(&optStarpakOffset, asset + RPAK_ASSET_OPT_STARPAK_OFFSET_POS, sizeof(optStarpakOffset));
+
+		rpak.m_vStarpakOffsets[0].push_back(starpakOffset);
+		rpak.m_vStarpakOffsets[1].push_back(optStarpakOffset);
+	}
+
+	input.close();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes the live entries of a starpak to a new file next to it, which
+//          replaces the old file once all files have been written
+//-----------------------------------------------------------------------------
+static void RewriteStarpak(CPakFile* pak, CompactorStarpak& starpak)
+{
+	MappedFile input;
+
+	if (!input.open(starpak.m_FilePath))
+		Error("failed to open starpak file '%s'\n", starpak.m_FilePath.c_str());
+
+	std::vector<SRPkFileEntry> entries = CPakFile::ReadStarpakSortsTable(input, starpak.m_FilePath);
+
+	std::unordered_map<uint64_t, uint64_t> entrySizes;
+	for (auto& it : entries)
+		entrySizes.emplace(it.m_nOffset, it.m_nSize);
+
+	// blocks keep their order, so data that was streamed in together stays together
+	PakStarpakData compacted;
+
+	for (auto& it : starpak.m_LiveEntries)
+	{
+		auto entry = entrySizes.find(it.first);
+
+		if (entry == entrySizes.end())
+			Error("rpaks reference offset %lld in starpak file '%s', which is not the start of any of its data entries\n", it.first, starpak.m_FilePath.c_str());
+
+		it.second = compacted.m_nNextOffset;
+
+		StreamableDataEntry block;
+		block.m_nOffset = it.second;
+		block.m_nDataSize = entry->second;
+
+		compacted.m_vDataBlocks.push_back(block);
+		compacted.m_nNextOffset += block.GetPaddedSize();
+	}
+
+	const uint64_t oldSize = input.getSize();
+
+	// nothing to remove, so the entries stay where they are
+	if (compacted.m_vDataBlocks.size() == entries.size())
+	{
+		for (auto& it : starpak.m_LiveEntries)
+			it.second = it.first;
+
+		Log("starpak file '%s' has no unreferenced data entries\n", starpak.m_FilePath.c_str());
+		return;
+	}
+
+	starpak.m_TempPath = starpak.m_FilePath + ".compact";
+	BinaryIO out;
+
+	if (!out.open(starpak.m_TempPath, BinaryIOMode::Write, BIO_BUFFERED | (pak->IsFlagSet(PF_DIRECT_IO) ? BIO_DIRECT : 0)))
+		Error("failed to open starpak file '%s' for writing\n", starpak.m_TempPath.c_str());
+
+	pak->WriteStarpakHeader(out, starpak.m_Creators);
+
+	for (auto& it : starpak.m_LiveEntries)
+	{
+		const uint64_t size = entrySizes[it.first];
+
+		out.writeBytes(input.getData() + it.first, size);
+		Utils::WritePadding(out, Utils::AlignSize(size, STARPAK_DATABLOCK_ALIGNMENT) - size);
+	}
+
+	pak->WriteStarpakSortsTable(out, compacted);
+
+	uint64_t entryCount = compacted.m_vDataBlocks.size();
+	out.write(entryCount);
+
+	const uint64_t newSize = out.tell();
+	out.close();
+
+	input.close();
+
+	Log("compacted starpak file '%s': kept %lld of %lld data entries, %lld -> %lld bytes\n", starpak.m_FilePath.c_str(), entryCount, entries.size(), oldSize, newSize);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes a copy of an rpak next to it with the new starpak offsets in its
+//          asset table, which replaces the rpak once all files have been written
+//-----------------------------------------------------------------------------
+static void PatchRpakAssets(CompactorRpak& rpak, const std::vector<CompactorStarpak>& starpaks)
+{
+	// offsets in the file and the values that go there
+	std::vector<std::pair<size_t, __int64>> patches;
+
+	for (uint32_t i = 0; i < rpak.m_nAssetCount; ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+		{
+			const __int64 offset = rpak.m_vStarpakOffsets[j][i];
+
+			if (offset == -1)
+				continue;
+
+			const int file = rpak.m_vStarpakFiles[j][offset & STARPAK_INDEX_MASK];
+
+			if (file == -1)
+				continue;
+
+			const __int64 newOffset = starpaks[file].m_LiveEntries.at(offset & ~(__int64)STARPAK_INDEX_MASK) | (offset & STARPAK_INDEX_MASK);
+
+			if (newOffset == offset)
+				continue;
+
+			const size_t fieldOffset = j == 0 ? RPAK_ASSET_STARPAK_OFFSET_POS : RPAK_ASSET_OPT_STARPAK_OFFSET_POS;
+
+			patches.emplace_back(rpak.m_nAssetsOffset + i * rpak.m_nAssetSize + fieldOffset, newOffset);
+		}
+	}
+
+	if (patches.empty())
+		return;
+
+	rpak.m_TempPath = rpak.m_Path + ".compact";
+
+	if (!fs::copy_file(rpak.m_Path, rpak.m_TempPath, fs::copy_options::overwrite_existing))
+		Error("failed to copy rpak file '%s' to '%s'\n", rpak.m_Path.c_str(), rpak.m_TempPath.c_str());
+
+	BinaryIO out;
+
+	if (!out.openAppend(rpak.m_TempPath, fs::file_size(rpak.m_TempPath)))
+		Error("failed to open rpak file '%s' for writing\n", rpak.m_TempPath.c_str());
+
+	for (auto& it : patches)
+		out.writeAt(it.first, &it.second, sizeof(it.second));
+
+	out.close();
+
+	Debug("updated %lld starpak offsets in rpak file '%s'\n", patches.size(), rpak.m_Path.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// purpose: compacts the starpaks of a set of rpaks, and updates the offsets that
+//          the rpaks use. starpak files are looked for next to the rpak files,
+//          where they are written by a build. starpaks that other rpaks wrote
+//          to, or that don't record who wrote to them, are left alone unless
+//          compactShared is set
+//-----------------------------------------------------------------------------
+void Compactor::CompactStarpaks(CPakFile* pak, const std::vector<std::string>& rpakPaths, bool compactShared)
+{
+	std::vector<CompactorRpak> rpaks(rpakPaths.size());
+	std::vector<CompactorStarpak> starpaks;
+
+	// starpak files by their full path, rpaks may reference the same file by different paths
+	// starpaks that are left alone are -1
+	std::unordered_map<std::string, int> starpakFiles;
+
+	std::unordered_set<std::string> rpakNames;
+	for (auto& it : rpakPaths)
+		rpakNames.insert(fs::path(it).filename().u8string());
+
+	for (size_t i = 0; i < rpakPaths.size(); ++i)
+	{
+		CompactorRpak& rpak = rpaks[i];
+		ReadRpak(rpakPaths[i], rpak);
+
+		const fs::path rpakDir = fs::path(rpakPaths[i]).parent_path();
+
+		for (int j = 0; j < 2; ++j)
+		{
+			for (auto& it : rpak.m_vStarpakPaths[j])
+			{
+				fs::path filePath = rpakDir / fs::path(it).filename();
+
+				if (!fs::exists(filePath))
+				{
+					Warning("starpak file '%s' referenced by rpak '%s' was not found, it will not be compacted\n", filePath.u8string().c_str(), rpak.m_Path.c_str());
+					rpak.m_vStarpakFiles[j].push_back(-1);
+					continue;
+				}
+
+				const std::string fullPath = fs::canonical(filePath).u8string();
+				auto file = starpakFiles.find(fullPath);
+
+				if (file == starpakFiles.end())
+				{
+					CompactorStarpak starpak;
+					starpak.m_FilePath = filePath.u8string();
+
+					MappedFile input;
+
+					if (!input.open(starpak.m_FilePath))
+						Error("failed to open starpak file '%s'\n", starpak.m_FilePath.c_str());
+
+					const bool hasCreators = CPakFile::ReadStarpakCreators(input, starpak.m_Creators);
+					input.close();
+
+					// the entries that the other rpaks use would be dropped
+					std::string foreignCreator;
+
+					for (auto& creator : starpak.m_Creators)
+					{
+						if (!rpakNames.count(creator))
+						{
+							foreignCreator = creator;
+							break;
+						}
+					}
+
+					if (!compactShared && (!hasCreators || !foreignCreator.empty()))
+					{
+						if (!hasCreators)
+							Warning("starpak file '%s' wasn't written by the given rpaks, e.g. a shared or game starpak. it will not be compacted, pass -compactshared to compact it anyway\n", starpak.m_FilePath.c_str());
+						else
+							Warning("starpak file '%s' was also written by rpak '%s', which wasn't given. it will not be compacted, pass -compactshared to compact it anyway\n", starpak.m_FilePath.c_str(), foreignCreator.c_str());
+
+						file = starpakFiles.emplace(fullPath, -1).first;
+					}
+					else
+					{
+						file = starpakFiles.emplace(fullPath, (int)starpaks.size()).first;
+						starpaks.push_back(std::move(starpak));
+					}
+				}
+
+				rpak.m_vStarpakFiles[j].push_back(file->second);
+			}
+
+			// the live set is everything that any of the assets still points at
+			for (auto& it : rpak.m_vStarpakOffsets[j])
+			{
+				if (it == -1)
+					continue;
+
+				const uint64_t idx = it & STARPAK_INDEX_MASK;
+
+				if (idx >= rpak.m_vStarpakFiles[j].size())
+					Error("rpak file '%s' has an asset with streamed data in %sstarpak %lld, but only references %lld\n", rpak.m_Path.c_str(), j == 1 ? "optional " : "", idx, rpak.m_vStarpakFiles[j].size());
+
+				if (rpak.m_vStarpakFiles[j][idx] != -1)
+					starpaks[rpak.m_vStarpakFiles[j][idx]].m_LiveEntries.emplace(it & ~(__int64)STARPAK_INDEX_MASK, 0);
+			}
+		}
+	}
+
+	// everything is written to temporary files first, so a failure leaves all of the
+	// old files in place and the rpaks never point at entries that have been moved
+	for (auto& it : starpaks)
+		RewriteStarpak(pak, it);
+
+	for (auto& it : rpaks)
+		PatchRpakAssets(it, starpaks);
+
+	for (auto& it : starpaks)
+	{
+		if (!it.m_TempPath.empty())
+			fs::rename(it.m_TempPath, it.m_FilePath);
+	}
+
+	for (auto& it : rpaks)
+	{
+		if (!it.m_TempPath.empty())
+			fs::rename(it.m_TempPath, it.m_Path);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+class CPakFile;
+
+//
+// removes data entries from starpaks that are no longer referenced by any of a set of rpaks
+// e.g. entries that were replaced in starpaks that were appended to by incremental builds
+//
+namespace Compactor
+{
+	// every rpak that references the starpaks has to be passed, as the entries that
+	// the other rpaks use would be removed and their offsets wouldn't be updated.
+	// starpaks that were written by rpaks that aren't passed, or that come from the
+	// game, are only compacted with compactShared
+	void CompactStarpaks(CPakFile* pak, const std::vector<std::string>& rpakPaths, bool compactShared = false);
+};
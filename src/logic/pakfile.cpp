@@ -7,6 +7,10 @@
 #include "pch.h"
 #include "pakfile.h"
 #include "application/repak.h"
+#include "utils/dxutils.h"
+#include "public/texture.h"
+#include "public/segmentlayout.h"
+#include "utils/imageloader.h"
 
 //-----------------------------------------------------------------------------
 // purpose: constructor
@@ -30,6 +34,235 @@ void CPakFile::AddAsset(rapidjson::Value& file)
 	ASSET_HANDLER("rseq", file, m_Assets, Assets::AddAnimSeqAsset_stub, Assets::AddAnimSeqAsset_v7);
 }
 
+//-----------------------------------------------------------------------------
+// purpose: builds all assets from the map file's file list
+//-----------------------------------------------------------------------------
+void CPakFile::AddAssets(rapidjson::Value& files)
+{
+	if (m_Settings.m_NumThreads > 1 && files.Size() > 1)
+	{
+		AddAssetsConcurrently(files);
+		return;
+	}
+
+	for (auto& file : files.GetArray())
+	{
+		uint32_t firstNewAsset = m_Assets.size();
+		uint32_t firstNewPage = m_vPages.size();
+
+		AddAsset(file);
+
+		for (uint32_t i = firstNewAsset; i < m_Assets.size(); ++i)
+		{
+			m_Assets[i]._firstPage = firstNewPage;
+			m_Assets[i]._endPage = m_vPages.size();
+
+			IndexAsset(i, file["path"].GetString());
+		}
+
+		FlushRawDataBlocks();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: builds all assets on a pool of worker threads
+//          each asset is built into its own staging pak, which is then merged
+//          into this pak in map order so that the page layout, descriptors and
+//          asset order are identical to a serial build. relations are resolved
+//          after all assets are in, see ResolveAssetRelations
+//-----------------------------------------------------------------------------
+void CPakFile::AddAssetsConcurrently(rapidjson::Value& files)
+{
+	const uint32_t numFiles = files.Size();
+	const uint32_t numWorkers = (uint32_t)m_Settings.m_NumThreads < numFiles ? m_Settings.m_NumThreads : numFiles;
+
+	// limit how far the workers can get ahead of the merge, so that
+	// finished staging paks don't pile up in memory behind a slow asset
+	const uint32_t maxStagedFiles = numWorkers * 4;
+
+	std::vector<std::unique_ptr<CPakFile>> stagedPaks(numFiles);
+	std::atomic<uint32_t> nextFile = 0;
+	uint32_t nextMerge = 0;
+
+	std::mutex mutex;
+	std::condition_variable stagedCond;
+	std::condition_variable mergedCond;
+
+	auto workerFunc = [&](uint32_t worker)
+	{
+		// the threads are shared out over the workers, so that the assets of maps with
+		// fewer files than threads can still use all of them, e.g. to encode textures
+		const int numThreads = m_Settings.m_NumThreads / numWorkers + (worker < m_Settings.m_NumThreads % numWorkers ? 1 : 0);
+
+		for (uint32_t i = nextFile++; i < numFiles; i = nextFile++)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				mergedCond.wait(lock, [&] { return i < nextMerge + maxStagedFiles; });
+			}
+
+			std::unique_ptr<CPakFile> stage = CreateStage(numThreads);
+			stage->AddAsset(files[i]);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stagedPaks[i] = std::move(stage);
+			}
+			stagedCond.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < numWorkers; ++i)
+		workers.emplace_back(workerFunc, i);
+
+	for (uint32_t i = 0; i < numFiles; ++i)
+	{
+		std::unique_ptr<CPakFile> stage;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stagedCond.wait(lock, [&] { return stagedPaks[i] != nullptr; });
+			stage = std::move(stagedPaks[i]);
+		}
+
+		MergeStagedPak(*stage, files[i]["path"].GetString());
+		FlushRawDataBlocks();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			nextMerge = i + 1;
+		}
+		mergedCond.notify_all();
+	}
+
+	for (auto& it : workers)
+		it.join();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: creates a staging pak that builds assets with the settings of this pak
+//-----------------------------------------------------------------------------
+std::unique_ptr<CPakFile> CPakFile::CreateStage(int numThreads) const
+{
+	std::unique_ptr<CPakFile> stage = std::make_unique<CPakFile>(GetVersion());
+
+	stage->m_Settings = m_Settings;
+	stage->m_Settings.m_NumThreads = numThreads;
+
+	return stage;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: moves the pages, data blocks and assets of a staging pak into this pak
+//          page indices and starpak offsets are rebased onto the ones of this pak
+//-----------------------------------------------------------------------------
+void CPakFile::MergeStagedPak(CPakFile& stage, const char* assetPath)
+{
+	const uint32_t pageBase = m_vPages.size();
+
+	// recreate the pages through the same segment matching that a serial build does
+	for (auto& it : stage.m_vPages)
+	{
+		const RPakVirtualSegment& seg = stage.m_vVirtualSegments[it.segIdx];
+		CreateNewSegment(it.dataSize, seg.flags, it.pageAlignment, seg.alignment);
+	}
+
+	// look up the data of each page once instead of searching the blocks for every descriptor
+	// asset builders add exactly one data block per page, which the descriptors rely on
+	std::vector<RPakRawDataBlock*> pageBlocks(stage.m_vPages.size(), nullptr);
+	for (auto& it : stage.m_vRawDataBlocks)
+	{
+		if (it.m_nPageIdx >= pageBlocks.size() || pageBlocks[it.m_nPageIdx])
+			Error("staged asset '%s' has data for page %i, which does not exist or already has data\n", assetPath, it.m_nPageIdx);
+
+		pageBlocks[it.m_nPageIdx] = &it;
+	}
+
+	// every page pointer is registered as a descriptor, so the descriptors
+	// tell us where the page indices are that need to be rebased
+	for (auto& it : stage.m_vPakDescriptors)
+	{
+		RPakRawDataBlock* block = it.index < pageBlocks.size() ? pageBlocks[it.index] : nullptr;
+
+		if (!block)
+			Error("failed to find data for page %i while merging staged asset '%s'\n", it.index, assetPath);
+
+		if ((uint64_t)it.offset + sizeof(RPakPtr) > block->m_nDataSize)
+			Error("staged asset '%s' has a pointer at %i:%i, which is outside of the page data\n", assetPath, it.index, it.offset);
+
+		RPakPtr* ptr = reinterpret_cast<RPakPtr*>(block->m_nDataPtr + it.offset);
+
+		// a pointer into a page that the stage doesn't have would be rebased onto a page of another asset
+		if (ptr->index >= stage.m_vPages.size())
+			Error("staged asset '%s' has a pointer at %i:%i to page %i, which is not one of its pages\n", assetPath, it.index, it.offset, ptr->index);
+
+		ptr->index += pageBase;
+
+		AddPointer(it.index + pageBase, it.offset);
+	}
+
+	for (auto& it : stage.m_vRawDataBlocks)
+	{
+		it.m_nPageIdx += pageBase;
+		AddRawDataBlock(it);
+	}
+
+	// staged starpak entries are added to ours in the order they were added to the stage, same as
+	// in a serial build. the offsets the staged assets use are mapped to where each entry ended up,
+	// which may be an earlier entry with the same data
+	std::unordered_map<__int64, __int64> offsetRemap[2];
+
+	for (int i = 0; i < 2; ++i)
+	{
+		const bool optional = i == 1;
+
+		for (auto& stageStarpak : stage.GetStarpaks(optional))
+		{
+			for (auto& it : stageStarpak->m_vDataBlocks)
+			{
+				const __int64 stageOffset = it.GetAssetOffset();
+
+				StreamableDataEntry block = AddStarpakDataEntry(it, stageStarpak->m_Path, optional);
+				offsetRemap[i][stageOffset] = block.GetAssetOffset();
+
+				// the data is owned by our entry now
+				it.m_nDataPtr = nullptr;
+			}
+		}
+	}
+
+	auto rebaseAssetOffset = [&](__int64& offset, int i)
+	{
+		if (offset != -1)
+			offset = offsetRemap[i].at(offset);
+	};
+
+	AddTextureMemoryUsage(stage.m_ResidentTextureSize, stage.m_StreamedTextureSize, stage.m_OptStreamedTextureSize);
+
+	for (auto& it : stage.m_Assets)
+	{
+		it.headIdx += pageBase;
+
+		if (it.cpuIdx != -1)
+			it.cpuIdx += pageBase;
+
+		it.pageEnd += pageBase;
+
+		rebaseAssetOffset(it.starpakOffset, 0);
+		rebaseAssetOffset(it.optStarpakOffset, 1);
+
+		for (auto& guid : it._guids)
+			guid.index += pageBase;
+
+		it._firstPage = pageBase;
+		it._endPage = m_vPages.size();
+
+		m_Assets.push_back(it);
+
+		IndexAsset(m_Assets.size() - 1, assetPath);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // purpose: adds page pointer to descriptor
 //-----------------------------------------------------------------------------
@@ -56,350 +289,1852 @@ void CPakFile::AddRawDataBlock(RPakRawDataBlock block)
 
 //-----------------------------------------------------------------------------
 // purpose: adds new starpak file path to be used by the rpak
+// returns: index of the starpak in the rpak's starpak list
+//-----------------------------------------------------------------------------
+uint32_t CPakFile::AddStarpakReference(const std::string& path)
+{
+	return AddStarpak(path, false, false);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: adds new optional starpak file path to be used by the rpak
+// returns: index of the starpak in the rpak's optional starpak list
+//-----------------------------------------------------------------------------
+uint32_t CPakFile::AddOptStarpakReference(const std::string& path)
+{
+	return AddStarpak(path, true, false);
+}
+
 //-----------------------------------------------------------------------------
-void CPakFile::AddStarpakReference(const std::string& path)
+// purpose: adds a starpak path to the mandatory or optional list of the rpak
+//          external starpaks already exist and are only referenced, the others
+//          get written by this build
+// returns: index of the starpak in the list
+//-----------------------------------------------------------------------------
+uint32_t CPakFile::AddStarpak(const std::string& path, bool optional, bool external)
 {
-	for (auto& it : m_vStarpakPaths)
+	std::vector<std::string>& paths = optional ? m_vOptStarpakPaths : m_vStarpakPaths;
+	std::vector<std::unique_ptr<PakStarpakData>>& starpaks = GetStarpaks(optional);
+
+	for (uint32_t i = 0; i < paths.size(); ++i)
 	{
-		if (it == path)
-			return;
+		if (paths[i] != path)
+			continue;
+
+		// an existing starpak can't be written to, as the offsets of its data would change
+		if (starpaks[i]->m_bExternal != external)
+			Error("starpak '%s' is shared with other rpaks and can't also have new data written to it by this build\n", path.c_str());
+
+		return i;
+	}
+	paths.push_back(path);
+
+	starpaks.push_back(std::make_unique<PakStarpakData>());
+	PakStarpakData& starpak = *starpaks.back();
+
+	starpak.m_Path = path;
+	starpak.m_bExternal = external;
+
+	// the data of a starpak from a previous build stays where it is, new data goes after it
+	auto appended = m_AppendedStarpaks.find(path);
+
+	if (!external && appended != m_AppendedStarpaks.end())
+	{
+		for (auto& it : appended->second)
+		{
+			StreamableDataEntry block;
+			block.m_nOffset = it.m_nOffset;
+			block.m_nDataSize = it.m_nSize;
+			block.m_nStarpakIdx = paths.size() - 1;
+
+			starpak.m_vDataBlocks.push_back(block);
+
+			if (it.m_nOffset + it.m_nSize > starpak.m_nNextOffset)
+				starpak.m_nNextOffset = it.m_nOffset + it.m_nSize;
+		}
+
+		starpak.m_nAppendOffset = starpak.m_nNextOffset;
 	}
-	m_vStarpakPaths.push_back(path);
+
+	if (m_bStreamStarpakData && !external)
+		StartStarpakWriter(starpak);
+
+	return paths.size() - 1;
 }
 
 //-----------------------------------------------------------------------------
-// purpose: adds new optional starpak file path to be used by the rpak
+// purpose: indexes the data of a starpak from a previous build before anything
+//          is added to it, so data that it already has isn't appended again
 //-----------------------------------------------------------------------------
-void CPakFile::AddOptStarpakReference(const std::string& path)
+void CPakFile::LoadAppendedStarpak(const std::string& path, bool optional)
 {
-	for (auto& it : m_vOptStarpakPaths)
+	if (m_AppendedStarpaks.count(path))
+		return;
+
+	// once the starpak is in use, the file in the output directory is the one being written
+	for (auto& it : GetStarpaks(optional))
 	{
-		if (it == path)
+		if (it->m_Path == path)
 			return;
 	}
-	m_vOptStarpakPaths.push_back(path);
+
+	const std::string filePath = GetStarpakOutputPath(path);
+
+	if (!fs::exists(filePath))
+		return;
+
+	std::vector<SRPkFileEntry> entries = LoadStarpakIndex(filePath, path, optional, false);
+
+	for (auto& it : entries)
+	{
+		if (it.m_nOffset % STARPAK_DATABLOCK_ALIGNMENT != 0 || it.m_nSize % STARPAK_DATABLOCK_ALIGNMENT != 0)
+			Error("can't append to starpak file '%s', data entry %lld:%lld is not aligned to %i bytes\n", filePath.c_str(), it.m_nOffset, it.m_nSize, STARPAK_DATABLOCK_ALIGNMENT);
+	}
+
+	m_AppendedStarpaks.emplace(path, std::move(entries));
 }
 
 //-----------------------------------------------------------------------------
-// purpose: adds new starpak data entry
+// purpose: adds new starpak data entry to the mandatory or the optional starpak
+//          with the given path, which gets referenced by the rpak if it isn't yet
 // returns: starpak data entry descriptor
 //-----------------------------------------------------------------------------
-StreamableDataEntry CPakFile::AddStarpakDataEntry(StreamableDataEntry block)
+StreamableDataEntry CPakFile::AddStarpakDataEntry(StreamableDataEntry block, const std::string& starpakPath, bool optional)
 {
-	// starpak data is aligned to 4096 bytes
-	size_t ns = Utils::PadBuffer((char**)&block.m_nDataPtr, block.m_nDataSize, 4096);
+	// data is copied from the source file when written, only its size is known here
+	if (!block.m_vSourceRanges.empty())
+	{
+		block.m_nDataSize = 0;
+		for (auto& it : block.m_vSourceRanges)
+			block.m_nDataSize += it.m_nSize;
+	}
+
+	// starpak data is aligned to 4096 bytes, the padding is only generated when writing
+	block.m_nAlignment = STARPAK_DATABLOCK_ALIGNMENT;
+
+	if (m_Settings.m_bHashStreamedData && !block.m_bHashed)
+	{
+		block.m_Hash = HashStreamableData(block);
+		block.m_bHashed = true;
+	}
+
+	if (m_bAppendStarpaks && m_bDedupStreamedData)
+		LoadAppendedStarpak(starpakPath, optional);
+
+	auto& index = m_StreamingDataIndex[optional];
+
+	// data that has already been written, or is in a shared starpak, is only referenced
+	if (m_bDedupStreamedData)
+	{
+		auto it = index.find(block.m_Hash);
+
+		if (it != index.end() && it->second.m_nPaddedSize == block.GetPaddedSize() && IsSameStreamableData(block, it->second, optional))
+		{
+			delete[] block.m_nDataPtr;
+			block.m_nDataPtr = nullptr;
+
+			block.m_nOffset = it->second.m_nOffset;
+			block.m_nStarpakIdx = AddStarpak(it->second.m_StarpakPath, optional, it->second.m_bExternal);
 
-	block.m_nDataSize = ns;
-	block.m_nOffset = m_NextStarpakOffset;
+			m_nDedupCount++;
+			m_nDedupSize += block.GetPaddedSize();
 
-	m_vStarpakDataBlocks.push_back(block);
+			return block;
+		}
+	}
+
+	uint32_t starpakIdx = AddStarpak(starpakPath, optional, false);
+
+	if (starpakIdx > STARPAK_INDEX_MASK)
+		Error("attempted to add streamed data to starpak '%s', but the rpak already references the maximum of %i %sstarpaks\n", starpakPath.c_str(), STARPAK_INDEX_MASK + 1, optional ? "optional " : "");
+
+	PakStarpakData& starpak = *GetStarpaks(optional)[starpakIdx];
+
+	block.m_nOffset = starpak.m_nNextOffset;
+	block.m_nStarpakIdx = starpakIdx;
+
+	if (m_bDedupStreamedData)
+		index.emplace(block.m_Hash, StreamableDataLocation{ starpakPath, block.m_nOffset, block.GetPaddedSize(), false });
+
+	if (m_bStreamStarpakData)
+		QueueStarpakDataEntry(starpak, block);
 
-	m_NextStarpakOffset += block.m_nDataSize;
+	starpak.m_vDataBlocks.push_back(block);
+
+	starpak.m_nNextOffset += block.GetPaddedSize();
 
 	return block;
 }
 
 //-----------------------------------------------------------------------------
-// purpose: writes header to file stream
+// purpose: hashes the data of a starpak data entry as it will be in the starpak,
+//          including the padding up to its alignment
 //-----------------------------------------------------------------------------
-void CPakFile::WriteHeader(BinaryIO& io)
+ContentHash CPakFile::HashStreamableData(const StreamableDataEntry& block)
 {
-	m_Header.virtualSegmentCount = m_vVirtualSegments.size();
-	m_Header.pageCount = m_vPages.size();
-	m_Header.descriptorCount = m_vPakDescriptors.size();
-	m_Header.guidDescriptorCount = m_vGuidDescriptors.size();
-	m_Header.relationCount = m_vFileRelations.size();
+	static const uint8_t s_ZeroPadding[STARPAK_DATABLOCK_ALIGNMENT]{};
 
-	int version = m_Header.fileVersion;
+	ContentHasher hasher;
 
-	io.write(m_Header.magic);
-	io.write(m_Header.fileVersion);
-	io.write(m_Header.flags);
-	io.write(m_Header.fileTime);
-	io.write(m_Header.unk0);
-	io.write(m_Header.compressedSize);
+	if (!block.m_vSourceRanges.empty())
+	{
+		MappedFile source;
 
-	if (version == 8)
-		io.write(m_Header.embeddedStarpakOffset);
+		if (!source.open(block.m_SourcePath))
+			Error("failed to map streamed data source file '%s'\n", block.m_SourcePath.c_str());
 
-	io.write(m_Header.unk1);
-	io.write(m_Header.decompressedSize);
+		for (auto& it : block.m_vSourceRanges)
+		{
+			if (it.m_nOffset + it.m_nSize > source.getSize())
+				Error("streamed data range %lld:%lld is out of bounds for source file '%s' with size %lld\n", it.m_nOffset, it.m_nSize, block.m_SourcePath.c_str(), source.getSize());
 
-	if (version == 8)
-		io.write(m_Header.embeddedStarpakSize);
+			hasher.update(source.getData() + it.m_nOffset, it.m_nSize);
+		}
 
-	io.write(m_Header.unk2);
-	io.write(m_Header.starpakPathsSize);
+		source.close();
+	}
+	else
+	{
+		hasher.update(block.m_nDataPtr, block.m_nDataSize);
+	}
 
-	if (version == 8)
-		io.write(m_Header.optStarpakPathsSize);
+	for (uint64_t padding = block.GetPaddedSize() - block.m_nDataSize; padding > 0;)
+	{
+		uint64_t chunkSize = padding < sizeof(s_ZeroPadding) ? padding : sizeof(s_ZeroPadding);
 
-	io.write(m_Header.virtualSegmentCount);
-	io.write(m_Header.pageCount);
-	io.write(m_Header.patchIndex);
+		hasher.update(s_ZeroPadding, chunkSize);
+		padding -= chunkSize;
+	}
 
-	if (version == 8)
-		io.write(m_Header.alignment);
+	return hasher.finish();
+}
 
-	io.write(m_Header.descriptorCount);
-	io.write(m_Header.assetCount);
-	io.write(m_Header.guidDescriptorCount);
-	io.write(m_Header.relationCount);
+//-----------------------------------------------------------------------------
+// purpose: reads the data of a starpak data entry as it will be in the starpak,
+//          including the padding up to its alignment
+//-----------------------------------------------------------------------------
+void CPakFile::ReadStreamableData(const StreamableDataEntry& block, std::vector<uint8_t>& data)
+{
+	data.assign(block.GetPaddedSize(), 0);
 
-	if (version == 7)
+	if (!block.m_vSourceRanges.empty())
 	{
-		io.write(m_Header.unk7count);
-		io.write(m_Header.unk8count);
+		MappedFile source;
+
+		if (!source.open(block.m_SourcePath))
+			Error("failed to map streamed data source file '%s'\n", block.m_SourcePath.c_str());
+
+		uint64_t offset = 0;
+
+		for (auto& it : block.m_vSourceRanges)
+		{
+			if (it.m_nOffset + it.m_nSize > source.getSize())
+				Error("streamed data range %lld:%lld is out of bounds for source file '%s' with size %lld\n", it.m_nOffset, it.m_nSize, block.m_SourcePath.c_str(), source.getSize());
+
+			memcpy(data.data() + offset, source.getData() + it.m_nOffset, it.m_nSize);
+			offset += it.m_nSize;
+		}
+
+		source.close();
+	}
+	else if (block.m_nDataSize > 0)
+	{
+		memcpy(data.data(), block.m_nDataPtr, block.m_nDataSize);
 	}
-	else if (version == 8)
-		io.write(m_Header.unk3);
 }
 
 //-----------------------------------------------------------------------------
-// purpose: writes assets to file stream
+// purpose: reads the data at an indexed starpak location, from the starpak that
+//          is being written by this build or from the file of an existing starpak
 //-----------------------------------------------------------------------------
-void CPakFile::WriteAssets(BinaryIO& io)
+void CPakFile::ReadStoredStreamableData(const StreamableDataLocation& location, bool optional, std::vector<uint8_t>& data)
 {
-	for (auto& it : m_Assets)
+	data.resize(location.m_nPaddedSize);
+
+	for (auto& it : GetStarpaks(optional))
 	{
-		io.write(it.guid);
-		io.write(it.unk0);
-		io.write(it.headIdx);
-		io.write(it.headOffset);
-		io.write(it.cpuIdx);
-		io.write(it.cpuOffset);
-		io.write(it.starpakOffset);
+		PakStarpakData& starpak = *it;
 
-		if (this->m_Header.fileVersion == 8)
-			io.write(it.optStarpakOffset);
+		if (location.m_bExternal || starpak.m_Path != location.m_StarpakPath)
+			continue;
 
-		io.write(it.pageEnd);
-		io.write(it.unk1);
-		io.write(it.relStartIdx);
-		io.write(it.usesStartIdx);
-		io.write(it.relationCount);
-		io.write(it.usesCount);
-		io.write(it.headDataSize);
-		io.write(it.version);
-		io.write(it.id);
+		if (m_bStreamStarpakData)
+		{
+			// the writer is idle once it has nothing queued, and no entries are queued while we read
+			std::unique_lock<std::mutex> lock(starpak.m_Mutex);
+			starpak.m_Cond.wait(lock, [&] { return starpak.m_PendingBlocks.empty() && !starpak.m_bWriting; });
+
+			starpak.m_Stream.readWritten(location.m_nOffset, data.data(), data.size());
+			return;
+		}
+
+		// entries are kept in the order of their offsets
+		auto block = std::lower_bound(starpak.m_vDataBlocks.begin(), starpak.m_vDataBlocks.end(), location.m_nOffset,
+			[](const StreamableDataEntry& entry, uint64_t offset) { return entry.m_nOffset < offset; });
+
+		if (block != starpak.m_vDataBlocks.end() && block->m_nOffset == location.m_nOffset && (block->m_nDataPtr || !block->m_vSourceRanges.empty()))
+		{
+			ReadStreamableData(*block, data);
+			return;
+		}
+
+		// data of a starpak from a previous build that hasn't been written again yet
+		break;
 	}
 
-	// update header asset count with the assets we've just written
-	this->m_Header.assetCount = m_Assets.size();
-}
+	MappedFile input;
+
+	if (!input.open(location.m_FilePath))
+		Error("failed to open starpak file '%s'\n", location.m_FilePath.c_str());
+
+	if (location.m_nOffset + data.size() > input.getSize())
+		Error("starpak file '%s' has data entry %lld:%lld which is out of bounds\n", location.m_FilePath.c_str(), location.m_nOffset, data.size());
+
+	memcpy(data.data(), input.getData() + location.m_nOffset, data.size());
+
+	input.close();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: compares the data of a starpak data entry with the data at a location
+//          that has the same hash, so that a hash collision can't make an asset
+//          reference the data of another one
+// returns: true if the data is the same
+//-----------------------------------------------------------------------------
+bool CPakFile::IsSameStreamableData(const StreamableDataEntry& block, const StreamableDataLocation& location, bool optional)
+{
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> stored;
+
+	ReadStreamableData(block, data);
+	ReadStoredStreamableData(location, optional, stored);
+
+	if (data.size() == stored.size() && !memcmp(data.data(), stored.data(), data.size()))
+		return true;
+
+	Warning("streamed data with hash %016llX%016llX differs from the data in starpak '%s' at offset %lld with the same hash, it is written again\n",
+		block.m_Hash.hi, block.m_Hash.lo, location.m_StarpakPath.c_str(), location.m_nOffset);
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: reads the sorts table at the end of a mapped starpak file
+//          (see WriteStarpakSortsTable) and checks that its entries are in the file
+// returns: offsets and padded sizes of all data entries in the starpak
+//-----------------------------------------------------------------------------
+std::vector<SRPkFileEntry> CPakFile::ReadStarpakSortsTable(const MappedFile& input, const std::string& filePath)
+{
+	const uint8_t* data = input.getData();
+	const uint64_t size = input.getSize();
+
+	uint64_t entryCount = 0;
+
+	if (size >= sizeof(StreamableSetHeader) + sizeof(entryCount))
+		memcpy(&entryCount, data + size - sizeof(entryCount), sizeof(entryCount));
+
+	const StreamableSetHeader* pHeader = reinterpret_cast<const StreamableSetHeader*>(data);
+
+	if (size < sizeof(StreamableSetHeader) + sizeof(entryCount) || pHeader->magic != STARPAK_MAGIC || entryCount > (size - sizeof(entryCount)) / sizeof(SRPkFileEntry))
+		Error("starpak file '%s' is not a valid starpak\n", filePath.c_str());
+
+	const uint64_t tableOffset = size - sizeof(entryCount) - entryCount * sizeof(SRPkFileEntry);
+
+	const SRPkFileEntry* pEntries = reinterpret_cast<const SRPkFileEntry*>(data + tableOffset);
+	std::vector<SRPkFileEntry> entries(pEntries, pEntries + entryCount);
+
+	for (auto& it : entries)
+	{
+		if (it.m_nOffset < STARPAK_DATABLOCK_ALIGNMENT || it.m_nOffset > tableOffset || it.m_nSize > tableOffset - it.m_nOffset)
+			Error("starpak file '%s' has data entry %lld:%lld which is out of bounds\n", filePath.c_str(), it.m_nOffset, it.m_nSize);
+	}
+
+	return entries;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: adds the data blocks of an existing starpak to the streamed data index
+//          the blocks are found through the sorts table at the end of the file
+//          and hashed with their padding, same as new data
+// returns: the sorts table of the starpak
+//-----------------------------------------------------------------------------
+std::vector<SRPkFileEntry> CPakFile::LoadStarpakIndex(const std::string& filePath, const std::string& starpakPath, bool optional, bool external)
+{
+	MappedFile input;
+
+	if (!input.open(filePath))
+		Error("failed to open starpak file '%s'\n", filePath.c_str());
+
+	std::vector<SRPkFileEntry> entries = ReadStarpakSortsTable(input, filePath);
+
+	const uint8_t* data = input.getData();
+	const uint64_t entryCount = entries.size();
+
+	std::vector<ContentHash> hashes(entryCount);
+
+	// starpaks can be many gigabytes, so the blocks are hashed on all build threads
+	std::atomic<uint64_t> nextEntry = 0;
+
+	auto workerFunc = [&]()
+	{
+		for (uint64_t i = nextEntry++; i < entryCount; i = nextEntry++)
+		{
+			const SRPkFileEntry& entry = entries[i];
+
+			ContentHasher hasher;
+			hasher.update(data + entry.m_nOffset, entry.m_nSize);
+
+			hashes[i] = hasher.finish();
+		}
+	};
+
+	const uint32_t numWorkers = (uint64_t)m_Settings.m_NumThreads < entryCount ? m_Settings.m_NumThreads : (uint32_t)entryCount;
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < numWorkers; ++i)
+		workers.emplace_back(workerFunc);
+
+	workerFunc();
+
+	for (auto& it : workers)
+		it.join();
+
+	auto& index = m_StreamingDataIndex[optional];
+
+	for (uint64_t i = 0; i < entryCount; ++i)
+		index.emplace(hashes[i], StreamableDataLocation{ starpakPath, entries[i].m_nOffset, entries[i].m_nSize, external, filePath });
+
+	input.close();
+
+	Log("indexed %lld data entries of %s starpak '%s'\n", entryCount, external ? "shared" : "existing", starpakPath.c_str());
+
+	return entries;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes header to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteHeader(BinaryIO& io)
+{
+	m_Header.virtualSegmentCount = m_vVirtualSegments.size();
+	m_Header.pageCount = m_vPackedPages.size();
+	m_Header.descriptorCount = m_vPakDescriptors.size();
+	m_Header.guidDescriptorCount = m_vGuidDescriptors.size();
+	m_Header.relationCount = m_vFileRelations.size();
+
+	int version = m_Header.fileVersion;
+
+	io.write(m_Header.magic);
+	io.write(m_Header.fileVersion);
+	io.write(m_Header.flags);
+	io.write(m_Header.fileTime);
+	io.write(m_Header.unk0);
+	io.write(m_Header.compressedSize);
+
+	if (version == 8)
+		io.write(m_Header.embeddedStarpakOffset);
+
+	io.write(m_Header.unk1);
+	io.write(m_Header.decompressedSize);
+
+	if (version == 8)
+		io.write(m_Header.embeddedStarpakSize);
+
+	io.write(m_Header.unk2);
+	io.write(m_Header.starpakPathsSize);
+
+	if (version == 8)
+		io.write(m_Header.optStarpakPathsSize);
+
+	io.write(m_Header.virtualSegmentCount);
+	io.write(m_Header.pageCount);
+	io.write(m_Header.patchIndex);
+
+	if (version == 8)
+		io.write(m_Header.alignment);
+
+	io.write(m_Header.descriptorCount);
+	io.write(m_Header.assetCount);
+	io.write(m_Header.guidDescriptorCount);
+	io.write(m_Header.relationCount);
+
+	if (version == 7)
+	{
+		io.write(m_Header.unk7count);
+		io.write(m_Header.unk8count);
+	}
+	else if (version == 8)
+		io.write(m_Header.unk3);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes assets to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteAssets(BinaryIO& io)
+{
+	for (auto& it : m_Assets)
+	{
+		io.write(it.guid);
+		io.write(it.unk0);
+		io.write(it.headIdx);
+		io.write(it.headOffset);
+		io.write(it.cpuIdx);
+		io.write(it.cpuOffset);
+		io.write(it.starpakOffset);
+
+		if (this->m_Header.fileVersion == 8)
+			io.write(it.optStarpakOffset);
+
+		io.write(it.pageEnd);
+		io.write(it.unk1);
+		io.write(it.relStartIdx);
+		io.write(it.usesStartIdx);
+		io.write(it.relationCount);
+		io.write(it.usesCount);
+		io.write(it.headDataSize);
+		io.write(it.version);
+		io.write(it.id);
+	}
+
+	// update header asset count with the assets we've just written
+	this->m_Header.assetCount = m_Assets.size();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes raw data blocks to file stream
+//          the page pointers in the blocks are moved to the final pages on the way,
+//          blocks that were flushed are read back from the temporary page data file
+//-----------------------------------------------------------------------------
+void CPakFile::WriteRawDataBlocks(BinaryIO& out)
+{
+	BinaryIO pageData;
+
+	if (!m_PageDataStreamPath.empty())
+	{
+		m_PageDataStream.close();
+
+		if (!pageData.open(m_PageDataStreamPath, BinaryIOMode::Read, BIO_MAPPED))
+			Error("failed to open temporary page data file '%s'\n", m_PageDataStreamPath.c_str());
+	}
+
+	std::vector<FileWriteSpan> spans;
+	spans.reserve(m_vRawDataBlocks.size());
+
+	// flushed blocks are copied into this before their pointers are moved over
+	std::unique_ptr<uint8_t[]> flushedData;
+	uint64_t flushedDataSize = 0;
+
+	// the descriptors are in the same order as the blocks they are in, see LayoutPages
+	size_t descIdx = 0;
+	uint32_t pageIdx = UINT32_MAX;
+	uint64_t pageOffset = 0;
+
+	for (auto& it : m_vRawDataBlocks)
+	{
+		if (it.m_nPageIdx != pageIdx)
+		{
+			pageIdx = it.m_nPageIdx;
+			pageOffset = 0;
+		}
+
+		uint8_t* data = it.m_nDataPtr;
+
+		if (!data)
+		{
+			// the spans that use the previous copy have to be written before it gets replaced
+			out.writeSpans(spans);
+			spans.clear();
+
+			if (it.m_nDataSize > flushedDataSize)
+			{
+				flushedData.reset(new uint8_t[it.m_nDataSize]);
+				flushedDataSize = it.m_nDataSize;
+			}
+
+			data = flushedData.get();
+			memcpy(data, pageData.getData() + it.m_nStreamOffset, it.m_nDataSize);
+		}
+
+		for (; descIdx < m_vPakDescriptors.size(); ++descIdx)
+		{
+			const RPakDescriptor& desc = m_vPakDescriptors[descIdx];
+
+			if (desc.index != pageIdx || desc.offset >= pageOffset + it.m_nDataSize)
+				break;
+
+			RPakPtr* ptr = reinterpret_cast<RPakPtr*>(data + (desc.offset - pageOffset));
+
+			if (ptr->index >= m_vPageLocations.size())
+				Error("page pointer at %i:%i points to page %i, which does not exist\n", desc.index, desc.offset, ptr->index);
+
+			const PakPageLocation& target = m_vPageLocations[ptr->index];
+			ptr->index = target.m_nPageIdx;
+			ptr->offset += target.m_nOffset;
+		}
+
+		spans.push_back({ data, it.m_nDataSize });
+		Utils::AddPaddingSpans(spans, it.GetPaddedSize() - it.m_nDataSize);
+
+		pageOffset += it.GetPaddedSize();
+	}
+
+	if (descIdx != m_vPakDescriptors.size())
+		Error("descriptor for %i:%i is not inside of any data block\n", m_vPakDescriptors[descIdx].index, m_vPakDescriptors[descIdx].offset);
+
+	out.writeSpans(spans);
+
+	if (!m_PageDataStreamPath.empty())
+	{
+		pageData.close();
+
+		fs::remove(m_PageDataStreamPath);
+		m_PageDataStreamPath.clear();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes the data of the raw data blocks that have been added so far
+//          to the temporary page data file and frees it (PF_STREAM_PAGES only)
+//          the blocks stay around so they can be laid out and read back later
+//          data blocks must be final when this is called
+//-----------------------------------------------------------------------------
+void CPakFile::FlushRawDataBlocks()
+{
+	if (!IsFlagSet(PF_STREAM_PAGES))
+		return;
+
+	if (m_PageDataStreamPath.empty())
+	{
+		m_PageDataStreamPath = GetPath() + ".pages.tmp";
+
+		if (!m_PageDataStream.open(m_PageDataStreamPath, BinaryIOMode::Write, BIO_BUFFERED))
+			Error("failed to open temporary page data file '%s'\n", m_PageDataStreamPath.c_str());
+	}
+
+	std::vector<FileWriteSpan> spans;
+	spans.reserve(m_vRawDataBlocks.size() - m_nFlushedBlockCount);
+
+	for (size_t i = m_nFlushedBlockCount; i < m_vRawDataBlocks.size(); ++i)
+	{
+		RPakRawDataBlock& block = m_vRawDataBlocks[i];
+		spans.push_back({ block.m_nDataPtr, block.m_nDataSize });
+
+		block.m_nStreamOffset = m_nPageDataStreamSize;
+		m_nPageDataStreamSize += block.m_nDataSize;
+	}
+
+	m_PageDataStream.writeSpans(spans);
+
+	for (size_t i = m_nFlushedBlockCount; i < m_vRawDataBlocks.size(); ++i)
+	{
+		delete[] m_vRawDataBlocks[i].m_nDataPtr;
+		m_vRawDataBlocks[i].m_nDataPtr = nullptr;
+	}
+
+	m_nFlushedBlockCount = m_vRawDataBlocks.size();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes starpak paths to file stream
+// returns: total length of written path vector
+//-----------------------------------------------------------------------------
+size_t CPakFile::WriteStarpakPaths(BinaryIO& out, bool optional)
+{
+	if (optional)
+		return Utils::WriteStringVector(out, m_vOptStarpakPaths);
+	else
+		return Utils::WriteStringVector(out, m_vStarpakPaths);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes virtual segments to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteVirtualSegments(BinaryIO& out)
+{
+	WRITE_VECTOR(out, m_vVirtualSegments);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes pages to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WritePages(BinaryIO& out)
+{
+	WRITE_VECTOR(out, m_vPackedPages);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes pak descriptors to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WritePakDescriptors(BinaryIO& out)
+{
+	WRITE_VECTOR(out, m_vPakDescriptors);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes guid descriptors to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteGuidDescriptors(BinaryIO& out)
+{
+	WRITE_VECTOR(out, m_vGuidDescriptors);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes file relations to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteFileRelations(BinaryIO& out)
+{
+	WRITE_VECTOR(out, m_vFileRelations);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the first data block of a starpak, its header and the padding up
+//          to the first data entry, which holds the rpaks that wrote data to it
+//-----------------------------------------------------------------------------
+static std::vector<uint8_t> GetStarpakHeader(const std::vector<std::string>& creators)
+{
+	std::vector<uint8_t> header(STARPAK_DATABLOCK_ALIGNMENT, STARPAK_DATABLOCK_ALIGNMENT_PADDING);
+
+	StreamableSetHeader srpkHeader{ STARPAK_MAGIC , STARPAK_VERSION };
+	memcpy(header.data(), &srpkHeader, sizeof(srpkHeader));
+
+	if (creators.empty())
+		return header;
+
+	const uint32_t magic = STARPAK_CREATORS_MAGIC;
+
+	// the magic, each name with its terminator and the empty string at the end
+	size_t size = sizeof(srpkHeader) + sizeof(magic) + 1;
+	for (auto& it : creators)
+		size += it.size() + 1;
+
+	if (size > header.size())
+	{
+		Warning("starpak is written to by too many rpaks to record all of them, it can only be compacted with -compactshared\n");
+		return header;
+	}
+
+	uint8_t* pos = header.data() + sizeof(srpkHeader);
+
+	memcpy(pos, &magic, sizeof(magic));
+	pos += sizeof(magic);
+
+	for (auto& it : creators)
+	{
+		memcpy(pos, it.c_str(), it.size() + 1);
+		pos += it.size() + 1;
+	}
+
+	*pos = '\0';
+
+	return header;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes starpak header and the padding up to the first data block
+//-----------------------------------------------------------------------------
+void CPakFile::WriteStarpakHeader(BinaryIO& out, const std::vector<std::string>& creators)
+{
+	const std::vector<uint8_t> header = GetStarpakHeader(creators);
+	out.writeBytes(header.data(), header.size());
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the file names of the rpaks that wrote data to a starpak
+// returns: whether the starpak has them
+//-----------------------------------------------------------------------------
+bool CPakFile::ReadStarpakCreators(const MappedFile& input, std::vector<std::string>& creators)
+{
+	creators.clear();
+
+	if (input.getSize() < STARPAK_DATABLOCK_ALIGNMENT)
+		return false;
+
+	const uint8_t* data = input.getData();
+
+	uint32_t magic = 0;
+	memcpy(&magic, data + sizeof(StreamableSetHeader), sizeof(magic));
+
+	if (magic != STARPAK_CREATORS_MAGIC)
+		return false;
+
+	for (size_t i = sizeof(StreamableSetHeader) + sizeof(magic); i < STARPAK_DATABLOCK_ALIGNMENT;)
+	{
+		const char* str = reinterpret_cast<const char*>(data + i);
+		const size_t length = strnlen(str, STARPAK_DATABLOCK_ALIGNMENT - i);
+
+		// names that run into the first data entry aren't from repak
+		if (i + length == STARPAK_DATABLOCK_ALIGNMENT)
+			break;
+
+		if (length == 0)
+			return !creators.empty();
+
+		creators.emplace_back(str, length);
+		i += length + 1;
+	}
+
+	creators.clear();
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the file that a starpak is written to, all starpaks go into the output directory
+//-----------------------------------------------------------------------------
+std::string CPakFile::GetStarpakOutputPath(const std::string& path) const
+{
+	return m_OutputPath + fs::path(path).filename().u8string();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: opens the output file of a starpak and starts the thread that writes its data
+//-----------------------------------------------------------------------------
+void CPakFile::StartStarpakWriter(PakStarpakData& starpak)
+{
+	starpak.m_StreamPath = GetStarpakOutputPath(starpak.m_Path);
+
+	// all starpaks are written to the output directory, so their file names have to differ
+	for (int i = 0; i < 2; ++i)
+	{
+		for (auto& it : GetStarpaks(i == 1))
+		{
+			if (it.get() != &starpak && it->m_StreamPath == starpak.m_StreamPath)
+				Error("starpaks '%s' and '%s' would both be written to '%s'\n", it->m_Path.c_str(), starpak.m_Path.c_str(), starpak.m_StreamPath.c_str());
+		}
+	}
+
+	const int flags = BIO_BUFFERED | (IsFlagSet(PF_DIRECT_IO) ? BIO_DIRECT : 0);
+
+	// the old sorts table is cut off and written again after the new data
+	if (starpak.m_nAppendOffset > 0)
+	{
+		std::vector<std::string> creators;
+		bool hasCreators = false;
+
+		{
+			MappedFile input;
+
+			if (!input.open(starpak.m_StreamPath))
+				Error("failed to open starpak file '%s'\n", starpak.m_StreamPath.c_str());
+
+			hasCreators = ReadStarpakCreators(input, creators);
+		}
+
+		if (!starpak.m_Stream.openAppend(starpak.m_StreamPath, starpak.m_nAppendOffset, flags))
+			Error("failed to open starpak file '%s' for appending\n", starpak.m_StreamPath.c_str());
+
+		// a starpak without the list came from somewhere else, so it isn't claimed for this rpak
+		if (!hasCreators)
+			Log("starpak file '%s' doesn't record the rpaks that wrote to it, it can only be compacted with -compactshared\n", starpak.m_StreamPath.c_str());
+		else if (std::find(creators.begin(), creators.end(), GetPakFileName()) == creators.end())
+		{
+			creators.push_back(GetPakFileName());
+
+			const std::vector<uint8_t> header = GetStarpakHeader(creators);
+			starpak.m_Stream.writeAt(0, header.data(), header.size());
+		}
+
+		Log("appending to starpak file '%s' after %lld existing data entries\n", starpak.m_StreamPath.c_str(), starpak.m_vDataBlocks.size());
+	}
+	else
+	{
+		if (!starpak.m_Stream.open(starpak.m_StreamPath, BinaryIOMode::Write, flags))
+			Error("failed to open starpak file '%s' for writing\n", starpak.m_StreamPath.c_str());
+
+		WriteStarpakHeader(starpak.m_Stream, { GetPakFileName() });
+	}
+
+	starpak.m_Writer = std::thread(&CPakFile::StarpakWriterFunc, this, std::ref(starpak));
+}
+
+//-----------------------------------------------------------------------------
+// purpose: hands a data entry to the writer thread of its starpak, which takes over
+//          the data it holds. waits if the writer is too far behind
+//-----------------------------------------------------------------------------
+void CPakFile::QueueStarpakDataEntry(PakStarpakData& starpak, StreamableDataEntry& block)
+{
+	const uint64_t pendingSize = block.m_nDataPtr ? block.m_nDataSize : 0;
+
+	{
+		std::unique_lock<std::mutex> lock(starpak.m_Mutex);
+		starpak.m_Cond.wait(lock, [&] { return starpak.m_nPendingSize == 0 || starpak.m_nPendingSize + pendingSize <= STARPAK_MAX_PENDING_SIZE; });
+
+		starpak.m_PendingBlocks.push_back(block);
+		starpak.m_nPendingSize += pendingSize;
+	}
+	starpak.m_Cond.notify_all();
+
+	block.m_nDataPtr = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes the queued data entries of a starpak until it is finished,
+//          then completes the file with the sorts table
+//-----------------------------------------------------------------------------
+void CPakFile::StarpakWriterFunc(PakStarpakData& starpak)
+{
+	for (;;)
+	{
+		StreamableDataEntry block;
+		{
+			std::unique_lock<std::mutex> lock(starpak.m_Mutex);
+			starpak.m_Cond.wait(lock, [&] { return !starpak.m_PendingBlocks.empty() || starpak.m_bFinished; });
+
+			if (starpak.m_PendingBlocks.empty())
+				break;
+
+			block = std::move(starpak.m_PendingBlocks.front());
+			starpak.m_PendingBlocks.pop_front();
+			starpak.m_bWriting = true;
+		}
+
+		const uint64_t pendingSize = block.m_nDataPtr ? block.m_nDataSize : 0;
+
+		WriteStarpakDataEntry(starpak, block);
+
+		{
+			std::lock_guard<std::mutex> lock(starpak.m_Mutex);
+			starpak.m_nPendingSize -= pendingSize;
+			starpak.m_bWriting = false;
+		}
+		starpak.m_Cond.notify_all();
+	}
+
+	// no entries are added anymore, so the blocks can be read without the lock
+	std::string filename = fs::path(starpak.m_Path).filename().u8string();
+	Debug("writing starpak %s with %lld data entries\n", filename.c_str(), starpak.m_vDataBlocks.size());
+
+	WriteStarpakSortsTable(starpak.m_Stream, starpak);
+
+	uint64_t entryCount = starpak.m_vDataBlocks.size();
+	starpak.m_Stream.write(entryCount);
+
+	Debug("written starpak file %s with size %lld\n", filename.c_str(), starpak.m_Stream.tell());
+
+	starpak.m_Stream.close();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes starpak data entry to the output starpak and frees its data
+//-----------------------------------------------------------------------------
+void CPakFile::WriteStarpakDataEntry(PakStarpakData& starpak, StreamableDataEntry& block)
+{
+	if (!block.m_vSourceRanges.empty())
+	{
+		WriteStarpakSourceRanges(starpak.m_Stream, block);
+	}
+	else
+	{
+		starpak.m_Stream.writeBytes(block.m_nDataPtr, block.m_nDataSize);
+
+		delete[] block.m_nDataPtr;
+		block.m_nDataPtr = nullptr;
+	}
+
+	Utils::WritePadding(starpak.m_Stream, block.GetPaddedSize() - block.m_nDataSize);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: copies the source file ranges of a starpak data entry straight from
+//          a mapped view of the source file
+//-----------------------------------------------------------------------------
+void CPakFile::WriteStarpakSourceRanges(BinaryIO& out, StreamableDataEntry& block)
+{
+	MappedFile source;
+
+	if (!source.open(block.m_SourcePath))
+		Error("failed to map streamed data source file '%s'\n", block.m_SourcePath.c_str());
+
+	for (auto& it : block.m_vSourceRanges)
+	{
+		if (it.m_nOffset + it.m_nSize > source.getSize())
+			Error("streamed data range %lld:%lld is out of bounds for source file '%s' with size %lld\n", it.m_nOffset, it.m_nSize, block.m_SourcePath.c_str(), source.getSize());
+
+		out.writeBytes(source.getData() + it.m_nOffset, it.m_nSize);
+	}
+
+	source.close();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: writes starpak sorts table to file stream
+//-----------------------------------------------------------------------------
+void CPakFile::WriteStarpakSortsTable(BinaryIO& out, PakStarpakData& starpak)
+{
+	// starpaks have a table of sorts at the end of the file, containing the offsets and data sizes for every data block
+	// as far as i'm aware, this isn't even used by the game, so i'm not entirely sure why it exists?
+	for (auto& it : starpak.m_vDataBlocks)
+	{
+		SRPkFileEntry fe{};
+		fe.m_nOffset = it.m_nOffset;
+		fe.m_nSize = it.GetPaddedSize();
+
+		out.write(fe);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: waits for all starpak writers to write their remaining data and sorts tables
+//          the starpaks are finished at the same time, each on its own writer thread
+//-----------------------------------------------------------------------------
+void CPakFile::FinishStarpaks()
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		for (auto& it : GetStarpaks(i == 1))
+		{
+			{
+				std::lock_guard<std::mutex> lock(it->m_Mutex);
+				it->m_bFinished = true;
+			}
+			it->m_Cond.notify_all();
+		}
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		for (auto& it : GetStarpaks(i == 1))
+		{
+			if (it->m_Writer.joinable())
+				it->m_Writer.join();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: frees the raw data blocks memory
+//-----------------------------------------------------------------------------
+void CPakFile::FreeRawDataBlocks()
+{
+	for (auto& it : m_vRawDataBlocks)
+	{
+		delete[] it.m_nDataPtr;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: frees the starpak data blocks memory
+//-----------------------------------------------------------------------------
+void CPakFile::FreeStarpakDataBlocks()
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		for (auto& starpak : GetStarpaks(i == 1))
+		{
+			for (auto& it : starpak->m_vDataBlocks)
+				delete[] it.m_nDataPtr;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: populates file relations vector with combined asset relation data
+//-----------------------------------------------------------------------------
+void CPakFile::GenerateFileRelations()
+{
+	for (auto& it : m_Assets)
+	{
+		it.relationCount = it._relations.size();
+		it.relStartIdx = m_vFileRelations.size();
+
+		for (int i = 0; i < it._relations.size(); ++i)
+			m_vFileRelations.push_back(it._relations[i]);
+	}
+	m_Header.relationCount = m_vFileRelations.size();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: 
+//-----------------------------------------------------------------------------
+void CPakFile::GenerateGuidData()
+{
+	for (auto& it : m_Assets)
+	{
+		it.usesCount = it._guids.size();
+		it.usesStartIdx = it.usesCount == 0 ? 0 : m_vGuidDescriptors.size();
+
+		for (int i = 0; i < it._guids.size(); ++i)
+			m_vGuidDescriptors.push_back({ it._guids[i] });
+	}
+	m_Header.guidDescriptorCount = m_vGuidDescriptors.size();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: adds asset to the guid lookup and looks it up in the access trace
+//          errors if another asset with the same guid has already been added
+//-----------------------------------------------------------------------------
+void CPakFile::IndexAsset(uint32_t assetIdx, const char* assetPath)
+{
+	uint64_t guid = m_Assets[assetIdx].guid;
+
+	m_Assets[assetIdx]._path = assetPath;
+	m_Assets[assetIdx]._accessRank = GetAccessRank(assetPath, guid);
+
+	auto res = m_AssetIndices.emplace(guid, assetIdx);
+
+	if (!res.second)
+		Error("asset '%s' has guid %llX, which is already used by asset #%i. make sure that the asset is not listed more than once in the map file\n", assetPath, guid, res.first->second);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: adds a relation on every local asset that is used by another asset
+//          runs once all assets are known, so the order of the assets in the
+//          map file does not matter. dependencies that aren't found in this pak
+//          are warned about, or fail the build if the asset can't work without them
+//-----------------------------------------------------------------------------
+void CPakFile::ResolveAssetRelations()
+{
+	for (uint32_t i = 0; i < m_Assets.size(); ++i)
+	{
+		for (auto& dep : m_Assets[i]._dependencies)
+		{
+			RPakAssetEntry* asset = GetAssetByGuid(dep.guid);
+
+			if (asset)
+			{
+				asset->AddRelation(i);
+				continue;
+			}
+
+			char guidName[32];
+			snprintf(guidName, sizeof(guidName), "%llX", dep.guid);
+
+			const char* depName = dep.name.empty() ? guidName : dep.name.c_str();
+
+			if (dep.required)
+				Error("Asset '%s' is required by asset '%s' but was not found within the local assets. Exiting...\n", depName, m_Assets[i]._path.c_str());
+
+			Warning("unable to find asset '%s' for asset '%s' within the local assets\n", depName, m_Assets[i]._path.c_str());
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: 
+// returns: 
+//-----------------------------------------------------------------------------
+_vseginfo_t CPakFile::CreateNewSegment(uint32_t size, uint32_t flags, uint32_t alignment, uint32_t vsegAlignment /*= -1*/)
+{
+	uint32_t vsegidx = (uint32_t)m_vVirtualSegments.size();
+
+	// find existing "segment" with the same values or create a new one, this is to overcome the engine's limit of having max 20 of these
+	// since otherwise we write into unintended parts of the stack, and that's bad
+	// segments that only differ in alignment are merged later on by PlanVirtualSegments if there are too many
+	RPakVirtualSegment seg = GetMatchingSegment(flags, vsegAlignment == -1 ? alignment : vsegAlignment, &vsegidx);
+
+	bool bShouldAddVSeg = seg.dataSize == 0;
+	seg.dataSize += size;
+
+	if (bShouldAddVSeg)
+		m_vVirtualSegments.emplace_back(seg);
+	else
+		m_vVirtualSegments[vsegidx] = seg;
+
+	RPakPageInfo vsegblock{ vsegidx, alignment, size };
+
+	m_vPages.emplace_back(vsegblock);
+	unsigned int pageidx = m_vPages.size() - 1;
+
+	return { pageidx, size };
+}
+
+//-----------------------------------------------------------------------------
+// purpose: 
+// returns: 
+//-----------------------------------------------------------------------------
+RPakAssetEntry* CPakFile::GetAssetByGuid(uint64_t guid, uint32_t* idx /*= nullptr*/)
+{
+	auto it = m_AssetIndices.find(guid);
+
+	if (it == m_AssetIndices.end())
+	{
+		Debug("failed to find asset with guid %llX\n", guid);
+		return nullptr;
+	}
+
+	if (idx)
+		*idx = it->second;
+
+	return &m_Assets[it->second];
+}
+
+//-----------------------------------------------------------------------------
+// purpose: creates page and segment with the specified parameters
+// returns: 
+//-----------------------------------------------------------------------------
+RPakVirtualSegment CPakFile::GetMatchingSegment(uint32_t flags, uint32_t alignment, uint32_t* segidx)
+{
+	uint32_t i = 0;
+	for (auto& it : m_vVirtualSegments)
+	{
+		if (it.flags == flags && it.alignment == alignment)
+		{
+			*segidx = i;
+			return it;
+		}
+		i++;
+	}
+
+	return { flags, alignment, 0 };
+}
+
+//-----------------------------------------------------------------------------
+// purpose: merges virtual segments that have the same flags while there are more
+//          segments than the engine supports. a merged segment gets the highest
+//          alignment among them, its pages keep their own alignment, so a merge
+//          only costs the gaps in front of the higher aligned pages when they end
+//          up behind lower aligned ones. the cheapest merges are done first
+//-----------------------------------------------------------------------------
+void CPakFile::PlanVirtualSegments()
+{
+	struct PlannedSegment
+	{
+		RPakVirtualSegment seg;
+
+		// number of pages in the segment by their alignment
+		std::map<uint32_t, uint64_t> pageAlignments;
+
+		// segments that are merged into this one
+		std::vector<uint32_t> sources;
+
+		// most padding that can end up in front of the pages if they are placed behind pages with the given alignment
+		uint64_t GetAddedPadding(uint32_t alignment) const
+		{
+			uint64_t padding = 0;
+
+			for (auto& it : pageAlignments)
+			{
+				if (it.first > alignment)
+					padding += (it.first - alignment) * it.second;
+			}
+
+			return padding;
+		}
+
+		uint32_t GetLowestPageAlignment() const
+		{
+			return pageAlignments.empty() ? seg.alignment : pageAlignments.begin()->first;
+		}
+	};
+
+	if (m_vVirtualSegments.size() <= RPAK_MAX_VIRTUAL_SEGMENTS)
+		return;
+
+	std::vector<PlannedSegment> planned(m_vVirtualSegments.size());
+
+	for (uint32_t i = 0; i < m_vVirtualSegments.size(); ++i)
+	{
+		planned[i].seg = m_vVirtualSegments[i];
+		planned[i].sources.push_back(i);
+	}
+
+	for (auto& it : m_vPages)
+		planned[it.segIdx].pageAlignments[it.pageAlignment]++;
+
+	while (planned.size() > RPAK_MAX_VIRTUAL_SEGMENTS)
+	{
+		size_t bestFirst = 0;
+		size_t bestSecond = 0;
+		uint64_t bestPadding = UINT64_MAX;
+
+		for (size_t i = 0; i < planned.size(); ++i)
+		{
+			for (size_t j = i + 1; j < planned.size(); ++j)
+			{
+				if (planned[i].seg.flags != planned[j].seg.flags)
+					continue;
+
+				const uint64_t padding = planned[i].GetAddedPadding(planned[j].GetLowestPageAlignment()) + planned[j].GetAddedPadding(planned[i].GetLowestPageAlignment());
+
+				if (padding < bestPadding)
+				{
+					bestFirst = i;
+					bestSecond = j;
+					bestPadding = padding;
+				}
+			}
+		}
+
+		if (bestPadding == UINT64_MAX)
+			break;
+
+		PlannedSegment& first = planned[bestFirst];
+		PlannedSegment& second = planned[bestSecond];
+
+		// the segment size is worked out again once the pages are laid out
+		first.seg.alignment = first.seg.alignment > second.seg.alignment ? first.seg.alignment : second.seg.alignment;
+		first.seg.dataSize += second.seg.dataSize;
+
+		for (auto& it : second.pageAlignments)
+			first.pageAlignments[it.first] += it.second;
+
+		first.sources.insert(first.sources.end(), second.sources.begin(), second.sources.end());
+
+		Debug("merged segments with flags %x into alignment %u, adding up to %lld bytes of padding\n", first.seg.flags, first.seg.alignment, bestPadding);
+
+		planned.erase(planned.begin() + bestSecond);
+	}
+
+	if (planned.size() > RPAK_MAX_VIRTUAL_SEGMENTS)
+	{
+		Warning("pak needs %lld virtual segments after merging all segments with the same flags:\n", planned.size());
+
+		for (auto& it : planned)
+			Warning("  flags %x, alignment %u, size %lld bytes\n", it.seg.flags, it.seg.alignment, it.seg.dataSize);
+
+		Error("the engine supports at most %i virtual segments. use fewer kinds of assets or split the assets over multiple paks\n", RPAK_MAX_VIRTUAL_SEGMENTS);
+	}
+
+	Log("merged %lld virtual segments into %lld\n", m_vVirtualSegments.size(), planned.size());
+
+	std::vector<uint32_t> segRemap(m_vVirtualSegments.size());
+	m_vVirtualSegments.clear();
+
+	for (uint32_t i = 0; i < planned.size(); ++i)
+	{
+		for (auto& it : planned[i].sources)
+			segRemap[it] = i;
+
+		m_vVirtualSegments.push_back(planned[i].seg);
+	}
+
+	for (auto& it : m_vPages)
+		it.segIdx = segRemap[it.segIdx];
+}
+
+//-----------------------------------------------------------------------------
+// purpose: assigns the final page and offset of every page handle, packing small
+//          pages of the same segment into shared pages, then moves the descriptors,
+//          the data blocks and the page references of the assets over to them
+//          page pointers inside the data are moved over when the blocks are written
+//          runs once all assets have been added
+//-----------------------------------------------------------------------------
+void CPakFile::LayoutPages()
+{
+	PlanVirtualSegments();
+
+	std::vector<uint32_t> order;
+
+	if (m_bOrderPages)
+		order = GetPageLoadOrder();
+	else
+	{
+		order.resize(m_vPages.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+	}
+
+	m_vPackedPages.clear();
+	m_vPageLocations.assign(m_vPages.size(), { 0, 0 });
+
+	// packed pages that pages of each segment are still added to
+	std::unordered_map<uint32_t, uint32_t> openPackedPages;
+
+	// page handles in each packed page, in the order of their offsets
+	std::vector<std::vector<uint32_t>> packedPageHandles;
+
+	for (auto& handle : order)
+	{
+		const RPakPageInfo& page = m_vPages[handle];
+		PakPageLocation location{ (uint32_t)m_vPackedPages.size(), 0 };
+
+		auto open = openPackedPages.find(page.segIdx);
+
+		if (open != openPackedPages.end())
+		{
+			RPakPageInfo& packed = m_vPackedPages[open->second];
+			const uint32_t offset = Utils::AlignSize(packed.dataSize, page.pageAlignment);
+
+			if (offset + page.dataSize <= m_nMaxPackedPageSize)
+			{
+				location = { open->second, offset };
+
+				packed.dataSize = offset + page.dataSize;
+				packed.pageAlignment = page.pageAlignment > packed.pageAlignment ? page.pageAlignment : packed.pageAlignment;
+			}
+		}
+
+		if (location.m_nPageIdx == m_vPackedPages.size())
+		{
+			m_vPackedPages.push_back(page);
+			packedPageHandles.emplace_back();
+
+			if (page.dataSize < m_nMaxPackedPageSize)
+				openPackedPages[page.segIdx] = location.m_nPageIdx;
+		}
+
+		m_vPageLocations[handle] = location;
+		packedPageHandles[location.m_nPageIdx].push_back(handle);
+	}
+
+	if (m_vPackedPages.size() > UINT16_MAX)
+		Error("pak has %lld pages after packing, while at most %i are supported\n", m_vPackedPages.size(), UINT16_MAX);
+
+	// the engine places the pages of a segment one after another, each aligned to
+	// its own alignment, so the segment has to hold the gaps in front of them too
+	const std::vector<uint64_t> segmentSizes = PlaceSegmentPages(m_vVirtualSegments.size(), m_vPackedPages.size(),
+		[&](size_t i) { return SegmentPage{ m_vPackedPages[i].segIdx, m_vPackedPages[i].pageAlignment, m_vPackedPages[i].dataSize }; });
+
+	for (size_t i = 0; i < m_vVirtualSegments.size(); ++i)
+		m_vVirtualSegments[i].dataSize = segmentSizes[i];
+
+	// descriptors and data blocks of each page handle
+	std::vector<std::vector<RPakDescriptor>> handleDescriptors(m_vPages.size());
+	std::vector<RPakRawDataBlock*> handleBlocks(m_vPages.size(), nullptr);
+
+	for (auto& it : m_vPakDescriptors)
+	{
+		if (it.index >= m_vPages.size())
+			Error("found descriptor for page %i, which does not exist\n", it.index);
+
+		handleDescriptors[it.index].push_back(it);
+	}
+
+	for (auto& it : m_vRawDataBlocks)
+	{
+		if (it.m_nPageIdx >= m_vPages.size() || handleBlocks[it.m_nPageIdx])
+			Error("found data for page %i, which does not exist or already has data\n", it.m_nPageIdx);
+
+		handleBlocks[it.m_nPageIdx] = &it;
+	}
+
+	// the descriptors and blocks are put in the order of the final pages and the
+	// offsets within them, so that the descriptors of each block directly follow
+	// the ones of the block before it when the blocks are written
+	std::vector<RPakDescriptor> descriptors;
+	std::vector<RPakRawDataBlock> blocks;
+
+	descriptors.reserve(m_vPakDescriptors.size());
+	blocks.reserve(m_vRawDataBlocks.size());
+
+	for (uint32_t i = 0; i < packedPageHandles.size(); ++i)
+	{
+		const std::vector<uint32_t>& pageHandles = packedPageHandles[i];
+
+		for (size_t j = 0; j < pageHandles.size(); ++j)
+		{
+			const uint32_t handle = pageHandles[j];
+			const PakPageLocation& location = m_vPageLocations[handle];
+
+			for (auto& it : handleDescriptors[handle])
+				descriptors.push_back({ location.m_nPageIdx, location.m_nOffset + it.offset });
+
+			// a page without data would leave the pages after it, and the descriptors into it, without theirs
+			if (!handleBlocks[handle])
+			{
+				if (!handleDescriptors[handle].empty() || m_vPages[handle].dataSize > 0)
+					Error("page %i has %lld descriptors and %i bytes, but no data was added for it\n", handle, handleDescriptors[handle].size(), m_vPages[handle].dataSize);
+
+				continue;
+			}
+
+			RPakRawDataBlock block = *handleBlocks[handle];
+			block.m_nPageIdx = location.m_nPageIdx;
+
+			// zeros up to the next page in the packed page
+			const uint64_t end = location.m_nOffset + block.GetPaddedSize();
+			const uint64_t next = j + 1 < pageHandles.size() ? m_vPageLocations[pageHandles[j + 1]].m_nOffset : m_vPackedPages[i].dataSize;
+
+			if (end > next)
+				Error("data for page %i is %lld bytes, which overlaps the data after it in page %i at offset %lld\n", handle, block.GetPaddedSize(), i, next);
+
+			block.m_nPadding += next - end;
+
+			blocks.push_back(block);
+		}
+	}
+
+	m_vPakDescriptors.swap(descriptors);
+	m_vRawDataBlocks.swap(blocks);
+
+	RemapAssetPages();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: orders the page handles for loading. the pages of each asset are kept
+//          together and come right after the pages of the assets it uses, so that
+//          it can be used as soon as they are in. assets that need the least page
+//          data, counting the assets they use, go first so that small assets don't
+//          wait on large ones that happened to be created before them
+//          needs the asset relations to be resolved
+// returns: page handles in the order they should be laid out in
+//-----------------------------------------------------------------------------
+std::vector<uint32_t> CPakFile::GetPageLoadOrder() const
+{
+	const uint32_t assetCount = m_Assets.size();
+
+	// _relations holds the assets that use each asset, turn it around
+	std::vector<std::vector<uint32_t>> uses(assetCount);
+
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		for (auto& it : m_Assets[i]._relations)
+			uses[it].push_back(i);
+	}
+
+	// page data that each asset needs before it can be used, including the
+	// data of the assets it uses. assets that are used more than once, or in
+	// a cycle, are counted once for each path, which is fine for ordering
+	std::vector<uint64_t> loadSizes(assetCount, 0);
+	std::vector<uint8_t> sizeState(assetCount, 0); // 0 = not visited, 1 = visiting, 2 = done
+
+	std::function<uint64_t(uint32_t)> getLoadSize = [&](uint32_t assetIdx) -> uint64_t
+	{
+		if (sizeState[assetIdx] != 0)
+			return loadSizes[assetIdx];
+
+		sizeState[assetIdx] = 1;
+
+		const RPakAssetEntry& asset = m_Assets[assetIdx];
+		uint64_t size = 0;
+
+		for (uint32_t i = asset._firstPage; i < asset._endPage; ++i)
+			size += m_vPages[i].dataSize;
+
+		for (auto& it : uses[assetIdx])
+			size += getLoadSize(it);
+
+		loadSizes[assetIdx] = size;
+		sizeState[assetIdx] = 2;
+
+		return size;
+	};
+
+	std::vector<uint32_t> assetOrder(assetCount);
+
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		assetOrder[i] = i;
+		getLoadSize(i);
+	}
+
+	// assets in the access trace go first in trace order, assets with equal sizes stay in map order
+	std::stable_sort(assetOrder.begin(), assetOrder.end(), [&](uint32_t a, uint32_t b)
+	{
+		if (m_Assets[a]._accessRank != m_Assets[b]._accessRank)
+			return m_Assets[a]._accessRank < m_Assets[b]._accessRank;
+
+		return loadSizes[a] < loadSizes[b];
+	});
+
+	std::vector<uint32_t> order;
+	order.reserve(m_vPages.size());
+
+	std::vector<bool> pagePlaced(m_vPages.size(), false);
+	std::vector<bool> assetPlaced(assetCount, false);
+
+	std::function<void(uint32_t)> placeAsset = [&](uint32_t assetIdx)
+	{
+		if (assetPlaced[assetIdx])
+			return;
+
+		assetPlaced[assetIdx] = true;
+
+		for (auto& it : uses[assetIdx])
+			placeAsset(it);
+
+		const RPakAssetEntry& asset = m_Assets[assetIdx];
+
+		// assets that were created together share their pages
+		for (uint32_t i = asset._firstPage; i < asset._endPage; ++i)
+		{
+			if (!pagePlaced[i])
+			{
+				pagePlaced[i] = true;
+				order.push_back(i);
+			}
+		}
+	};
+
+	for (auto& it : assetOrder)
+		placeAsset(it);
 
-//-----------------------------------------------------------------------------
-// purpose: writes raw data blocks to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WriteRawDataBlocks(BinaryIO& out)
-{
-	for (auto it = m_vRawDataBlocks.begin(); it != m_vRawDataBlocks.end(); ++it)
+	// pages that don't belong to any asset keep their place at the end
+	for (uint32_t i = 0; i < m_vPages.size(); ++i)
 	{
-		out.getWriter()->write((char*)it->m_nDataPtr, it->m_nDataSize);
+		if (!pagePlaced[i])
+			order.push_back(i);
 	}
-}
 
-//-----------------------------------------------------------------------------
-// purpose: writes starpak paths to file stream
-// returns: total length of written path vector
-//-----------------------------------------------------------------------------
-size_t CPakFile::WriteStarpakPaths(BinaryIO& out, bool optional)
-{
-	if (optional)
-		return Utils::WriteStringVector(out, m_vOptStarpakPaths);
-	else
-		return Utils::WriteStringVector(out, m_vStarpakPaths);
+	return order;
 }
 
 //-----------------------------------------------------------------------------
-// purpose: writes virtual segments to file stream
+// purpose: reads an access trace, which lists the assets that the game uses
+//          first after loading the pak. each line holds an asset guid starting
+//          with '0x', or an asset path. empty lines and lines starting with
+//          '#' or '//' are skipped. assets that are listed more than once keep
+//          their first position
 //-----------------------------------------------------------------------------
-void CPakFile::WriteVirtualSegments(BinaryIO& out)
+void CPakFile::LoadAccessTrace(const std::string& filePath)
 {
-	WRITE_VECTOR(out, m_vVirtualSegments);
-}
+	std::ifstream trace(filePath);
 
-//-----------------------------------------------------------------------------
-// purpose: writes pages to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WritePages(BinaryIO& out)
-{
-	WRITE_VECTOR(out, m_vPages);
-}
+	if (!trace.is_open())
+		Error("failed to open access trace '%s'\n", filePath.c_str());
 
-//-----------------------------------------------------------------------------
-// purpose: writes pak descriptors to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WritePakDescriptors(BinaryIO& out)
-{
-	WRITE_VECTOR(out, m_vPakDescriptors);
-}
+	uint32_t rank = 0;
+	std::string line;
 
-//-----------------------------------------------------------------------------
-// purpose: writes guid descriptors to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WriteGuidDescriptors(BinaryIO& out)
-{
-	WRITE_VECTOR(out, m_vGuidDescriptors);
-}
+	while (std::getline(trace, line))
+	{
+		const size_t start = line.find_first_not_of(" \t");
+		const size_t end = line.find_last_not_of(" \t\r");
 
-//-----------------------------------------------------------------------------
-// purpose: writes file relations to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WriteFileRelations(BinaryIO& out)
-{
-	WRITE_VECTOR(out, m_vFileRelations);
-}
+		if (start == std::string::npos)
+			continue;
 
-//-----------------------------------------------------------------------------
-// purpose: writes starpak data blocks to file stream
-//-----------------------------------------------------------------------------
-void CPakFile::WriteStarpakDataBlocks(BinaryIO& out)
-{
-	for (auto& it : m_vStarpakDataBlocks)
-	{
-		out.getWriter()->write((const char*)it.m_nDataPtr, it.m_nDataSize);
+		line = line.substr(start, end - start + 1);
+
+		if (line[0] == '#' || line.rfind("//", 0) == 0)
+			continue;
+
+		if (line.rfind("0x", 0) == 0 || line.rfind("0X", 0) == 0)
+		{
+			char* guidEnd = nullptr;
+			const uint64_t guid = strtoull(line.c_str() + 2, &guidEnd, 16);
+
+			if (*guidEnd != '\0')
+				Error("found invalid guid '%s' in access trace '%s'\n", line.c_str(), filePath.c_str());
+
+			m_AccessTraceGuids.emplace(guid, rank++);
+			continue;
+		}
+
+		// paths can be given as in the map file, or as the full asset name
+		m_AccessTracePaths.emplace(line, rank);
+		m_AccessTraceGuids.emplace(RTech::StringToGuid(line.c_str()), rank);
+
+		if (line.find(".rpak") == std::string::npos)
+			m_AccessTraceGuids.emplace(RTech::StringToGuid((line + ".rpak").c_str()), rank);
+
+		rank++;
 	}
+
+	Log("read %i entries from access trace '%s'\n", rank, filePath.c_str());
 }
 
 //-----------------------------------------------------------------------------
-// purpose: writes starpak sorts table to file stream
+// purpose: moves the files of the assets in the access trace to the front of the
+//          file list, in trace order, so that they are built first and their
+//          streamed data goes to the start of the starpaks. other files keep
+//          their order. guids of files are taken from their path, assets that
+//          build their guid differently are only matched by their path here
 //-----------------------------------------------------------------------------
-void CPakFile::WriteStarpakSortsTable(BinaryIO& out)
+void CPakFile::OrderFilesByAccessTrace(rapidjson::Value& files) const
 {
-	// starpaks have a table of sorts at the end of the file, containing the offsets and data sizes for every data block
-	// as far as i'm aware, this isn't even used by the game, so i'm not entirely sure why it exists?
-	for (auto& it : m_vStarpakDataBlocks)
+	const uint32_t numFiles = files.Size();
+
+	std::vector<uint32_t> ranks(numFiles);
+	std::vector<uint32_t> order(numFiles);
+
+	uint32_t tracedFiles = 0;
+
+	for (uint32_t i = 0; i < numFiles; ++i)
 	{
-		SRPkFileEntry fe{};
-		fe.m_nOffset = it.m_nOffset;
-		fe.m_nSize = it.m_nDataSize;
+		const std::string path = files[i]["path"].GetStdString();
 
-		out.write(fe);
+		const uint32_t rank = GetAccessRank(path, RTech::StringToGuid((path + ".rpak").c_str()));
+		const uint32_t nameRank = GetAccessRank(path, RTech::StringToGuid(path.c_str()));
+
+		ranks[i] = rank < nameRank ? rank : nameRank;
+		order[i] = i;
+
+		if (ranks[i] != UINT32_MAX)
+			tracedFiles++;
 	}
-}
 
-//-----------------------------------------------------------------------------
-// purpose: frees the raw data blocks memory
-//-----------------------------------------------------------------------------
-void CPakFile::FreeRawDataBlocks()
-{
-	for (auto& it : m_vRawDataBlocks)
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ranks[a] < ranks[b]; });
+
+	// put the files in place by swapping, tracking where each original file currently is
+	std::vector<uint32_t> positions(numFiles);
+	std::vector<uint32_t> filesAt(numFiles);
+
+	for (uint32_t i = 0; i < numFiles; ++i)
+		positions[i] = filesAt[i] = i;
+
+	for (uint32_t i = 0; i < numFiles; ++i)
 	{
-		delete[] it.m_nDataPtr;
+		const uint32_t from = positions[order[i]];
+
+		if (from == i)
+			continue;
+
+		files[i].Swap(files[from]);
+
+		positions[filesAt[i]] = from;
+		filesAt[from] = filesAt[i];
+
+		positions[order[i]] = i;
+		filesAt[i] = order[i];
 	}
+
+	Log("%i of %i files are in the access trace\n", tracedFiles, numFiles);
 }
 
 //-----------------------------------------------------------------------------
-// purpose: frees the starpak data blocks memory
+// purpose: looks up an asset in the access trace
+// returns: position of the asset in the trace, UINT32_MAX if it isn't in it
 //-----------------------------------------------------------------------------
-void CPakFile::FreeStarpakDataBlocks()
+uint32_t CPakFile::GetAccessRank(const std::string& assetPath, uint64_t guid) const
 {
-	for (auto& it : m_vStarpakDataBlocks)
-	{
-		delete[] it.m_nDataPtr;
-	}
+	uint32_t rank = UINT32_MAX;
+
+	auto path = m_AccessTracePaths.find(assetPath);
+	if (path != m_AccessTracePaths.end())
+		rank = path->second;
+
+	auto traced = m_AccessTraceGuids.find(guid);
+	if (traced != m_AccessTraceGuids.end() && traced->second < rank)
+		rank = traced->second;
+
+	return rank;
 }
 
 //-----------------------------------------------------------------------------
-// purpose: populates file relations vector with combined asset relation data
+// purpose: moves the page references of the assets to the final pages
+//          runs once all pages have been laid out
 //-----------------------------------------------------------------------------
-void CPakFile::GenerateFileRelations()
+void CPakFile::RemapAssetPages()
 {
 	for (auto& it : m_Assets)
 	{
-		it.relationCount = it._relations.size();
-		it.relStartIdx = m_vFileRelations.size();
+		// the page end is exclusive, and covers every final page that holds
+		// one of the pages that were created for the asset
+		uint32_t pageEnd = 0;
 
-		for (int i = 0; i < it._relations.size(); ++i)
-			m_vFileRelations.push_back(it._relations[i]);
+		auto remap = [&](int& pageIdx, int& pageOffset)
+		{
+			if (pageIdx == -1)
+				return;
+
+			const PakPageLocation& location = m_vPageLocations[pageIdx];
+			pageIdx = location.m_nPageIdx;
+			pageOffset += location.m_nOffset;
+
+			pageEnd = location.m_nPageIdx + 1 > pageEnd ? location.m_nPageIdx + 1 : pageEnd;
+		};
+
+		for (uint32_t i = it._firstPage; i < it._endPage; ++i)
+		{
+			const uint32_t end = m_vPageLocations[i].m_nPageIdx + 1;
+			pageEnd = end > pageEnd ? end : pageEnd;
+		}
+
+		remap(it.headIdx, it.headOffset);
+		remap(it.cpuIdx, it.cpuOffset);
+
+		for (auto& guid : it._guids)
+		{
+			const PakPageLocation& location = m_vPageLocations[guid.index];
+			guid.index = location.m_nPageIdx;
+			guid.offset += location.m_nOffset;
+
+			pageEnd = location.m_nPageIdx + 1 > pageEnd ? location.m_nPageIdx + 1 : pageEnd;
+		}
+
+		it.pageEnd = pageEnd;
 	}
-	m_Header.relationCount = m_vFileRelations.size();
 }
 
 //-----------------------------------------------------------------------------
-// purpose: 
+// purpose: picks the number of resident mips of each texture so that all of them
+//          together fit in the resident texture budget of the pak
+//          textures start out with their own limits, then the largest resident mip
+//          across all textures is moved to the starpak until the budget is met
 //-----------------------------------------------------------------------------
-void CPakFile::GenerateGuidData()
+void CPakFile::PlanTextureStreaming(rapidjson::Value& files)
 {
-	for (auto& it : m_Assets)
+	struct PlannedTexture
 	{
-		it.usesCount = it._guids.size();
-		it.usesStartIdx = it.usesCount == 0 ? 0 : m_vGuidDescriptors.size();
+		const char* assetPath;
+		TextureStreamingLimits limits;
+		uint32_t residentMips;
 
-		for (int i = 0; i < it._guids.size(); ++i)
-			m_vGuidDescriptors.push_back({ it._guids[i] });
-	}
-	m_Header.guidDescriptorCount = m_vGuidDescriptors.size();
-}
+		// size of the largest mip that is still resident
+		uint32_t GetTopResidentMipSize() const { return limits.mipSizes[limits.mipSizes.size() - residentMips]; }
+	};
 
-//-----------------------------------------------------------------------------
-// purpose: 
-// returns: 
-//-----------------------------------------------------------------------------
-_vseginfo_t CPakFile::CreateNewSegment(uint32_t size, uint32_t flags, uint32_t alignment, uint32_t vsegAlignment /*= -1*/)
-{
-	uint32_t vsegidx = (uint32_t)m_vVirtualSegments.size();
+	std::vector<PlannedTexture> textures;
+	uint64_t residentSize = 0;
 
-	// find existing "segment" with the same values or create a new one, this is to overcome the engine's limit of having max 20 of these
-	// since otherwise we write into unintended parts of the stack, and that's bad
-	RPakVirtualSegment seg = GetMatchingSegment(flags, vsegAlignment == -1 ? alignment : vsegAlignment, &vsegidx);
+	m_Settings.m_pImageCache = std::make_shared<SourceImageCache>(SOURCE_IMAGE_CACHE_SIZE);
 
-	bool bShouldAddVSeg = seg.dataSize == 0;
-	seg.dataSize += size;
+	for (auto& file : files.GetArray())
+	{
+		if (file["$type"].GetStdString() != "txtr")
+			continue;
 
-	if (bShouldAddVSeg)
-		m_vVirtualSegments.emplace_back(seg);
-	else
-		m_vVirtualSegments[vsegidx] = seg;
+		PlannedTexture texture{ file["path"].GetString() };
 
-	RPakPageInfo vsegblock{ vsegidx, alignment, size };
+		// textures that can't be read are left to fail when they are built
+		if (!Assets::GetTextureStreamingLimits(this, texture.assetPath, file, texture.limits))
+			continue;
 
-	m_vPages.emplace_back(vsegblock);
-	unsigned int pageidx = m_vPages.size() - 1;
+		texture.residentMips = texture.limits.residentMips;
 
-	return { pageidx, size };
-}
+		for (uint32_t i = 0; i < texture.residentMips; ++i)
+			residentSize += texture.limits.mipSizes[texture.limits.mipSizes.size() - 1 - i];
 
-//-----------------------------------------------------------------------------
-// purpose: 
-// returns: 
-//-----------------------------------------------------------------------------
-RPakAssetEntry* CPakFile::GetAssetByGuid(uint64_t guid, uint32_t* idx /*= nullptr*/)
-{
-	uint32_t i = 0;
-	for (auto& it : m_Assets)
+		textures.push_back(std::move(texture));
+	}
+
+	const uint64_t plannedSize = residentSize;
+
+	// largest resident mip first, ties go to the texture that comes first in the map
+	auto compare = [&](uint32_t a, uint32_t b)
 	{
-		if (it.guid == guid)
-		{
-			if (idx)
-				*idx = i;
-			return &it;
-		}
-		i++;
+		uint32_t sizeA = textures[a].GetTopResidentMipSize();
+		uint32_t sizeB = textures[b].GetTopResidentMipSize();
+
+		return sizeA != sizeB ? sizeA < sizeB : a > b;
+	};
+
+	std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(compare)> queue(compare);
+
+	for (uint32_t i = 0; i < textures.size(); ++i)
+	{
+		if (textures[i].residentMips > textures[i].limits.minResidentMips)
+			queue.push(i);
+	}
+
+	while (residentSize > m_ResidentTextureBudget && !queue.empty())
+	{
+		uint32_t idx = queue.top();
+		queue.pop();
+
+		PlannedTexture& texture = textures[idx];
+
+		residentSize -= texture.GetTopResidentMipSize();
+		texture.residentMips--;
+
+		if (texture.residentMips > texture.limits.minResidentMips)
+			queue.push(idx);
 	}
-	Debug("failed to find asset with guid %llX\n", guid);
-	return nullptr;
+
+	std::shared_ptr<std::unordered_map<std::string, uint32_t>> plan = std::make_shared<std::unordered_map<std::string, uint32_t>>();
+
+	for (auto& it : textures)
+		plan->emplace(it.assetPath, it.residentMips);
+
+	m_Settings.m_pResidentMipPlan = plan;
+
+	Log("planned resident texture data for %lld textures: %lld bytes (%lld without budget), budget %lld bytes\n", textures.size(), residentSize, plannedSize, m_ResidentTextureBudget);
+
+	if (residentSize > m_ResidentTextureBudget)
+		Warning("resident texture data does not fit in the budget of %lld bytes, even with every texture streamed as far as it can be\n", m_ResidentTextureBudget);
 }
 
 //-----------------------------------------------------------------------------
-// purpose: creates page and segment with the specified parameters
-// returns: 
+// purpose: gets the resident mip count that was planned for a texture
+// returns: defaultMips if there is no plan for the texture
 //-----------------------------------------------------------------------------
-RPakVirtualSegment CPakFile::GetMatchingSegment(uint32_t flags, uint32_t alignment, uint32_t* segidx)
+uint32_t CPakFile::GetPlannedResidentMips(const char* assetPath, uint32_t defaultMips) const
 {
-	uint32_t i = 0;
-	for (auto& it : m_vVirtualSegments)
-	{
-		if (it.flags == flags && it.alignment == alignment)
-		{
-			*segidx = i;
-			return it;
-		}
-		i++;
-	}
+	if (!m_Settings.m_pResidentMipPlan)
+		return defaultMips;
 
-	return { flags, alignment, 0 };
+	auto it = m_Settings.m_pResidentMipPlan->find(assetPath);
+	return it != m_Settings.m_pResidentMipPlan->end() ? it->second : defaultMips;
 }
 
 //-----------------------------------------------------------------------------
@@ -427,20 +2162,20 @@ void CPakFile::BuildFromMap(const string& mapPath)
 	{
 		Warning("No assetsDir field provided. Assuming that everything is relative to the working directory.\n");
 		if (inputPath.has_parent_path())
-			m_AssetPath = inputPath.parent_path().u8string();
+			m_Settings.m_AssetPath = inputPath.parent_path().u8string();
 		else
-			m_AssetPath = ".\\";
+			m_Settings.m_AssetPath = ".\\";
 	}
 	else
 	{
 		fs::path assetsDirPath(doc["assetsDir"].GetStdString());
 		if (assetsDirPath.is_relative() && inputPath.has_parent_path())
-			m_AssetPath = std::filesystem::canonical(inputPath.parent_path() / assetsDirPath).u8string();
+			m_Settings.m_AssetPath = std::filesystem::canonical(inputPath.parent_path() / assetsDirPath).u8string();
 		else
-			m_AssetPath = assetsDirPath.u8string();
+			m_Settings.m_AssetPath = assetsDirPath.u8string();
 
 		// ensure that the path has a slash at the end
-		Utils::AppendSlash(m_AssetPath);
+		Utils::AppendSlash(m_Settings.m_AssetPath);
 	}
 
 
@@ -471,13 +2206,18 @@ void CPakFile::BuildFromMap(const string& mapPath)
 	Log("build settings:\n");
 	Log("version: %i\n", GetVersion());
 	Log("fileName: %s.rpak\n", pakName.c_str());
-	Log("assetsDir: %s\n", m_AssetPath.c_str());
+	Log("assetsDir: %s\n", m_Settings.m_AssetPath.c_str());
 	Log("outputDir: %s\n", outputPath.c_str());
+	Log("threads: %i\n", m_Settings.m_NumThreads);
 	Log("\n");
 
 
 	// create output directory if it does not exist yet.
 	fs::create_directories(outputPath);
+	m_OutputPath = outputPath;
+
+	// streamed data gets written to the starpak as soon as it is added
+	m_bStreamStarpakData = true;
 
 	// set build path
 	SetPath(outputPath + pakName + ".rpak");
@@ -487,21 +2227,135 @@ void CPakFile::BuildFromMap(const string& mapPath)
 	if (doc.HasMember("keepDevOnly") && doc["keepDevOnly"].IsBool() && doc["keepDevOnly"].GetBool())
 		AddFlags(PF_KEEP_DEV);
 
+	// if streamPages exists, is boolean, and is set to true
+	if (doc.HasMember("streamPages") && doc["streamPages"].IsBool() && doc["streamPages"].GetBool())
+		AddFlags(PF_STREAM_PAGES);
+
+	// if packPages exists, is boolean, and is set to true, small pages of the same segment share a page
+	if (doc.HasMember("packPages") && doc["packPages"].IsBool() && doc["packPages"].GetBool())
+		m_nMaxPackedPageSize = RPAK_PACKED_PAGE_SIZE;
+
+	// if orderPages exists, is boolean, and is set to true, pages are laid out in load order
+	if (doc.HasMember("orderPages") && doc["orderPages"].IsBool() && doc["orderPages"].GetBool())
+		m_bOrderPages = true;
+
+	// if directIO exists, is boolean, and is set to true
+	if (doc.HasMember("directIO") && doc["directIO"].IsBool() && doc["directIO"].GetBool())
+		AddFlags(PF_DIRECT_IO);
+
 	if (doc.HasMember("starpakPath") && doc["starpakPath"].IsString())
 		SetPrimaryStarpakPath(doc["starpakPath"].GetStdString());
 
+	// the largest mips of streamed textures go into the optional starpak if there is one
+	if (doc.HasMember("optStarpakPath") && doc["optStarpakPath"].IsString())
+	{
+		SetPrimaryOptStarpakPath(doc["optStarpakPath"].GetStdString());
+		SetOptStreamedMipCount(1);
+	}
 
-	// build asset data;
-	// loop through all assets defined in the map file
-	for (auto& file : doc["files"].GetArray())
+	if (doc.HasMember("optStreamedMips"))
 	{
-		AddAsset(file);
+		if (!doc["optStreamedMips"].IsUint())
+			Error("found field 'optStreamedMips' with invalid type. expected 'uint'\n");
+
+		SetOptStreamedMipCount(doc["optStreamedMips"].GetUint());
+	}
+
+	// if maxResidentTextureBytes exists, mips of textures are streamed until all of them fit in it
+	if (doc.HasMember("maxResidentTextureBytes"))
+	{
+		if (!doc["maxResidentTextureBytes"].IsUint64())
+			Error("found field 'maxResidentTextureBytes' with invalid type. expected 'uint'\n");
+
+		m_ResidentTextureBudget = doc["maxResidentTextureBytes"].GetUint64();
+		PlanTextureStreaming(doc["files"]);
+	}
+
+
+	// if dedupStreamedData exists, is boolean, and is set to true, streamed data with the same contents is only written once
+	if (doc.HasMember("dedupStreamedData") && doc["dedupStreamedData"].IsBool() && doc["dedupStreamedData"].GetBool())
+		m_Settings.m_bHashStreamedData = m_bDedupStreamedData = true;
+
+	// if appendStarpaks exists, is boolean, and is set to true, starpaks from a previous build in the
+	// output directory are kept and only data they don't have yet is added to them
+	if (doc.HasMember("appendStarpaks") && doc["appendStarpaks"].IsBool() && doc["appendStarpaks"].GetBool())
+	{
+		if (m_bDedupStreamedData)
+			m_bAppendStarpaks = true;
+		else
+			Warning("[JSON] 'appendStarpaks' is ignored, as 'dedupStreamedData' is not enabled.\n");
+	}
+
+	// existing starpaks whose data gets referenced instead of copied, e.g. the base 'pc_all.opt.starpak'
+	if (doc.HasMember("sharedStarpaks"))
+	{
+		if (!doc["sharedStarpaks"].IsArray())
+			Error("found field 'sharedStarpaks' with invalid type. expected 'array'\n");
+
+		if (!m_bDedupStreamedData)
+			Warning("[JSON] 'sharedStarpaks' is ignored, as 'dedupStreamedData' is not enabled.\n");
+
+		for (auto& it : doc["sharedStarpaks"].GetArray())
+		{
+			if (!m_bDedupStreamedData)
+				break;
+
+			if (!it.IsObject() || !it.HasMember("path") || !it["path"].IsString() || !it.HasMember("file") || !it["file"].IsString())
+				Error("found entry in 'sharedStarpaks' without string fields 'path' and 'file'\n");
+
+			std::string starpakPath = it["path"].GetStdString();
+
+			fs::path filePath(it["file"].GetStdString());
+			if (filePath.is_relative() && inputPath.has_parent_path())
+				filePath = inputPath.parent_path() / filePath;
+
+			bool optional = starpakPath.find(".opt.starpak") != std::string::npos;
+			if (it.HasMember("optional") && it["optional"].IsBool())
+				optional = it["optional"].GetBool();
+
+			LoadStarpakIndex(filePath.u8string(), starpakPath, optional);
+		}
+	}
+
+	// assets that the game uses first after the pak is loaded, these get built and laid out first
+	if (doc.HasMember("accessTrace"))
+	{
+		if (!doc["accessTrace"].IsString())
+			Error("found field 'accessTrace' with invalid type. expected 'string'\n");
+
+		fs::path tracePath(doc["accessTrace"].GetStdString());
+		if (tracePath.is_relative() && inputPath.has_parent_path())
+			tracePath = inputPath.parent_path() / tracePath;
+
+		LoadAccessTrace(tracePath.u8string());
+		OrderFilesByAccessTrace(doc["files"]);
 	}
 
 
+	// build asset data;
+	// loop through all assets defined in the map file
+	AddAssets(doc["files"]);
+
+
+	// now that all assets are known, work out which assets use each other
+	ResolveAssetRelations();
+
+	// lay out the segments and pages, then point the descriptors and assets at the final pages
+	LayoutPages();
+
+	Log("packed %lld pages into %lld\n", m_vPages.size(), m_vPackedPages.size());
+
+
+	if (m_ResidentTextureSize > 0 || m_StreamedTextureSize > 0 || m_OptStreamedTextureSize > 0)
+		Log("texture data resident:streamed:optional : %lld:%lld:%lld bytes\n", m_ResidentTextureSize, m_StreamedTextureSize, m_OptStreamedTextureSize);
+
+	if (m_nDedupCount > 0)
+		Log("streamed data entries referenced instead of written: %lld (%lld bytes)\n", m_nDedupCount, m_nDedupSize);
+
+
 	// create file stream from path created above
 	BinaryIO out;
-	out.open(GetPath(), BinaryIOMode::Write);
+	out.open(GetPath(), BinaryIOMode::Write, BIO_BUFFERED | (IsFlagSet(PF_DIRECT_IO) ? BIO_DIRECT : 0));
 
 
 	// write a placeholder header so we can come back and complete it
@@ -531,8 +2385,9 @@ void CPakFile::BuildFromMap(const string& mapPath)
 
 
 	// now the actual paged data
-	// this should probably be writing by page instead of just hoping that
-	// the data blocks are in the right order
+	// the data blocks have been put in the order of the final pages by LayoutPages
+	// with PF_STREAM_PAGES most of this has already been written to disk
+	// while the assets were built, and only gets read back in here
 	WriteRawDataBlocks(out);
 
 
@@ -544,7 +2399,7 @@ void CPakFile::BuildFromMap(const string& mapPath)
 	SetDecompressedSize(out.tell());
 
 
-	out.seek(0); // go back to the beginning to finally write the rpakHeader now
+	out.seek(0); // go back to the beginning to finally write the rpakHeader now, this is patched in place by the buffered writer
 	WriteHeader(out); out.close();
 
 	Debug("written rpak file with size %lld\n", GetCompressedSize());
@@ -554,43 +2409,7 @@ void CPakFile::BuildFromMap(const string& mapPath)
 	FreeRawDataBlocks();
 
 
-	// !TODO: we really should add support for multiple starpak files and share existing
-	// assets across rpaks. e.g. if the base 'pc_all.opt.starpak' already contains the
-	// highest mip level for 'ola_sewer_grate', don't copy it into 'sdk_all.opt.starpak'.
-	// the sort table at the end of the file (see WriteStarpakSortsTable) contains offsets
-	// to the asset with their respective sizes. this could be used in combination of a
-	// static database (who's name is to be selected from a hint provided by the map file)
-	// to map assets among various rpaks avoiding extraneous copies of the same streamed data.
-	if (GetNumStarpakPaths() == 1)
-	{
-		fs::path path(GetStarpakPath(0));
-		std::string filename = path.filename().u8string();
-
-		Debug("writing starpak %s with %lld data entries\n", filename.c_str(), GetStreamingAssetCount());
-		BinaryIO srpkOut;
-
-		srpkOut.open(outputPath + filename, BinaryIOMode::Write);
+	FinishStarpaks();
 
-		StreamableSetHeader srpkHeader{ STARPAK_MAGIC , STARPAK_VERSION };
-		srpkOut.write(srpkHeader);
-
-		int padSize = (STARPAK_DATABLOCK_ALIGNMENT - sizeof(StreamableSetHeader));
-
-		char* initialPad = new char[padSize];
-		memset(initialPad, STARPAK_DATABLOCK_ALIGNMENT_PADDING, padSize);
-
-		srpkOut.getWriter()->write(initialPad, padSize);
-		delete[] initialPad;
-
-		WriteStarpakDataBlocks(srpkOut);
-		WriteStarpakSortsTable(srpkOut);
-
-		uint64_t entryCount = GetStreamingAssetCount();
-		srpkOut.write(entryCount);
-
-		Debug("written starpak file with size %lld\n", srpkOut.tell());
-
-		FreeStarpakDataBlocks();
-		srpkOut.close();
-	}
+	FreeStarpakDataBlocks();
 }
\ No newline at end of file
@@ -1,12 +1,91 @@
 #pragma once
 #include "public/rpak.h"
 
+class SourceImageCache;
+
 struct _vseginfo_t
 {
 	unsigned int index = 0xFFFFFFFF;
 	unsigned int size = 0;
 };
 
+// streamed data of one of the starpaks that the rpak references
+struct PakStarpakData
+{
+	// path that the rpak references the starpak by
+	std::string m_Path;
+
+	// set for existing starpaks that are shared with other rpaks, these are only referenced and never written
+	bool m_bExternal = false;
+
+	// end of the existing data when appending to a starpak from a previous build, new entries are written after it
+	// 0 if the starpak is written from scratch
+	uint64_t m_nAppendOffset = 0;
+
+	// next available data offset, the header takes up the first block
+	uint64_t m_nNextOffset = STARPAK_DATABLOCK_ALIGNMENT;
+	std::vector<StreamableDataEntry> m_vDataBlocks;
+
+	// file that the data blocks are written to by the writer thread of the starpak
+	// only the offsets and sizes are kept in m_vDataBlocks for the sorts table
+	BinaryIO m_Stream;
+	std::string m_StreamPath;
+
+	// entries that have been added but not written yet, and the size of the data they hold in memory
+	std::deque<StreamableDataEntry> m_PendingBlocks;
+	uint64_t m_nPendingSize = 0;
+	bool m_bWriting = false; // set while the writer is writing an entry that it took from m_PendingBlocks
+	bool m_bFinished = false; // set once no more entries will be added
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Cond;
+	std::thread m_Writer;
+};
+
+// where a page that was created for an asset ended up once the pages are laid out
+struct PakPageLocation
+{
+	uint32_t m_nPageIdx;
+	uint32_t m_nOffset;
+};
+
+// where a piece of streamed data has been written to, or can be found in an existing starpak
+struct StreamableDataLocation
+{
+	std::string m_StarpakPath;
+	uint64_t m_nOffset;
+	uint64_t m_nPaddedSize;
+	bool m_bExternal; // in a starpak that is shared with other rpaks and not written by this build
+
+	// file that the data can be read back from, for entries of starpaks that existed before the build
+	std::string m_FilePath;
+};
+
+// settings that the assets are built with. staging paks that build assets on other
+// threads get a copy of them, so everything that asset builders read belongs in here
+struct PakBuildSettings
+{
+	int m_Flags = 0;
+
+	// number of worker threads used for building assets, staging paks get a share of them
+	int m_NumThreads = 1;
+
+	std::string m_AssetPath;
+	std::string m_PrimaryStarpakPath;
+	std::string m_PrimaryOptStarpakPath;
+
+	uint32_t m_OptStreamedMipCount = 0;
+
+	// whether new streamed data is hashed. staging paks only hash their data, it is looked up when they are merged
+	bool m_bHashStreamedData = false;
+
+	// resident mip counts picked by PlanTextureStreaming, by asset path
+	std::shared_ptr<const std::unordered_map<std::string, uint32_t>> m_pResidentMipPlan;
+
+	// images that PlanTextureStreaming decoded, taken by the builds of their textures
+	std::shared_ptr<SourceImageCache> m_pImageCache;
+};
+
 class CPakFile
 {
 public:
@@ -16,21 +95,33 @@ public:
 	// assets
 	//----------------------------------------------------------------------------
 	void AddAsset(rapidjson::Value& file);
+	void AddAssets(rapidjson::Value& files);
 	void AddPointer(unsigned int pageIdx, unsigned int pageOffset);
 	void AddGuidDescriptor(std::vector<RPakGuidDescriptor>* guids, unsigned int idx, unsigned int offset);
 	void AddRawDataBlock(RPakRawDataBlock block);
 
-	void AddStarpakReference(const std::string& path);
-	void AddOptStarpakReference(const std::string& path);
-	StreamableDataEntry AddStarpakDataEntry(StreamableDataEntry block);
+	uint32_t AddStarpakReference(const std::string& path);
+	uint32_t AddOptStarpakReference(const std::string& path);
+	StreamableDataEntry AddStarpakDataEntry(StreamableDataEntry block, const std::string& starpakPath, bool optional = false);
 
 	//----------------------------------------------------------------------------
 	// inlines
 	//----------------------------------------------------------------------------
-	inline bool IsFlagSet(int flag) const { return m_Flags & flag; };
+	inline bool IsFlagSet(int flag) const { return m_Settings.m_Flags & flag; };
 
 	inline size_t GetAssetCount() const { return m_Assets.size(); };
-	inline size_t GetStreamingAssetCount() const { return m_vStarpakDataBlocks.size(); }
+	inline size_t GetStreamingAssetCount() const
+	{
+		size_t count = 0;
+
+		for (auto& it : m_vStarpaks)
+			count += it->m_vDataBlocks.size();
+
+		for (auto& it : m_vOptStarpaks)
+			count += it->m_vDataBlocks.size();
+
+		return count;
+	}
 
 	inline uint32_t GetVersion() const { return m_Header.fileVersion; }
 	inline void SetVersion(uint32_t version) { m_Header.fileVersion = version; }
@@ -44,8 +135,8 @@ public:
 	inline std::string GetPath() const { return m_Path; }
 	inline void SetPath(const std::string& path) { m_Path = path; }
 
-	inline std::string GetAssetPath() const { return m_AssetPath; }
-	inline void SetAssetPath(const std::string& assetPath) { m_AssetPath = assetPath; }
+	inline std::string GetAssetPath() const { return m_Settings.m_AssetPath; }
+	inline void SetAssetPath(const std::string& assetPath) { m_Settings.m_AssetPath = assetPath; }
 
 	inline std::string GetStarpakPath(int i) const
 	{
@@ -55,9 +146,25 @@ public:
 			return ""; // if invalid starpak is requested, return empty string
 	};
 
-	inline std::string GetPrimaryStarpakPath() const { return m_PrimaryStarpakPath; };
+	inline std::string GetPrimaryStarpakPath() const { return m_Settings.m_PrimaryStarpakPath; };
 	inline size_t GetNumStarpakPaths() const { return m_vStarpakPaths.size(); }
-	inline void SetPrimaryStarpakPath(const std::string& path) { m_PrimaryStarpakPath = path; }
+	inline void SetPrimaryStarpakPath(const std::string& path) { m_Settings.m_PrimaryStarpakPath = path; }
+
+	inline std::string GetOptStarpakPath(int i) const
+	{
+		if (i >= 0 && i < m_vOptStarpakPaths.size())
+			return m_vOptStarpakPaths[i];
+		else
+			return "";
+	};
+
+	inline std::string GetPrimaryOptStarpakPath() const { return m_Settings.m_PrimaryOptStarpakPath; };
+	inline size_t GetNumOptStarpakPaths() const { return m_vOptStarpakPaths.size(); }
+	inline void SetPrimaryOptStarpakPath(const std::string& path) { m_Settings.m_PrimaryOptStarpakPath = path; }
+
+	// number of the largest streamed mips of each texture that go into the optional starpak
+	inline uint32_t GetOptStreamedMipCount() const { return m_Settings.m_OptStreamedMipCount; }
+	inline void SetOptStreamedMipCount(uint32_t count) { m_Settings.m_OptStreamedMipCount = count; }
 
 	inline size_t GetCompressedSize() const { return m_Header.compressedSize; }
 	inline size_t GetDecompressedSize() const { return m_Header.decompressedSize; }
@@ -68,8 +175,18 @@ public:
 	inline FILETIME GetFileTime() const { return m_Header.fileTime; }
 	inline void SetFileTime(FILETIME fileTime) { m_Header.fileTime = fileTime; }
 
-	inline void AddFlags(int flags) { m_Flags |= flags; }
-	inline void RemoveFlags(int flags) { m_Flags &= ~flags; }
+	inline void AddFlags(int flags) { m_Settings.m_Flags |= flags; }
+	inline void RemoveFlags(int flags) { m_Settings.m_Flags &= ~flags; }
+
+	inline int GetNumThreads() const { return m_Settings.m_NumThreads; }
+	inline void SetNumThreads(int numThreads) { m_Settings.m_NumThreads = numThreads; }
+
+	inline void AddTextureMemoryUsage(uint64_t residentSize, uint64_t streamedSize, uint64_t optStreamedSize)
+	{
+		m_ResidentTextureSize += residentSize;
+		m_StreamedTextureSize += streamedSize;
+		m_OptStreamedTextureSize += optStreamedSize;
+	}
 
 	//----------------------------------------------------------------------------
 	// rpak
@@ -77,6 +194,17 @@ public:
 	void WriteHeader(BinaryIO& io);
 	void WriteAssets(BinaryIO& io);
 	void WriteRawDataBlocks(BinaryIO& out);
+	void FlushRawDataBlocks();
+
+	// purpose: assigns the final page and offset of every page handle once all assets are added
+	void LayoutPages();
+
+	// purpose: merges virtual segments with the same flags to stay under the engine's segment limit
+	void PlanVirtualSegments();
+	// purpose: orders the page handles so that assets and the assets they use load as early as possible
+	std::vector<uint32_t> GetPageLoadOrder() const;
+	// purpose: moves the page references of the assets to the final pages
+	void RemapAssetPages();
 
 	size_t WriteStarpakPaths(BinaryIO& out, bool optional = false);
 
@@ -89,8 +217,27 @@ public:
 	//----------------------------------------------------------------------------
 	// starpak
 	//----------------------------------------------------------------------------
-	void WriteStarpakDataBlocks(BinaryIO& io);
-	void WriteStarpakSortsTable(BinaryIO& io);
+	void WriteStarpakHeader(BinaryIO& io, const std::vector<std::string>& creators);
+	void WriteStarpakDataEntry(PakStarpakData& starpak, StreamableDataEntry& block);
+	void WriteStarpakSourceRanges(BinaryIO& io, StreamableDataEntry& block);
+	void WriteStarpakSortsTable(BinaryIO& io, PakStarpakData& starpak);
+
+	// purpose: waits for all starpak writers to write their remaining data and sorts tables
+	void FinishStarpaks();
+
+	static std::vector<SRPkFileEntry> ReadStarpakSortsTable(const MappedFile& input, const std::string& filePath);
+
+	// purpose: gets the file names of the rpaks that wrote data to a starpak, see STARPAK_CREATORS_MAGIC
+	// returns: whether the starpak has them, starpaks from the game or older builds don't
+	static bool ReadStarpakCreators(const MappedFile& input, std::vector<std::string>& creators);
+
+	// file name of the rpak, which gets recorded in the starpaks it writes to
+	inline std::string GetPakFileName() const { return fs::path(m_Path).filename().u8string(); }
+
+	// purpose: adds the data blocks of an existing starpak to the streamed data index, so they get
+	//          referenced instead of written again. starpakPath is the path that rpaks reference it by
+	// returns: the sorts table of the starpak
+	std::vector<SRPkFileEntry> LoadStarpakIndex(const std::string& filePath, const std::string& starpakPath, bool optional, bool external = true);
 
 	void FreeRawDataBlocks();
 	void FreeStarpakDataBlocks();
@@ -99,36 +246,131 @@ public:
 	void GenerateFileRelations();
 	void GenerateGuidData();
 
+	void IndexAsset(uint32_t assetIdx, const char* assetPath);
+
+	// purpose: turns the recorded asset dependencies into relations on the used assets
+	void ResolveAssetRelations();
+
 	_vseginfo_t CreateNewSegment(uint32_t size, uint32_t flags, uint32_t alignment, uint32_t vsegAlignment = -1);
 	RPakAssetEntry* GetAssetByGuid(uint64_t guid, uint32_t* idx = nullptr);
 
 
+	// purpose: picks the number of resident mips of each texture so that they fit in the resident texture budget
+	void PlanTextureStreaming(rapidjson::Value& files);
+
+	// purpose: reads the order in which assets are accessed after the pak is loaded, see m_AccessTraceGuids
+	void LoadAccessTrace(const std::string& filePath);
+	// purpose: moves the files of assets in the access trace to the front, in the order they are accessed
+	void OrderFilesByAccessTrace(rapidjson::Value& files) const;
+	uint32_t GetAccessRank(const std::string& assetPath, uint64_t guid) const;
+	uint32_t GetPlannedResidentMips(const char* assetPath, uint32_t defaultMips) const;
+
+	// decoded images that were kept from planning, null without a plan
+	inline SourceImageCache* GetImageCache() const { return m_Settings.m_pImageCache.get(); }
+
 	void BuildFromMap(const string& mapPath);
 
 private:
 	RPakVirtualSegment GetMatchingSegment(uint32_t flags, uint32_t alignment, uint32_t* segidx);
 
-	// next available starpak data offset
-	uint64_t m_NextStarpakOffset = 0x1000;
-	int m_Flags = 0;
+	void AddAssetsConcurrently(rapidjson::Value& files);
+	std::unique_ptr<CPakFile> CreateStage(int numThreads) const;
+	void MergeStagedPak(CPakFile& stage, const char* assetPath);
+
+	inline std::vector<std::unique_ptr<PakStarpakData>>& GetStarpaks(bool optional) { return optional ? m_vOptStarpaks : m_vStarpaks; }
+
+	uint32_t AddStarpak(const std::string& path, bool optional, bool external);
+	void LoadAppendedStarpak(const std::string& path, bool optional);
+	std::string GetStarpakOutputPath(const std::string& path) const;
+
+	static ContentHash HashStreamableData(const StreamableDataEntry& block);
+	static void ReadStreamableData(const StreamableDataEntry& block, std::vector<uint8_t>& data);
+	void ReadStoredStreamableData(const StreamableDataLocation& location, bool optional, std::vector<uint8_t>& data);
+	bool IsSameStreamableData(const StreamableDataEntry& block, const StreamableDataLocation& location, bool optional);
+
+	void QueueStarpakDataEntry(PakStarpakData& starpak, StreamableDataEntry& block);
+	void StartStarpakWriter(PakStarpakData& starpak);
+	void StarpakWriterFunc(PakStarpakData& starpak);
+
+	PakBuildSettings m_Settings;
+
+	// resident size that all textures of the pak together may have, 0 if there is no budget
+	uint64_t m_ResidentTextureBudget = 0;
+
+	// texture data that was added to the rpak and the starpak
+	uint64_t m_ResidentTextureSize = 0;
+	uint64_t m_StreamedTextureSize = 0;
+	uint64_t m_OptStreamedTextureSize = 0;
 
 	RPakFileHeader m_Header;
 
 	std::string m_Path;
-	std::string m_AssetPath;
-	std::string m_PrimaryStarpakPath;
+	std::string m_OutputPath;
 
 	std::vector<RPakAssetEntry> m_Assets;
 
+	// asset guid to index into m_Assets
+	std::unordered_map<uint64_t, uint32_t> m_AssetIndices;
+
 	std::vector<std::string> m_vStarpakPaths;
 	std::vector<std::string> m_vOptStarpakPaths;
 
 	std::vector<RPakVirtualSegment> m_vVirtualSegments;
+	// pages as they are created for the assets, and the pages that are written after laying them out
+	// assets refer to the created pages by their index, which serves as a handle to the page until
+	// LayoutPages assigns the final pages and offsets and moves every reference over to them
 	std::vector<RPakPageInfo> m_vPages;
+	std::vector<RPakPageInfo> m_vPackedPages;
+
+	// final page and offset of each created page
+	std::vector<PakPageLocation> m_vPageLocations;
+
+	// created pages smaller than this are packed together, 0 keeps every page on its own
+	uint32_t m_nMaxPackedPageSize = 0;
+
+	// pages are laid out in load order instead of the order they were created in
+	bool m_bOrderPages = false;
+
+	// position of each asset in the access trace by guid and by map file asset path
+	// assets in the trace are built, and have their pages laid out, first and in trace order
+	std::unordered_map<uint64_t, uint32_t> m_AccessTraceGuids;
+	std::unordered_map<std::string, uint32_t> m_AccessTracePaths;
+
 	std::vector<RPakDescriptor> m_vPakDescriptors;
 	std::vector<RPakGuidDescriptor> m_vGuidDescriptors;
 	std::vector<uint32_t> m_vFileRelations;
 
 	std::vector<RPakRawDataBlock> m_vRawDataBlocks;
-	std::vector<StreamableDataEntry> m_vStarpakDataBlocks;
+
+	// temporary file that finished page data is written to when PF_STREAM_PAGES is set
+	// it is read back in page order when the rpak is written
+	BinaryIO m_PageDataStream;
+	std::string m_PageDataStreamPath;
+	uint64_t m_nPageDataStreamSize = 0;
+	size_t m_nFlushedBlockCount = 0; // blocks before this one have been written to it
+
+	// streamed data of each mandatory starpak, and of each optional starpak, which holds the
+	// largest mips and doesn't have to be installed for the rpak to load. same order as the paths
+	std::vector<std::unique_ptr<PakStarpakData>> m_vStarpaks;
+	std::vector<std::unique_ptr<PakStarpakData>> m_vOptStarpaks;
+
+	// whether streamed data is written to the starpaks as soon as it is added
+	// each starpak has its own writer thread, so starpaks on different disks are written at the same time
+	bool m_bStreamStarpakData = false;
+
+	// streamed data by the hash of its padded data, for the mandatory and the optional starpaks
+	// data that is already in the index is referenced instead of being written again
+	std::unordered_map<ContentHash, StreamableDataLocation, ContentHashHasher> m_StreamingDataIndex[2];
+
+	// whether new streamed data is looked up in the index, see PakBuildSettings::m_bHashStreamedData
+	bool m_bDedupStreamedData = false;
+
+	// whether new streamed data is appended to starpaks from previous builds that are in the output directory
+	// the existing data blocks of these starpaks keep their offsets and are not written again
+	bool m_bAppendStarpaks = false;
+	std::unordered_map<std::string, std::vector<SRPkFileEntry>> m_AppendedStarpaks;
+
+	// streamed data that was found in the index instead of being written
+	uint64_t m_nDedupCount = 0;
+	uint64_t m_nDedupSize = 0;
 };
\ No newline at end of file
@@ -6,8 +6,19 @@
 #include <filesystem>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <sysinfoapi.h>
 #include <vector>
+#include <queue>
+#include <deque>
 #include <cstdint>
 #include <string>
 #include <fstream>
@@ -22,6 +33,9 @@
 #include "logic/rmem.h"
 #include "logic/rtech.h"
 
+#include "utils/logger.h"
+#include "utils/filewriter.h"
+#include "utils/mappedfile.h"
 #include "utils/binaryio.h"
 #include "utils/utils.h"
-#include "utils/logger.h"
+#include "utils/contenthash.h"
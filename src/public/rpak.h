@@ -16,6 +16,24 @@
 #define STARPAK_DATABLOCK_ALIGNMENT 4096
 #define STARPAK_DATABLOCK_ALIGNMENT_PADDING 0xCB
 
+// repak writes the file names of the rpaks that put data into a starpak into the header padding,
+// after this magic, as null terminated strings that end with an empty one. the game skips the
+// padding, the compactor only rewrites starpaks that were written by the rpaks it is given
+#define STARPAK_CREATORS_MAGIC	(('c'<<24)+('P'<<16)+('R'<<8)+'S')
+
+// assets reference streamed data by its offset, with the index of the starpak
+// in the rpak's starpak path list in the low bits that the alignment leaves free
+#define STARPAK_INDEX_MASK (STARPAK_DATABLOCK_ALIGNMENT - 1)
+
+// size of the streamed data that each starpak writer can be behind by before new entries have to wait
+#define STARPAK_MAX_PENDING_SIZE (256 * 1024 * 1024)
+
+// pages smaller than this are packed into shared pages with other pages of the same segment
+#define RPAK_PACKED_PAGE_SIZE 0x10000
+
+// the engine has room for this many virtual segments, any more write into unintended parts of its stack
+#define RPAK_MAX_VIRTUAL_SEGMENTS 20
+
 
 enum class AssetType : uint32_t
 {
@@ -46,15 +64,15 @@ struct RPakFileHeader
 	DWORD magic = 0x6b615052;
 
 	short fileVersion = 0x8;
-	char  flags[0x2];
+	char  flags[0x2]{};
 	FILETIME fileTime;
-	char  unk0[0x8];
+	char  unk0[0x8]{};
 	uint64_t compressedSize; // size of the rpak file on disk before decompression
 	uint64_t embeddedStarpakOffset = 0;
-	char  unk1[0x8];
+	char  unk1[0x8]{};
 	uint64_t decompressedSize; // actual data size of the rpak file after decompression
 	uint64_t embeddedStarpakSize = 0;
-	char  unk2[0x8];
+	char  unk2[0x8]{};
 	uint16_t starpakPathsSize = 0; // size in bytes of the section containing mandatory starpak paths
 	uint16_t optStarpakPathsSize = 0; // size in bytes of the section containing optional starpak paths
 	uint16_t virtualSegmentCount = 0;
@@ -71,7 +89,7 @@ struct RPakFileHeader
 	uint32_t unk8count = 0;
 
 	// only in apex
-	char  unk3[0x1c];
+	char  unk3[0x1c]{};
 };
 static_assert(sizeof(RPakFileHeader) == 136);
 
@@ -112,6 +130,17 @@ typedef RPakPtr RPakDescriptor;
 // guid references to other assets are within mem pages
 typedef RPakDescriptor RPakGuidDescriptor;
 
+// asset that another asset uses, by guid. the name is only used for reporting a dependency
+// that can't be found within the local assets, which fails the build if it is required
+struct RPakAssetDependency
+{
+	RPakAssetDependency(uint64_t guid, const std::string& name = "", bool required = false) : guid(guid), name(name), required(required) {};
+
+	uint64_t guid;
+	std::string name;
+	bool required;
+};
+
 // defines a bunch of values for registering/using an asset from the rpak
 struct RPakAssetEntry
 {
@@ -191,6 +220,13 @@ struct RPakAssetEntry
 public:
 	int _assetidx;
 
+	// range of page handles that were created while building this asset
+	uint32_t _firstPage = 0;
+	uint32_t _endPage = 0;
+
+	// position of the asset in the access trace, UINT32_MAX if it isn't in it
+	uint32_t _accessRank = UINT32_MAX;
+
 	// vector of indexes for local assets that use this asset
 	std::vector<unsigned int> _relations{};
 
@@ -205,6 +241,21 @@ public:
 		for (auto& it : *descs)
 			_guids.push_back(it);
 	};
+
+	// path of the asset in the map file, used when reporting problems with the asset
+	std::string _path;
+
+	// other assets that this asset uses
+	// these get resolved into relations on the used assets once all assets have been added to the pak
+	std::vector<RPakAssetDependency> _dependencies{};
+
+	inline void AddDependency(const RPakAssetDependency& dep) { _dependencies.push_back(dep); };
+
+	inline void AddDependencies(std::vector<RPakAssetDependency>* deps)
+	{
+		for (auto& it : *deps)
+			_dependencies.push_back(it);
+	};
 };
 #pragma pack(pop)
 
@@ -212,8 +263,13 @@ public:
 struct RPakRawDataBlock
 {
 	uint32_t m_nPageIdx;
-	uint64_t m_nDataSize;
+	uint64_t m_nDataSize; // size of the data, excluding padding
 	uint8_t* m_nDataPtr;
+	uint32_t m_nAlignment = 1; // padding up to this alignment is generated when the block is written
+	uint32_t m_nPadding = 0; // zero bytes after the aligned data, up to the next block in a packed page
+	uint64_t m_nStreamOffset = 0; // offset of the data in the temporary page data file once m_nDataPtr has been flushed to it
+
+	inline uint64_t GetPaddedSize() const { return Utils::AlignSize(m_nDataSize, m_nAlignment) + m_nPadding; };
 };
 
 // starpak header
@@ -223,12 +279,38 @@ struct StreamableSetHeader
 	int version;
 };
 
+// byte range of a source file that makes up part of a streaming data entry
+struct StreamableDataRange
+{
+	uint64_t m_nOffset;
+	uint64_t m_nSize;
+};
+
 // internal data structure for referencing streaming data to be written
 struct StreamableDataEntry
 {
 	uint64_t m_nOffset = -1; // set when added
-	uint64_t m_nDataSize = 0;
+	uint64_t m_nDataSize = 0; // size of the data, excluding padding
 	uint8_t* m_nDataPtr = nullptr;
+
+	// if set, the data is copied from these ranges of the source file when the entry is written
+	// instead of being held in m_nDataPtr
+	std::string m_SourcePath;
+	std::vector<StreamableDataRange> m_vSourceRanges;
+
+	uint32_t m_nAlignment = STARPAK_DATABLOCK_ALIGNMENT; // padding up to this alignment is generated when the entry is written
+
+	// index of the starpak in the rpak's mandatory or optional starpak path list, set when added
+	uint32_t m_nStarpakIdx = 0;
+
+	// hash of the data including its padding, used to find entries with the same data
+	ContentHash m_Hash;
+	bool m_bHashed = false;
+
+	inline uint64_t GetPaddedSize() const { return Utils::AlignSize(m_nDataSize, m_nAlignment); };
+
+	// offset that assets reference the entry by
+	inline uint64_t GetAssetOffset() const { return m_nOffset | m_nStarpakIdx; };
 };
 
 //
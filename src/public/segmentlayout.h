@@ -0,0 +1,44 @@
+#pragma once
+
+// this header is also compiled into repak-loadsim, so it may only use the standard library
+#include <cstdint>
+#include <vector>
+
+// page as far as its placement within its virtual segment is concerned
+struct SegmentPage
+{
+	uint32_t segIdx;
+	uint32_t alignment;
+	uint64_t dataSize;
+};
+
+//-----------------------------------------------------------------------------
+// purpose: places the pages in their virtual segments like the engine does, one
+//          after another in page order, each aligned to its own alignment
+//          getPage(i) returns the SegmentPage of page i
+// returns: size that each segment needs to hold its pages
+//-----------------------------------------------------------------------------
+template <typename GetPage>
+std::vector<uint64_t> PlaceSegmentPages(size_t segmentCount, size_t pageCount, GetPage getPage, std::vector<uint64_t>* pageOffsets = nullptr)
+{
+	std::vector<uint64_t> segmentSizes(segmentCount, 0);
+
+	if (pageOffsets)
+		pageOffsets->assign(pageCount, 0);
+
+	for (size_t i = 0; i < pageCount; ++i)
+	{
+		const SegmentPage page = getPage(i);
+		const uint64_t alignment = page.alignment > 0 ? page.alignment : 1;
+
+		uint64_t& size = segmentSizes[page.segIdx];
+		size = (size + alignment - 1) / alignment * alignment;
+
+		if (pageOffsets)
+			(*pageOffsets)[i] = size;
+
+		size += page.dataSize;
+	}
+
+	return segmentSizes;
+}
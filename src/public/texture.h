@@ -97,68 +97,100 @@ struct UIImageOffset
 };
 #pragma pack(pop)
 
-// map of dxgi format to the corresponding txtr asset format value
-static const std::map<DXGI_FORMAT, uint16_t> s_txtrFormatMap{
-	{ DXGI_FORMAT_BC1_UNORM, 0 },
-	{ DXGI_FORMAT_BC1_UNORM_SRGB, 1 },
-	{ DXGI_FORMAT_BC2_UNORM, 2 },
-	{ DXGI_FORMAT_BC2_UNORM_SRGB, 3 },
-	{ DXGI_FORMAT_BC3_UNORM, 4 },
-	{ DXGI_FORMAT_BC3_UNORM_SRGB, 5 },
-	{ DXGI_FORMAT_BC4_UNORM, 6 },
-	{ DXGI_FORMAT_BC4_SNORM, 7 },
-	{ DXGI_FORMAT_BC5_UNORM, 8 },
-	{ DXGI_FORMAT_BC5_SNORM, 9 },
-	{ DXGI_FORMAT_BC6H_UF16, 10 },
-	{ DXGI_FORMAT_BC6H_SF16, 11 },
-	{ DXGI_FORMAT_BC7_UNORM, 12 },
-	{ DXGI_FORMAT_BC7_UNORM_SRGB, 13 },
-	{ DXGI_FORMAT_R32G32B32A32_FLOAT, 14 },
-	{ DXGI_FORMAT_R32G32B32A32_UINT, 15 },
-	{ DXGI_FORMAT_R32G32B32A32_SINT, 16 },
-	{ DXGI_FORMAT_R32G32B32_FLOAT, 17 },
-	{ DXGI_FORMAT_R32G32B32_UINT, 18 },
-	{ DXGI_FORMAT_R32G32B32_SINT, 19 },
-	{ DXGI_FORMAT_R16G16B16A16_FLOAT, 20 },
-	{ DXGI_FORMAT_R16G16B16A16_UNORM, 21 },
-	{ DXGI_FORMAT_R16G16B16A16_UINT, 22 },
-	{ DXGI_FORMAT_R16G16B16A16_SNORM, 23 },
-	{ DXGI_FORMAT_R16G16B16A16_SINT, 24 },
-	{ DXGI_FORMAT_R32G32_FLOAT, 25 },
-	{ DXGI_FORMAT_R32G32_UINT, 26 },
-	{ DXGI_FORMAT_R32G32_SINT, 27 },
-	{ DXGI_FORMAT_R10G10B10A2_UNORM, 28 },
-	{ DXGI_FORMAT_R10G10B10A2_UINT, 29 },
-	{ DXGI_FORMAT_R11G11B10_FLOAT, 30 },
-	{ DXGI_FORMAT_R8G8B8A8_UNORM, 31 },
-	{ DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 32 },
-	{ DXGI_FORMAT_R8G8B8A8_UINT, 33 },
-	{ DXGI_FORMAT_R8G8B8A8_SNORM, 34 },
-	{ DXGI_FORMAT_R8G8B8A8_SINT, 35 },
-	{ DXGI_FORMAT_R16G16_FLOAT, 36 },
-	{ DXGI_FORMAT_R16G16_UNORM, 37 },
-	{ DXGI_FORMAT_R16G16_UINT, 38 },
-	{ DXGI_FORMAT_R16G16_SNORM, 39 },
-	{ DXGI_FORMAT_R16G16_SINT, 40 },
-	{ DXGI_FORMAT_R32_FLOAT, 41 },
-	{ DXGI_FORMAT_R32_UINT, 42 },
-	{ DXGI_FORMAT_R32_SINT, 43 },
-	{ DXGI_FORMAT_R8G8_UNORM, 44 },
-	{ DXGI_FORMAT_R8G8_UINT, 45 },
-	{ DXGI_FORMAT_R8G8_SNORM, 46 },
-	{ DXGI_FORMAT_R8G8_SINT, 47 },
-	{ DXGI_FORMAT_R16_FLOAT, 48 },
-	{ DXGI_FORMAT_R16_UNORM, 49 },
-	{ DXGI_FORMAT_R16_UINT, 50 },
-	{ DXGI_FORMAT_R16_SNORM, 51 },
-	{ DXGI_FORMAT_R16_SINT, 52 },
-	{ DXGI_FORMAT_R8_UNORM, 53 },
-	{ DXGI_FORMAT_R8_UINT, 54 },
-	{ DXGI_FORMAT_R8_SNORM, 55 },
-	{ DXGI_FORMAT_R8_SINT, 56 },
-	{ DXGI_FORMAT_A8_UNORM, 57 },
-	{ DXGI_FORMAT_R9G9B9E5_SHAREDEXP, 58 },
-	{ DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM, 59 },
-	{ DXGI_FORMAT_D32_FLOAT, 60 },
-	{ DXGI_FORMAT_D16_UNORM, 61 },
+// internal description of where a mip is in the dds payload and in the rpak
+struct TextureMipLayout
+{
+	uint32_t ddsOffset; // offset from the start of the dds payload
+	uint32_t ddsSize;
+	uint32_t rpakSize; // size in the rpak, may be larger than the dds data
+	bool streamed; // in the mandatory starpak
+	bool optStreamed; // in the optional starpak
+};
+
+// internal description of how the mips of a texture can be split between the rpak and the starpak
+struct TextureStreamingLimits
+{
+	std::vector<uint32_t> mipSizes; // size of each mip in the rpak, largest mip first
+	uint32_t minResidentMips; // mips that can't be streamed
+	uint32_t residentMips; // mips that stay in the rpak when no pak-wide budget is set
 };
+
+// txtr asset format value of each dxgi format, indexed by DXGI_FORMAT. -1 if txtr assets can't use the format
+static constexpr std::array<int16_t, DXGI_FORMAT_TABLE_SIZE> s_txtrFormatMap = []() constexpr
+{
+	std::array<int16_t, DXGI_FORMAT_TABLE_SIZE> map{};
+
+	for (auto& it : map)
+		it = -1;
+
+	map[DXGI_FORMAT_BC1_UNORM] = 0;
+	map[DXGI_FORMAT_BC1_UNORM_SRGB] = 1;
+	map[DXGI_FORMAT_BC2_UNORM] = 2;
+	map[DXGI_FORMAT_BC2_UNORM_SRGB] = 3;
+	map[DXGI_FORMAT_BC3_UNORM] = 4;
+	map[DXGI_FORMAT_BC3_UNORM_SRGB] = 5;
+	map[DXGI_FORMAT_BC4_UNORM] = 6;
+	map[DXGI_FORMAT_BC4_SNORM] = 7;
+	map[DXGI_FORMAT_BC5_UNORM] = 8;
+	map[DXGI_FORMAT_BC5_SNORM] = 9;
+	map[DXGI_FORMAT_BC6H_UF16] = 10;
+	map[DXGI_FORMAT_BC6H_SF16] = 11;
+	map[DXGI_FORMAT_BC7_UNORM] = 12;
+	map[DXGI_FORMAT_BC7_UNORM_SRGB] = 13;
+	map[DXGI_FORMAT_R32G32B32A32_FLOAT] = 14;
+	map[DXGI_FORMAT_R32G32B32A32_UINT] = 15;
+	map[DXGI_FORMAT_R32G32B32A32_SINT] = 16;
+	map[DXGI_FORMAT_R32G32B32_FLOAT] = 17;
+	map[DXGI_FORMAT_R32G32B32_UINT] = 18;
+	map[DXGI_FORMAT_R32G32B32_SINT] = 19;
+	map[DXGI_FORMAT_R16G16B16A16_FLOAT] = 20;
+	map[DXGI_FORMAT_R16G16B16A16_UNORM] = 21;
+	map[DXGI_FORMAT_R16G16B16A16_UINT] = 22;
+	map[DXGI_FORMAT_R16G16B16A16_SNORM] = 23;
+	map[DXGI_FORMAT_R16G16B16A16_SINT] = 24;
+	map[DXGI_FORMAT_R32G32_FLOAT] = 25;
+	map[DXGI_FORMAT_R32G32_UINT] = 26;
+	map[DXGI_FORMAT_R32G32_SINT] = 27;
+	map[DXGI_FORMAT_R10G10B10A2_UNORM] = 28;
+	map[DXGI_FORMAT_R10G10B10A2_UINT] = 29;
+	map[DXGI_FORMAT_R11G11B10_FLOAT] = 30;
+	map[DXGI_FORMAT_R8G8B8A8_UNORM] = 31;
+	map[DXGI_FORMAT_R8G8B8A8_UNORM_SRGB] = 32;
+	map[DXGI_FORMAT_R8G8B8A8_UINT] = 33;
+	map[DXGI_FORMAT_R8G8B8A8_SNORM] = 34;
+	map[DXGI_FORMAT_R8G8B8A8_SINT] = 35;
+	map[DXGI_FORMAT_R16G16_FLOAT] = 36;
+	map[DXGI_FORMAT_R16G16_UNORM] = 37;
+	map[DXGI_FORMAT_R16G16_UINT] = 38;
+	map[DXGI_FORMAT_R16G16_SNORM] = 39;
+	map[DXGI_FORMAT_R16G16_SINT] = 40;
+	map[DXGI_FORMAT_R32_FLOAT] = 41;
+	map[DXGI_FORMAT_R32_UINT] = 42;
+	map[DXGI_FORMAT_R32_SINT] = 43;
+	map[DXGI_FORMAT_R8G8_UNORM] = 44;
+	map[DXGI_FORMAT_R8G8_UINT] = 45;
+	map[DXGI_FORMAT_R8G8_SNORM] = 46;
+	map[DXGI_FORMAT_R8G8_SINT] = 47;
+	map[DXGI_FORMAT_R16_FLOAT] = 48;
+	map[DXGI_FORMAT_R16_UNORM] = 49;
+	map[DXGI_FORMAT_R16_UINT] = 50;
+	map[DXGI_FORMAT_R16_SNORM] = 51;
+	map[DXGI_FORMAT_R16_SINT] = 52;
+	map[DXGI_FORMAT_R8_UNORM] = 53;
+	map[DXGI_FORMAT_R8_UINT] = 54;
+	map[DXGI_FORMAT_R8_SNORM] = 55;
+	map[DXGI_FORMAT_R8_SINT] = 56;
+	map[DXGI_FORMAT_A8_UNORM] = 57;
+	map[DXGI_FORMAT_R9G9B9E5_SHAREDEXP] = 58;
+	map[DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM] = 59;
+	map[DXGI_FORMAT_D32_FLOAT] = 60;
+	map[DXGI_FORMAT_D16_UNORM] = 61;
+
+	return map;
+}();
+
+// returns whether txtr assets can use the dxgi format
+static constexpr bool IsTxtrFormatSupported(DXGI_FORMAT fmt)
+{
+	return fmt < DXGI_FORMAT_TABLE_SIZE && s_txtrFormatMap[fmt] != -1;
+}
@@ -0,0 +1,860 @@
+//=============================================================================//
+//
+// purpose: cpu block compression (bc1/bc2/bc3/bc4/bc5/bc7) for texture sources
+//
+//=============================================================================//
+#include "pch.h"
+#include "dxutils.h"
+#include "bcencoder.h"
+#include <emmintrin.h>
+#include <cfloat>
+
+// 4x4 block of pixels with one array per channel (r, g, b, a), so sse ops cover four pixels at a time
+struct PixelBlock
+{
+	alignas(16) float c[4][16];
+};
+
+alignas(16) static const float s_AllPixels[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+// bc7 interpolation weights for 4 bit indices
+static const int s_BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline float HorizontalSum(__m128 v)
+{
+	__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+
+	return _mm_cvtss_f32(sums);
+}
+
+static inline float ClampChannel(float v)
+{
+	return v < 0.f ? 0.f : (v > 255.f ? 255.f : v);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: loads a 4x4 block, repeating the edge pixels for blocks that go past the image
+//-----------------------------------------------------------------------------
+static void LoadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, PixelBlock& block)
+{
+	for (uint32_t y = 0; y < 4; ++y)
+	{
+		uint32_t py = by * 4 + y < height ? by * 4 + y : height - 1;
+
+		for (uint32_t x = 0; x < 4; ++x)
+		{
+			uint32_t px = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			const uint8_t* src = pixels + ((size_t)py * width + px) * 4;
+
+			for (int c = 0; c < 4; ++c)
+				block.c[c][y * 4 + x] = src[c];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: fits a line through the masked pixels of a block along their principal axis
+//          and returns its end points
+//-----------------------------------------------------------------------------
+static void FitEndpoints(const PixelBlock& block, int numChannels, const float* mask, float* lo, float* hi)
+{
+	__m128 count = _mm_setzero_ps();
+	for (int i = 0; i < 16; i += 4)
+		count = _mm_add_ps(count, _mm_load_ps(mask + i));
+
+	float weight = 1.f / HorizontalSum(count);
+
+	float mean[4]{};
+	for (int c = 0; c < numChannels; ++c)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int i = 0; i < 16; i += 4)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(block.c[c] + i), _mm_load_ps(mask + i)));
+
+		mean[c] = HorizontalSum(sum) * weight;
+	}
+
+	float cov[4][4]{};
+	for (int c0 = 0; c0 < numChannels; ++c0)
+	{
+		for (int c1 = c0; c1 < numChannels; ++c1)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int i = 0; i < 16; i += 4)
+			{
+				__m128 d0 = _mm_sub_ps(_mm_load_ps(block.c[c0] + i), _mm_set1_ps(mean[c0]));
+				__m128 d1 = _mm_sub_ps(_mm_load_ps(block.c[c1] + i), _mm_set1_ps(mean[c1]));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(d0, d1), _mm_load_ps(mask + i)));
+			}
+
+			cov[c0][c1] = cov[c1][c0] = HorizontalSum(sum) * weight;
+		}
+	}
+
+	// power iteration, starting from the channel with the most variance
+	int start = 0;
+	for (int c = 1; c < numChannels; ++c)
+	{
+		if (cov[c][c] > cov[start][start])
+			start = c;
+	}
+
+	float axis[4]{};
+	for (int c = 0; c < numChannels; ++c)
+		axis[c] = cov[start][c];
+
+	float length = 0.f;
+	for (int iter = 0; iter < 8; ++iter)
+	{
+		float next[4]{};
+		for (int c0 = 0; c0 < numChannels; ++c0)
+		{
+			for (int c1 = 0; c1 < numChannels; ++c1)
+				next[c0] += cov[c0][c1] * axis[c1];
+		}
+
+		float largest = 0.f;
+		for (int c = 0; c < numChannels; ++c)
+			largest = fabsf(next[c]) > largest ? fabsf(next[c]) : largest;
+
+		// flat block, every pixel is the mean
+		if (largest < 1e-8f)
+			break;
+
+		for (int c = 0; c < numChannels; ++c)
+			axis[c] = next[c] / largest;
+
+		length = 1.f;
+	}
+
+	if (length == 0.f)
+	{
+		memcpy(lo, mean, numChannels * sizeof(float));
+		memcpy(hi, mean, numChannels * sizeof(float));
+		return;
+	}
+
+	length = 0.f;
+	for (int c = 0; c < numChannels; ++c)
+		length += axis[c] * axis[c];
+
+	length = 1.f / sqrtf(length);
+	for (int c = 0; c < numChannels; ++c)
+		axis[c] *= length;
+
+	// project the pixels onto the axis. masked out pixels land on the mean, which is always inside the range
+	__m128 tMin = _mm_set1_ps(FLT_MAX);
+	__m128 tMax = _mm_set1_ps(-FLT_MAX);
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 t = _mm_setzero_ps();
+		for (int c = 0; c < numChannels; ++c)
+			t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.c[c] + i), _mm_set1_ps(mean[c])), _mm_set1_ps(axis[c])));
+
+		t = _mm_mul_ps(t, _mm_load_ps(mask + i));
+		tMin = _mm_min_ps(tMin, t);
+		tMax = _mm_max_ps(tMax, t);
+	}
+
+	alignas(16) float mins[4];
+	alignas(16) float maxs[4];
+	_mm_store_ps(mins, tMin);
+	_mm_store_ps(maxs, tMax);
+
+	float minT = mins[0];
+	float maxT = maxs[0];
+	for (int i = 1; i < 4; ++i)
+	{
+		minT = mins[i] < minT ? mins[i] : minT;
+		maxT = maxs[i] > maxT ? maxs[i] : maxT;
+	}
+
+	for (int c = 0; c < numChannels; ++c)
+	{
+		lo[c] = ClampChannel(mean[c] + axis[c] * minT);
+		hi[c] = ClampChannel(mean[c] + axis[c] * maxT);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: least squares fit of both end points for the given per-pixel interpolation weights
+// returns: false if the weights don't determine the end points
+//-----------------------------------------------------------------------------
+static bool RefitEndpoints(const PixelBlock& block, int numChannels, const float* weights, const float* mask, float* e0, float* e1)
+{
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float x0[4]{};
+	float x1[4]{};
+
+	for (int i = 0; i < 16; ++i)
+	{
+		float b = weights[i] * mask[i];
+		float a = (1.f - weights[i]) * mask[i];
+
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			x0[c] += a * block.c[c][i];
+			x1[c] += b * block.c[c][i];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	det = 1.f / det;
+	for (int c = 0; c < numChannels; ++c)
+	{
+		e0[c] = ClampChannel((bb * x0[c] - ab * x1[c]) * det);
+		e1[c] = ClampChannel((aa * x1[c] - ab * x0[c]) * det);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: picks the closest palette entry for each masked pixel
+// returns: total squared error of the masked pixels
+//-----------------------------------------------------------------------------
+static float SelectPaletteIndices(const PixelBlock& block, int numChannels, const float (*palette)[4], int paletteSize, const float* mask, uint8_t* indices)
+{
+	alignas(16) int32_t best[16];
+	alignas(16) float bestDist[16];
+
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 minDist = _mm_set1_ps(FLT_MAX);
+		__m128i minIndex = _mm_setzero_si128();
+
+		for (int p = 0; p < paletteSize; ++p)
+		{
+			__m128 dist = _mm_setzero_ps();
+			for (int c = 0; c < numChannels; ++c)
+			{
+				__m128 d = _mm_sub_ps(_mm_load_ps(block.c[c] + i), _mm_set1_ps(palette[p][c]));
+				dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+			}
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, minDist));
+			minDist = _mm_min_ps(dist, minDist);
+			minIndex = _mm_or_si128(_mm_andnot_si128(closer, minIndex), _mm_and_si128(closer, _mm_set1_epi32(p)));
+		}
+
+		_mm_store_si128((__m128i*)(best + i), minIndex);
+		_mm_store_ps(bestDist + i, _mm_mul_ps(minDist, _mm_load_ps(mask + i)));
+	}
+
+	float error = 0.f;
+	for (int i = 0; i < 16; ++i)
+	{
+		indices[i] = (uint8_t)best[i];
+		error += bestDist[i];
+	}
+
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// bc1 colour blocks (also the colour half of bc2 and bc3)
+//-----------------------------------------------------------------------------
+
+static uint16_t QuantizeRGB565(const float* color)
+{
+	int r = (int)(ClampChannel(color[0]) * (31.f / 255.f) + 0.5f);
+	int g = (int)(ClampChannel(color[1]) * (63.f / 255.f) + 0.5f);
+	int b = (int)(ClampChannel(color[2]) * (31.f / 255.f) + 0.5f);
+
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, float* color)
+{
+	int r = (packed >> 11) & 0x1F;
+	int g = (packed >> 5) & 0x3F;
+	int b = packed & 0x1F;
+
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+	color[3] = 255.f;
+}
+
+static float SelectColorIndices(const PixelBlock& block, uint16_t c0, uint16_t c1, bool threeColor, const float* mask, uint8_t* indices)
+{
+	float palette[4][4];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+
+	for (int c = 0; c < 3; ++c)
+	{
+		if (threeColor)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) * 0.5f;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] * 2.f + palette[1][c]) * (1.f / 3.f);
+			palette[3][c] = (palette[0][c] + palette[1][c] * 2.f) * (1.f / 3.f);
+		}
+	}
+
+	float error = SelectPaletteIndices(block, 3, palette, threeColor ? 3 : 4, mask, indices);
+
+	// index 3 is transparent black in three colour blocks
+	for (int i = 0; i < 16; ++i)
+	{
+		if (mask[i] == 0.f)
+			indices[i] = 3;
+	}
+
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: encodes the 8 byte colour block. pixels with alpha below 128 are made
+//          transparent if allowTransparent is set (bc1 only)
+//-----------------------------------------------------------------------------
+static void EncodeColorBlock(const PixelBlock& block, bool allowTransparent, uint8_t* out)
+{
+	alignas(16) float mask[16];
+	int numOpaque = 0;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		mask[i] = allowTransparent && block.c[3][i] < 128.f ? 0.f : 1.f;
+		numOpaque += mask[i] != 0.f;
+	}
+
+	bool threeColor = numOpaque != 16;
+
+	uint16_t c0 = 0;
+	uint16_t c1 = 0;
+	uint8_t indices[16];
+
+	if (numOpaque == 0)
+	{
+		// fully transparent, every index is 3 and the end points only have to select three colour mode
+		memset(indices, 3, sizeof(indices));
+	}
+	else
+	{
+		float lo[3];
+		float hi[3];
+		FitEndpoints(block, 3, mask, lo, hi);
+
+		c0 = QuantizeRGB565(hi);
+		c1 = QuantizeRGB565(lo);
+
+		float error = SelectColorIndices(block, c0, c1, threeColor, mask, indices);
+
+		// one least squares pass over the chosen indices usually lands closer than the principal axis
+		static const float s_Weights4[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+		static const float s_Weights3[4] = { 0.f, 1.f, 0.5f, 0.f };
+
+		float weights[16];
+		for (int i = 0; i < 16; ++i)
+			weights[i] = (threeColor ? s_Weights3 : s_Weights4)[indices[i]];
+
+		float e0[3];
+		float e1[3];
+		if (RefitEndpoints(block, 3, weights, mask, e0, e1))
+		{
+			uint16_t r0 = QuantizeRGB565(e0);
+			uint16_t r1 = QuantizeRGB565(e1);
+
+			uint8_t refined[16];
+			if (SelectColorIndices(block, r0, r1, threeColor, mask, refined) < error)
+			{
+				c0 = r0;
+				c1 = r1;
+				memcpy(indices, refined, sizeof(indices));
+			}
+		}
+	}
+
+	// the end point order selects the block mode, so swap them into place
+	if (!threeColor)
+	{
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+			for (int i = 0; i < 16; ++i)
+				indices[i] ^= 1;
+		}
+		else if (c0 == c1)
+		{
+			memset(indices, 0, sizeof(indices));
+		}
+	}
+	else if (c0 > c1)
+	{
+		std::swap(c0, c1);
+		for (int i = 0; i < 16; ++i)
+		{
+			if (indices[i] < 2)
+				indices[i] ^= 1;
+		}
+	}
+
+	uint32_t packedIndices = 0;
+	for (int i = 0; i < 16; ++i)
+		packedIndices |= (uint32_t)indices[i] << (i * 2);
+
+	memcpy(out, &c0, sizeof(uint16_t));
+	memcpy(out + 2, &c1, sizeof(uint16_t));
+	memcpy(out + 4, &packedIndices, sizeof(uint32_t));
+}
+
+//-----------------------------------------------------------------------------
+// bc4 single channel blocks (also the alpha half of bc3 and both halves of bc5)
+//-----------------------------------------------------------------------------
+static void EncodeSingleChannelBlock(const float* values, uint8_t* out)
+{
+	float minValue = values[0];
+	float maxValue = values[0];
+	for (int i = 1; i < 16; ++i)
+	{
+		minValue = values[i] < minValue ? values[i] : minValue;
+		maxValue = values[i] > maxValue ? values[i] : maxValue;
+	}
+
+	uint8_t a0 = (uint8_t)(maxValue + 0.5f);
+	uint8_t a1 = (uint8_t)(minValue + 0.5f);
+
+	uint64_t packed = a0 | (a1 << 8);
+
+	// with a0 > a1 the block interpolates 6 values between the end points
+	if (a0 > a1)
+	{
+		float palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * a0 + i * a1) * (1.f / 7.f);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+			float bestDist = FLT_MAX;
+			for (int p = 0; p < 8; ++p)
+			{
+				float dist = fabsf(values[i] - palette[p]);
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					best = p;
+				}
+			}
+
+			packed |= (uint64_t)best << (16 + i * 3);
+		}
+	}
+
+	memcpy(out, &packed, sizeof(uint64_t));
+}
+
+//-----------------------------------------------------------------------------
+// purpose: encodes the explicit 4 bit alpha block of bc2
+//-----------------------------------------------------------------------------
+static void EncodeExplicitAlphaBlock(const float* values, uint8_t* out)
+{
+	uint64_t packed = 0;
+	for (int i = 0; i < 16; ++i)
+		packed |= (uint64_t)(values[i] * (15.f / 255.f) + 0.5f) << (i * 4);
+
+	memcpy(out, &packed, sizeof(uint64_t));
+}
+
+//-----------------------------------------------------------------------------
+// bc7, mode 6 only (one subset, rgba 7.7.7.7 end points with a p-bit each, 4 bit indices)
+//-----------------------------------------------------------------------------
+struct BC7Endpoints
+{
+	uint8_t q[2][4]; // 7 bit end points
+	uint8_t p[2]; // shared lsb of each end point
+};
+
+static void QuantizeBC7Endpoint(const float* e, uint8_t* q, uint8_t& pbit)
+{
+	float bestError = FLT_MAX;
+
+	for (int p = 0; p < 2; ++p)
+	{
+		uint8_t candidate[4];
+		float error = 0.f;
+
+		for (int c = 0; c < 4; ++c)
+		{
+			int v = (int)((ClampChannel(e[c]) - p) * 0.5f + 0.5f);
+			v = v < 0 ? 0 : (v > 127 ? 127 : v);
+
+			float d = (float)((v << 1) | p) - e[c];
+			error += d * d;
+			candidate[c] = (uint8_t)v;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(q, candidate, sizeof(candidate));
+			pbit = (uint8_t)p;
+		}
+	}
+}
+
+static float SelectBC7Indices(const PixelBlock& block, const BC7Endpoints& ep, uint8_t* indices)
+{
+	float palette[16][4];
+
+	for (int c = 0; c < 4; ++c)
+	{
+		int e0 = (ep.q[0][c] << 1) | ep.p[0];
+		int e1 = (ep.q[1][c] << 1) | ep.p[1];
+
+		for (int i = 0; i < 16; ++i)
+			palette[i][c] = (float)(((64 - s_BC7Weights4[i]) * e0 + s_BC7Weights4[i] * e1 + 32) >> 6);
+	}
+
+	return SelectPaletteIndices(block, 4, palette, 16, s_AllPixels, indices);
+}
+
+static void EncodeBC7Block(const PixelBlock& block, uint8_t* out)
+{
+	float lo[4];
+	float hi[4];
+	FitEndpoints(block, 4, s_AllPixels, lo, hi);
+
+	BC7Endpoints ep;
+	QuantizeBC7Endpoint(lo, ep.q[0], ep.p[0]);
+	QuantizeBC7Endpoint(hi, ep.q[1], ep.p[1]);
+
+	uint8_t indices[16];
+	float error = SelectBC7Indices(block, ep, indices);
+
+	float weights[16];
+	for (int i = 0; i < 16; ++i)
+		weights[i] = s_BC7Weights4[indices[i]] * (1.f / 64.f);
+
+	float e0[4];
+	float e1[4];
+	if (RefitEndpoints(block, 4, weights, s_AllPixels, e0, e1))
+	{
+		BC7Endpoints refined;
+		QuantizeBC7Endpoint(e0, refined.q[0], refined.p[0]);
+		QuantizeBC7Endpoint(e1, refined.q[1], refined.p[1]);
+
+		uint8_t refinedIndices[16];
+		if (SelectBC7Indices(block, refined, refinedIndices) < error)
+		{
+			ep = refined;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// the msb of the first index is implied to be 0, so flip the end points if it is set
+	if (indices[0] & 8)
+	{
+		std::swap(ep.q[0], ep.q[1]);
+		std::swap(ep.p[0], ep.p[1]);
+
+		for (int i = 0; i < 16; ++i)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+
+	uint32_t bit = 0;
+	auto writeBits = [&](uint32_t value, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i, ++bit)
+			out[bit >> 3] |= ((value >> i) & 1) << (bit & 7);
+	};
+
+	writeBits(1 << 6, 7); // mode 6
+
+	for (int c = 0; c < 4; ++c)
+	{
+		writeBits(ep.q[0][c], 7);
+		writeBits(ep.q[1][c], 7);
+	}
+
+	writeBits(ep.p[0], 1);
+	writeBits(ep.p[1], 1);
+
+	writeBits(indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		writeBits(indices[i], 4);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: encodes one row of blocks
+//-----------------------------------------------------------------------------
+static void EncodeBlockRow(const uint8_t* pixels, uint32_t width, uint32_t height, DXGI_FORMAT format, uint32_t by, uint8_t* out)
+{
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t bytesPerBlock = dxutils::GetFormatTraits(format).bytesPerBlock;
+
+	PixelBlock block;
+
+	for (uint32_t bx = 0; bx < blocksWide; ++bx)
+	{
+		LoadBlock(pixels, width, height, bx, by, block);
+
+		uint8_t* dst = out + ((size_t)by * blocksWide + bx) * bytesPerBlock;
+
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			EncodeColorBlock(block, true, dst);
+			break;
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			EncodeExplicitAlphaBlock(block.c[3], dst);
+			EncodeColorBlock(block, false, dst + 8);
+			break;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			EncodeSingleChannelBlock(block.c[3], dst);
+			EncodeColorBlock(block, false, dst + 8);
+			break;
+		case DXGI_FORMAT_BC4_UNORM:
+			EncodeSingleChannelBlock(block.c[0], dst);
+			break;
+		case DXGI_FORMAT_BC5_UNORM:
+			EncodeSingleChannelBlock(block.c[0], dst);
+			EncodeSingleChannelBlock(block.c[1], dst + 8);
+			break;
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			EncodeBC7Block(block, dst);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: checks whether rgba8 images can be encoded into the format
+//-----------------------------------------------------------------------------
+bool BCEncoder::IsFormatSupported(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: encodes an rgba8 surface into the format
+//-----------------------------------------------------------------------------
+void BCEncoder::EncodeSurface(const uint8_t* pixels, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* out, int numThreads)
+{
+	// uncompressed rgba is already in the right layout
+	if (format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+	{
+		memcpy(out, pixels, (size_t)width * height * 4);
+		return;
+	}
+
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+
+	// threads take the next unencoded row of blocks until none are left
+	std::atomic<uint32_t> nextRow{ 0 };
+
+	auto encodeRows = [&]() {
+		for (uint32_t by = nextRow++; by < blocksHigh; by = nextRow++)
+			EncodeBlockRow(pixels, width, height, format, by, out);
+	};
+
+	uint32_t maxThreads = (blocksWide * blocksHigh) / BCENCODER_MIN_BLOCKS_PER_THREAD;
+	maxThreads = maxThreads < blocksHigh ? maxThreads : blocksHigh;
+
+	uint32_t threadCount = numThreads > 1 ? (uint32_t)numThreads : 1;
+	threadCount = threadCount < maxThreads ? threadCount : maxThreads;
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; ++i)
+		threads.emplace_back(encodeRows);
+
+	encodeRows();
+
+	for (auto& it : threads)
+		it.join();
+}
+
+//-----------------------------------------------------------------------------
+// decoding
+//-----------------------------------------------------------------------------
+static void DecodeColorBlock(const uint8_t* in, bool allowTransparent, uint8_t (*out)[4])
+{
+	uint16_t c0;
+	uint16_t c1;
+	uint32_t packedIndices;
+	memcpy(&c0, in, sizeof(uint16_t));
+	memcpy(&c1, in + 2, sizeof(uint16_t));
+	memcpy(&packedIndices, in + 4, sizeof(uint32_t));
+
+	float palette[4][4];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+
+	bool threeColor = allowTransparent && c0 <= c1;
+
+	for (int c = 0; c < 3; ++c)
+	{
+		if (threeColor)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) * 0.5f;
+			palette[3][c] = 0.f;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] * 2.f + palette[1][c]) * (1.f / 3.f);
+			palette[3][c] = (palette[0][c] + palette[1][c] * 2.f) * (1.f / 3.f);
+		}
+	}
+
+	palette[2][3] = 255.f;
+	palette[3][3] = threeColor ? 0.f : 255.f;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		const float* color = palette[(packedIndices >> (i * 2)) & 3];
+
+		for (int c = 0; c < 4; ++c)
+			out[i][c] = (uint8_t)(color[c] + 0.5f);
+	}
+}
+
+static void DecodeSingleChannelBlock(const uint8_t* in, uint8_t (*out)[4], int channel)
+{
+	int a0 = in[0];
+	int a1 = in[1];
+
+	int palette[8] = { a0, a1 };
+	if (a0 > a1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t packed = 0;
+	memcpy(&packed, in, sizeof(uint64_t));
+
+	for (int i = 0; i < 16; ++i)
+		out[i][channel] = (uint8_t)palette[(packed >> (16 + i * 3)) & 7];
+}
+
+//-----------------------------------------------------------------------------
+// purpose: checks whether surfaces in the format can be decoded
+//-----------------------------------------------------------------------------
+bool BCEncoder::IsDecodeSupported(DXGI_FORMAT format)
+{
+	// bc7 is only ever written in one of its modes, so there is no full decoder for it
+	return IsFormatSupported(format) && format != DXGI_FORMAT_BC7_UNORM && format != DXGI_FORMAT_BC7_UNORM_SRGB;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: decodes a surface in the format to rgba8
+//-----------------------------------------------------------------------------
+void BCEncoder::DecodeSurface(const uint8_t* data, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* pixels)
+{
+	if (format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+	{
+		memcpy(pixels, data, (size_t)width * height * 4);
+		return;
+	}
+
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	uint32_t bytesPerBlock = dxutils::GetFormatTraits(format).bytesPerBlock;
+
+	for (uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			const uint8_t* in = data + ((size_t)by * blocksWide + bx) * bytesPerBlock;
+			uint8_t block[16][4];
+
+			switch (format)
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+			case DXGI_FORMAT_BC1_UNORM_SRGB:
+				DecodeColorBlock(in, true, block);
+				break;
+			case DXGI_FORMAT_BC2_UNORM:
+			case DXGI_FORMAT_BC2_UNORM_SRGB:
+				DecodeColorBlock(in + 8, false, block);
+				for (int i = 0; i < 16; ++i)
+					block[i][3] = ((in[i / 2] >> ((i & 1) * 4)) & 0xF) * 17;
+				break;
+			case DXGI_FORMAT_BC3_UNORM:
+			case DXGI_FORMAT_BC3_UNORM_SRGB:
+				DecodeColorBlock(in + 8, false, block);
+				DecodeSingleChannelBlock(in, block, 3);
+				break;
+			case DXGI_FORMAT_BC4_UNORM:
+				DecodeSingleChannelBlock(in, block, 0);
+				for (int i = 0; i < 16; ++i)
+				{
+					block[i][1] = block[i][2] = block[i][0];
+					block[i][3] = 255;
+				}
+				break;
+			case DXGI_FORMAT_BC5_UNORM:
+				DecodeSingleChannelBlock(in, block, 0);
+				DecodeSingleChannelBlock(in + 8, block, 1);
+				for (int i = 0; i < 16; ++i)
+				{
+					block[i][2] = 0;
+					block[i][3] = 255;
+				}
+				break;
+			default:
+				memset(block, 0, sizeof(block));
+				break;
+			}
+
+			// blocks on the right and bottom edges can go past the surface
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				uint32_t x = bx * 4 + (i % 4);
+				uint32_t y = by * 4 + (i / 4);
+
+				if (x < width && y < height)
+					memcpy(pixels + ((size_t)y * width + x) * 4, block[i], 4);
+			}
+		}
+	}
+}
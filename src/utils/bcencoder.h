@@ -0,0 +1,22 @@
+#pragma once
+
+// surfaces with fewer blocks than this per thread are encoded on the calling thread only
+#define BCENCODER_MIN_BLOCKS_PER_THREAD 1024
+
+//
+// cpu block compression of rgba8 images into the formats that textures can use
+//
+namespace BCEncoder
+{
+	bool IsFormatSupported(DXGI_FORMAT format);
+
+	// encodes a whole surface into out, which has to hold dxutils::GetMipSize(format, width, height, 0) bytes
+	// rows of 4x4 blocks are spread over up to numThreads threads
+	void EncodeSurface(const uint8_t* pixels, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* out, int numThreads);
+
+	// whether surfaces in the format can be decoded back to rgba8, so mips can be built for them
+	bool IsDecodeSupported(DXGI_FORMAT format);
+
+	// decodes a whole surface into width * height rgba8 pixels
+	void DecodeSurface(const uint8_t* data, uint32_t width, uint32_t height, DXGI_FORMAT format, uint8_t* pixels);
+};
@@ -17,12 +17,32 @@ enum class BinaryIOMode
 	Write
 };
 
+// backend options for BinaryIO::open
+enum BinaryIOFlags
+{
+	BIO_DEFAULT = 0,
+	BIO_BUFFERED = 1 << 0, // write through FileWriter instead of std::ofstream
+	BIO_DIRECT = 1 << 1, // bypass the system file cache (buffered writes only)
+	BIO_MAPPED = 1 << 2, // read from a mapped view of the file instead of std::ifstream
+};
+
 class BinaryIO
 {
 	// the output file stream to write onto a file
 	std::ofstream writer;
+	// the buffered output backend, used instead of the stream if requested on open
+	FileWriter bufferedWriter;
+	// whether writes go to bufferedWriter
+	bool useBufferedWriter = false;
 	// the input file stream to read from a file
 	std::ifstream reader;
+	// the mapped view of the file, used instead of the stream if requested on open
+	MappedFile mappedReader;
+	// whether reads come from mappedReader
+	bool useMappedReader = false;
+	// read position and end of file state in mappedReader
+	size_t mappedPos = 0;
+	bool mappedEof = false;
 	// the filepath of the file we're working with
 	std::string filePath;
 	// the current active mode.
@@ -51,7 +71,8 @@ public:
 
 	// opens a file with either read or write mode. Returns whether
 	// the open operation was successful
-	bool open(std::string fileFullPath, BinaryIOMode mode)
+	// flags select the backend, see BinaryIOFlags
+	bool open(std::string fileFullPath, BinaryIOMode mode, int flags = BIO_DEFAULT)
 	{
 		filePath = fileFullPath;
 
@@ -63,10 +84,23 @@ public:
 			if (writer.is_open())
 				writer.close();
 
-			writer.open(filePath.c_str(), std::ios::binary);
-			if (!writer.is_open())
+			bufferedWriter.close();
+			useBufferedWriter = flags & BIO_BUFFERED;
+
+			if (useBufferedWriter)
 			{
-				currentMode = BinaryIOMode::None;
+				if (!bufferedWriter.open(filePath, flags & BIO_DIRECT))
+				{
+					currentMode = BinaryIOMode::None;
+				}
+			}
+			else
+			{
+				writer.open(filePath.c_str(), std::ios::binary);
+				if (!writer.is_open())
+				{
+					currentMode = BinaryIOMode::None;
+				}
 			}
 		}
 		// Read mode
@@ -77,10 +111,25 @@ public:
 			if (reader.is_open())
 				reader.close();
 
-			reader.open(filePath.c_str(), std::ios::binary);
-			if (!reader.is_open())
+			mappedReader.close();
+			useMappedReader = flags & BIO_MAPPED;
+			mappedPos = 0;
+			mappedEof = false;
+
+			if (useMappedReader)
 			{
-				currentMode = BinaryIOMode::None;
+				if (!mappedReader.open(filePath))
+				{
+					currentMode = BinaryIOMode::None;
+				}
+			}
+			else
+			{
+				reader.open(filePath.c_str(), std::ios::binary);
+				if (!reader.is_open())
+				{
+					currentMode = BinaryIOMode::None;
+				}
 			}
 		}
 
@@ -88,16 +137,43 @@ public:
 		return currentMode == BinaryIOMode::None ? false : true;
 	}
 
+	// opens an existing file for writing after its first keepSize bytes, the rest of the file
+	// is discarded. only the buffered backend supports this. Returns whether the operation was successful
+	bool openAppend(std::string fileFullPath, uint64_t keepSize, int flags = BIO_BUFFERED)
+	{
+		if (!(flags & BIO_BUFFERED))
+			return false;
+
+		filePath = fileFullPath;
+		currentMode = BinaryIOMode::Write;
+
+		if (writer.is_open())
+			writer.close();
+
+		useBufferedWriter = true;
+
+		if (!bufferedWriter.openAppend(filePath, keepSize, flags & BIO_DIRECT))
+			currentMode = BinaryIOMode::None;
+
+		return currentMode == BinaryIOMode::None ? false : true;
+	}
+
 	// closes the file
 	void close()
 	{
 		if (currentMode == BinaryIOMode::Write)
 		{
-			writer.close();
+			if (useBufferedWriter)
+				bufferedWriter.close();
+			else
+				writer.close();
 		}
 		else if (currentMode == BinaryIOMode::Read)
 		{
-			reader.close();
+			if (useMappedReader)
+				mappedReader.close();
+			else
+				reader.close();
 		}
 	}
 
@@ -120,9 +196,9 @@ public:
 		}
 
 		// check if we hit the end of the file.
-		if (reader.eof())
+		if (eof())
 		{
-			reader.close();
+			close();
 			currentMode = BinaryIOMode::None;
 			return false;
 		}
@@ -133,7 +209,7 @@ public:
 	// so we can check if we hit the end of the file
 	bool eof()
 	{
-		return reader.eof();
+		return useMappedReader ? mappedEof : reader.eof();
 	}
 
 	// Generic write method that will write any value to a file (except a string,
@@ -145,7 +221,75 @@ public:
 			return;
 
 		// write the value to the file.
-		writer.write((const char*)&value, sizeof(value));
+		writeBytes(&value, sizeof(value));
+	}
+
+	// writes raw data to the file
+	void writeBytes(const void* data, size_t size)
+	{
+		if (!checkWritabilityStatus())
+			return;
+
+		if (useBufferedWriter)
+			bufferedWriter.write(data, size);
+		else
+			writer.write((const char*)data, size);
+	}
+
+	// writes all spans back to back, see FileWriter::writeSpans
+	void writeSpans(const std::vector<FileWriteSpan>& spans)
+	{
+		if (!checkWritabilityStatus())
+			return;
+
+		if (useBufferedWriter)
+		{
+			bufferedWriter.writeSpans(spans.data(), spans.size());
+			return;
+		}
+
+		for (auto& it : spans)
+			writer.write((const char*)it.data, it.size);
+	}
+
+	// writes raw data at the specified offset without moving the write position
+	// the range must already have been written
+	void writeAt(size_t off, const void* data, size_t size)
+	{
+		if (!checkWritabilityStatus())
+			return;
+
+		if (useBufferedWriter)
+		{
+			bufferedWriter.writeAt(off, data, size);
+			return;
+		}
+
+		std::streampos pos = writer.tellp();
+		writer.seekp(off, std::ios::beg);
+		writer.write((const char*)data, size);
+		writer.seekp(pos);
+	}
+
+	// reads back raw data that has already been written to the file
+	void readWritten(size_t off, void* data, size_t size)
+	{
+		if (!checkWritabilityStatus())
+			return;
+
+		if (useBufferedWriter)
+		{
+			bufferedWriter.readAt(off, data, size);
+			return;
+		}
+
+		writer.flush();
+
+		std::ifstream input(filePath, std::ios::binary);
+		input.seekg(off, std::ios::beg);
+
+		if (!input.read((char*)data, size))
+			Error("failed to read back %lld bytes at offset %lld from output file '%s'\n", size, off, filePath.c_str());
 	}
 
 	// Writes a string to the file
@@ -164,7 +308,7 @@ public:
 		size_t size = str.size();
 
 		// write the whole string including the null.
-		writer.write((const char*)text, size);
+		writeBytes(text, size);
 	}
 
 	// reads any type of value except strings.
@@ -174,7 +318,7 @@ public:
 		checkReadabilityStatus();
 
 		T value;
-		reader.read((char*)&value, sizeof(value));
+		readBytes(&value, sizeof(value));
 		return value;
 	}
 
@@ -184,18 +328,81 @@ public:
 	{
 		if (checkReadabilityStatus())
 		{
-			reader.read((char*)&value, sizeof(value));
+			readBytes(&value, sizeof(value));
+		}
+	}
+
+	// reads raw data from the file
+	void readBytes(void* data, size_t size)
+	{
+		if (currentMode != BinaryIOMode::Read)
+			return;
+
+		if (!useMappedReader)
+		{
+			reader.read((char*)data, size);
+			return;
+		}
+
+		// mirror ifstream, which reads what's left and then sets eof
+		size_t available = mappedPos < mappedReader.getSize() ? mappedReader.getSize() - mappedPos : 0;
+		if (size > available)
+		{
+			size = available;
+			mappedEof = true;
+		}
+
+		memcpy(data, mappedReader.getData() + mappedPos, size);
+		mappedPos += size;
+	}
+
+	// returns a pointer to a value at the current position in the mapped view and
+	// moves past it, so headers can be parsed in place. nullptr if the file ends before it
+	template <typename T>
+	const T* view()
+	{
+		if (currentMode != BinaryIOMode::Read || !useMappedReader)
+			return nullptr;
+
+		if (mappedPos + sizeof(T) > mappedReader.getSize())
+		{
+			mappedEof = true;
+			return nullptr;
 		}
+
+		const T* value = reinterpret_cast<const T*>(mappedReader.getData() + mappedPos);
+		mappedPos += sizeof(T);
+
+		return value;
+	}
+
+	// the whole mapped view of the file, only available when opened with BIO_MAPPED
+	const uint8_t* getData()
+	{
+		if (currentMode != BinaryIOMode::Read || !useMappedReader)
+			return nullptr;
+
+		return mappedReader.getData();
+	}
+
+	size_t getSize()
+	{
+		if (currentMode != BinaryIOMode::Read || !useMappedReader)
+			return 0;
+
+		return mappedReader.getSize();
 	}
 
+	// not available for mapped reads, use readBytes or getData instead
 	std::ifstream* getReader() {
-		if (currentMode != BinaryIOMode::Read) {
+		if (currentMode != BinaryIOMode::Read || useMappedReader) {
 			return NULL;
 		}
 		return &reader;
 	}
+	// not available for buffered writes, use writeBytes instead
 	std::ofstream* getWriter() {
-		if (currentMode != BinaryIOMode::Write) {
+		if (currentMode != BinaryIOMode::Write || useBufferedWriter) {
 			return NULL;
 		}
 		return &writer;
@@ -208,7 +415,7 @@ public:
 		{
 			char c;
 			std::string result = "";
-			while (!reader.eof() && (c = read<char>()) != '\0')
+			while (!eof() && (c = read<char>()) != '\0')
 			{
 				result += c;
 			}
@@ -225,7 +432,7 @@ public:
 		{
 			char c;
 			result = "";
-			while (!reader.eof() && (c = read<char>()) != '\0')
+			while (!eof() && (c = read<char>()) != '\0')
 			{
 				result += c;
 			}
@@ -237,9 +444,9 @@ public:
 		switch (currentMode)
 		{
 		case BinaryIOMode::Write:
-			return writer.tellp();
+			return useBufferedWriter ? bufferedWriter.tell() : (size_t)writer.tellp();
 		case BinaryIOMode::Read:
-			return reader.tellg();
+			return useMappedReader ? mappedPos : (size_t)reader.tellg();
 		default:
 			return -1;
 		}
@@ -250,10 +457,26 @@ public:
 		switch (currentMode)
 		{
 		case BinaryIOMode::Write:
-			writer.seekp(off, dir);
+			if (!useBufferedWriter)
+				writer.seekp(off, dir);
+			else if (dir == std::ios::beg)
+				bufferedWriter.seek(off);
+			else if (dir == std::ios::cur)
+				bufferedWriter.seek(bufferedWriter.tell() + off);
+			else
+				bufferedWriter.seek(bufferedWriter.getSize() + off);
 			break;
 		case BinaryIOMode::Read:
-			reader.seekg(off, dir);
+			if (!useMappedReader)
+				reader.seekg(off, dir);
+			else if (dir == std::ios::beg)
+				mappedPos = off;
+			else if (dir == std::ios::cur)
+				mappedPos += off;
+			else
+				mappedPos = mappedReader.getSize() + off;
+
+			mappedEof = false;
 			break;
 		default:
 			break;
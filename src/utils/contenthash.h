@@ -0,0 +1,133 @@
+#pragma once
+
+// 128 bit hash of a piece of data, used to find identical data
+struct ContentHash
+{
+	uint64_t lo = 0;
+	uint64_t hi = 0;
+
+	inline bool operator==(const ContentHash& other) const { return lo == other.lo && hi == other.hi; };
+	inline bool operator!=(const ContentHash& other) const { return !(*this == other); };
+};
+
+struct ContentHashHasher
+{
+	inline size_t operator()(const ContentHash& hash) const { return (size_t)hash.lo; };
+};
+
+//
+// incremental murmurhash3 (x64, 128 bit)
+// data can be fed in pieces of any size, the result is the same as hashing it in one go
+//
+class ContentHasher
+{
+	uint64_t h1 = 0;
+	uint64_t h2 = 0;
+
+	// bytes that didn't fill a whole 16 byte block yet
+	uint8_t tail[16]{};
+	size_t tailSize = 0;
+
+	uint64_t length = 0;
+
+	static inline uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	static inline uint64_t fmix(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+
+		return k;
+	}
+
+	static constexpr uint64_t c1 = 0x87c37b91114253d5ULL;
+	static constexpr uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	inline void block(const uint8_t* data)
+	{
+		uint64_t k1;
+		uint64_t k2;
+		memcpy(&k1, data, sizeof(k1));
+		memcpy(&k2, data + 8, sizeof(k2));
+
+		k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+public:
+	void update(const void* data, size_t size)
+	{
+		const uint8_t* p = (const uint8_t*)data;
+		length += size;
+
+		if (tailSize > 0)
+		{
+			size_t count = 16 - tailSize < size ? 16 - tailSize : size;
+			memcpy(tail + tailSize, p, count);
+
+			tailSize += count;
+			p += count;
+			size -= count;
+
+			if (tailSize < 16)
+				return;
+
+			block(tail);
+			tailSize = 0;
+		}
+
+		for (; size >= 16; p += 16, size -= 16)
+			block(p);
+
+		memcpy(tail, p, size);
+		tailSize = size;
+	}
+
+	ContentHash finish() const
+	{
+		uint64_t f1 = h1;
+		uint64_t f2 = h2;
+
+		uint64_t k1 = 0;
+		uint64_t k2 = 0;
+
+		for (size_t i = tailSize; i > 8; --i)
+			k2 = (k2 << 8) | tail[i - 1];
+
+		for (size_t i = tailSize < 8 ? tailSize : 8; i > 0; --i)
+			k1 = (k1 << 8) | tail[i - 1];
+
+		if (tailSize > 8)
+		{
+			k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; f2 ^= k2;
+		}
+
+		if (tailSize > 0)
+		{
+			k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; f1 ^= k1;
+		}
+
+		f1 ^= length;
+		f2 ^= length;
+
+		f1 += f2;
+		f2 += f1;
+
+		f1 = fmix(f1);
+		f2 = fmix(f2);
+
+		f1 += f2;
+		f2 += f1;
+
+		return { f1, f2 };
+	}
+};
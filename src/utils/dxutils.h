@@ -1,134 +1,162 @@
 #pragma once
 
 #include <d3d11.h>
-#include <map>
+#include <array>
 #include <string>
 
-static std::map<DXGI_FORMAT, std::string> _dxgi_to_string = {
-	{DXGI_FORMAT_UNKNOWN, "DXGI_FORMAT_UNKNOWN"},
-	{DXGI_FORMAT_R32G32B32A32_TYPELESS, "DXGI_FORMAT_R32G32B32A32_TYPELESS"},
-	{DXGI_FORMAT_R32G32B32A32_FLOAT, "DXGI_FORMAT_R32G32B32A32_FLOAT"},
-	{DXGI_FORMAT_R32G32B32A32_UINT, "DXGI_FORMAT_R32G32B32A32_UINT"},
-	{DXGI_FORMAT_R32G32B32A32_SINT, "DXGI_FORMAT_R32G32B32A32_SINT"},
-	{DXGI_FORMAT_R32G32B32_TYPELESS, "DXGI_FORMAT_R32G32B32_TYPELESS"},
-	{DXGI_FORMAT_R32G32B32_FLOAT, "DXGI_FORMAT_R32G32B32_FLOAT"},
-	{DXGI_FORMAT_R32G32B32_UINT, "DXGI_FORMAT_R32G32B32_UINT"},
-	{DXGI_FORMAT_R32G32B32_SINT, "DXGI_FORMAT_R32G32B32_SINT"},
-	{DXGI_FORMAT_R16G16B16A16_TYPELESS, "DXGI_FORMAT_R16G16B16A16_TYPELESS"},
-	{DXGI_FORMAT_R16G16B16A16_FLOAT, "DXGI_FORMAT_R16G16B16A16_FLOAT"},
-	{DXGI_FORMAT_R16G16B16A16_UNORM, "DXGI_FORMAT_R16G16B16A16_UNORM"},
-	{DXGI_FORMAT_R16G16B16A16_UINT, "DXGI_FORMAT_R16G16B16A16_UINT"},
-	{DXGI_FORMAT_R16G16B16A16_SNORM, "DXGI_FORMAT_R16G16B16A16_SNORM"},
-	{DXGI_FORMAT_R16G16B16A16_SINT, "DXGI_FORMAT_R16G16B16A16_SINT"},
-	{DXGI_FORMAT_R32G32_TYPELESS, "DXGI_FORMAT_R32G32_TYPELESS"},
-	{DXGI_FORMAT_R32G32_FLOAT, "DXGI_FORMAT_R32G32_FLOAT"},
-	{DXGI_FORMAT_R32G32_UINT, "DXGI_FORMAT_R32G32_UINT"},
-	{DXGI_FORMAT_R32G32_SINT, "DXGI_FORMAT_R32G32_SINT"},
-	{DXGI_FORMAT_R32G8X24_TYPELESS, "DXGI_FORMAT_R32G8X24_TYPELESS"},
-	{DXGI_FORMAT_D32_FLOAT_S8X24_UINT, "DXGI_FORMAT_D32_FLOAT_S8X24_UINT"},
-	{DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS, "DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS"},
-	{DXGI_FORMAT_X32_TYPELESS_G8X24_UINT, "DXGI_FORMAT_X32_TYPELESS_G8X24_UINT"},
-	{DXGI_FORMAT_R10G10B10A2_TYPELESS, "DXGI_FORMAT_R10G10B10A2_TYPELESS"},
-	{DXGI_FORMAT_R10G10B10A2_UNORM, "DXGI_FORMAT_R10G10B10A2_UNORM"},
-	{DXGI_FORMAT_R10G10B10A2_UINT, "DXGI_FORMAT_R10G10B10A2_UINT"},
-	{DXGI_FORMAT_R11G11B10_FLOAT, "DXGI_FORMAT_R11G11B10_FLOAT"},
-	{DXGI_FORMAT_R8G8B8A8_TYPELESS, "DXGI_FORMAT_R8G8B8A8_TYPELESS"},
-	{DXGI_FORMAT_R8G8B8A8_UNORM, "DXGI_FORMAT_R8G8B8A8_UNORM"},
-	{DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, "DXGI_FORMAT_R8G8B8A8_UNORM_SRGB"},
-	{DXGI_FORMAT_R8G8B8A8_UINT, "DXGI_FORMAT_R8G8B8A8_UINT"},
-	{DXGI_FORMAT_R8G8B8A8_SNORM, "DXGI_FORMAT_R8G8B8A8_SNORM"},
-	{DXGI_FORMAT_R8G8B8A8_SINT, "DXGI_FORMAT_R8G8B8A8_SINT"},
-	{DXGI_FORMAT_R16G16_TYPELESS, "DXGI_FORMAT_R16G16_TYPELESS"},
-	{DXGI_FORMAT_R16G16_FLOAT, "DXGI_FORMAT_R16G16_FLOAT"},
-	{DXGI_FORMAT_R16G16_UNORM, "DXGI_FORMAT_R16G16_UNORM"},
-	{DXGI_FORMAT_R16G16_UINT, "DXGI_FORMAT_R16G16_UINT"},
-	{DXGI_FORMAT_R16G16_SNORM, "DXGI_FORMAT_R16G16_SNORM"},
-	{DXGI_FORMAT_R16G16_SINT, "DXGI_FORMAT_R16G16_SINT"},
-	{DXGI_FORMAT_R32_TYPELESS, "DXGI_FORMAT_R32_TYPELESS"},
-	{DXGI_FORMAT_D32_FLOAT, "DXGI_FORMAT_D32_FLOAT"},
-	{DXGI_FORMAT_R32_FLOAT, "DXGI_FORMAT_R32_FLOAT"},
-	{DXGI_FORMAT_R32_UINT, "DXGI_FORMAT_R32_UINT"},
-	{DXGI_FORMAT_R32_SINT, "DXGI_FORMAT_R32_SINT"},
-	{DXGI_FORMAT_R24G8_TYPELESS, "DXGI_FORMAT_R24G8_TYPELESS"},
-	{DXGI_FORMAT_D24_UNORM_S8_UINT, "DXGI_FORMAT_D24_UNORM_S8_UINT"},
-	{DXGI_FORMAT_R24_UNORM_X8_TYPELESS, "DXGI_FORMAT_R24_UNORM_X8_TYPELESS"},
-	{DXGI_FORMAT_X24_TYPELESS_G8_UINT, "DXGI_FORMAT_X24_TYPELESS_G8_UINT"},
-	{DXGI_FORMAT_R8G8_TYPELESS, "DXGI_FORMAT_R8G8_TYPELESS"},
-	{DXGI_FORMAT_R8G8_UNORM, "DXGI_FORMAT_R8G8_UNORM"},
-	{DXGI_FORMAT_R8G8_UINT, "DXGI_FORMAT_R8G8_UINT"},
-	{DXGI_FORMAT_R8G8_SNORM, "DXGI_FORMAT_R8G8_SNORM"},
-	{DXGI_FORMAT_R8G8_SINT, "DXGI_FORMAT_R8G8_SINT"},
-	{DXGI_FORMAT_R16_TYPELESS, "DXGI_FORMAT_R16_TYPELESS"},
-	{DXGI_FORMAT_R16_FLOAT, "DXGI_FORMAT_R16_FLOAT"},
-	{DXGI_FORMAT_D16_UNORM, "DXGI_FORMAT_D16_UNORM"},
-	{DXGI_FORMAT_R16_UNORM, "DXGI_FORMAT_R16_UNORM"},
-	{DXGI_FORMAT_R16_UINT, "DXGI_FORMAT_R16_UINT"},
-	{DXGI_FORMAT_R16_SNORM, "DXGI_FORMAT_R16_SNORM"},
-	{DXGI_FORMAT_R16_SINT, "DXGI_FORMAT_R16_SINT"},
-	{DXGI_FORMAT_R8_TYPELESS, "DXGI_FORMAT_R8_TYPELESS"},
-	{DXGI_FORMAT_R8_UNORM, "DXGI_FORMAT_R8_UNORM"},
-	{DXGI_FORMAT_R8_UINT, "DXGI_FORMAT_R8_UINT"},
-	{DXGI_FORMAT_R8_SNORM, "DXGI_FORMAT_R8_SNORM"},
-	{DXGI_FORMAT_R8_SINT, "DXGI_FORMAT_R8_SINT"},
-	{DXGI_FORMAT_A8_UNORM, "DXGI_FORMAT_A8_UNORM"},
-	{DXGI_FORMAT_R1_UNORM, "DXGI_FORMAT_R1_UNORM"},
-	{DXGI_FORMAT_R9G9B9E5_SHAREDEXP, "DXGI_FORMAT_R9G9B9E5_SHAREDEXP"},
-	{DXGI_FORMAT_R8G8_B8G8_UNORM, "DXGI_FORMAT_R8G8_B8G8_UNORM"},
-	{DXGI_FORMAT_G8R8_G8B8_UNORM, "DXGI_FORMAT_G8R8_G8B8_UNORM"},
-	{DXGI_FORMAT_BC1_TYPELESS, "DXGI_FORMAT_BC1_TYPELESS"},
-	{DXGI_FORMAT_BC1_UNORM, "DXGI_FORMAT_BC1_UNORM"},
-	{DXGI_FORMAT_BC1_UNORM_SRGB, "DXGI_FORMAT_BC1_UNORM_SRGB"},
-	{DXGI_FORMAT_BC2_TYPELESS, "DXGI_FORMAT_BC2_TYPELESS"},
-	{DXGI_FORMAT_BC2_UNORM, "DXGI_FORMAT_BC2_UNORM"},
-	{DXGI_FORMAT_BC2_UNORM_SRGB, "DXGI_FORMAT_BC2_UNORM_SRGB"},
-	{DXGI_FORMAT_BC3_TYPELESS, "DXGI_FORMAT_BC3_TYPELESS"},
-	{DXGI_FORMAT_BC3_UNORM, "DXGI_FORMAT_BC3_UNORM"},
-	{DXGI_FORMAT_BC3_UNORM_SRGB, "DXGI_FORMAT_BC3_UNORM_SRGB"},
-	{DXGI_FORMAT_BC4_TYPELESS, "DXGI_FORMAT_BC4_TYPELESS"},
-	{DXGI_FORMAT_BC4_UNORM, "DXGI_FORMAT_BC4_UNORM"},
-	{DXGI_FORMAT_BC4_SNORM, "DXGI_FORMAT_BC4_SNORM"},
-	{DXGI_FORMAT_BC5_TYPELESS, "DXGI_FORMAT_BC5_TYPELESS"},
-	{DXGI_FORMAT_BC5_UNORM, "DXGI_FORMAT_BC5_UNORM"},
-	{DXGI_FORMAT_BC5_SNORM, "DXGI_FORMAT_BC5_SNORM"},
-	{DXGI_FORMAT_B5G6R5_UNORM, "DXGI_FORMAT_B5G6R5_UNORM"},
-	{DXGI_FORMAT_B5G5R5A1_UNORM, "DXGI_FORMAT_B5G5R5A1_UNORM"},
-	{DXGI_FORMAT_B8G8R8A8_UNORM, "DXGI_FORMAT_B8G8R8A8_UNORM"},
-	{DXGI_FORMAT_B8G8R8X8_UNORM, "DXGI_FORMAT_B8G8R8X8_UNORM"},
-	{DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM, "DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM"},
-	{DXGI_FORMAT_B8G8R8A8_TYPELESS, "DXGI_FORMAT_B8G8R8A8_TYPELESS"},
-	{DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, "DXGI_FORMAT_B8G8R8A8_UNORM_SRGB"},
-	{DXGI_FORMAT_B8G8R8X8_TYPELESS, "DXGI_FORMAT_B8G8R8X8_TYPELESS"},
-	{DXGI_FORMAT_B8G8R8X8_UNORM_SRGB, "DXGI_FORMAT_B8G8R8X8_UNORM_SRGB"},
-	{DXGI_FORMAT_BC6H_TYPELESS, "DXGI_FORMAT_BC6H_TYPELESS"},
-	{DXGI_FORMAT_BC6H_UF16, "DXGI_FORMAT_BC6H_UF16"},
-	{DXGI_FORMAT_BC6H_SF16, "DXGI_FORMAT_BC6H_SF16"},
-	{DXGI_FORMAT_BC7_TYPELESS, "DXGI_FORMAT_BC7_TYPELESS"},
-	{DXGI_FORMAT_BC7_UNORM, "DXGI_FORMAT_BC7_UNORM"},
-	{DXGI_FORMAT_BC7_UNORM_SRGB, "DXGI_FORMAT_BC7_UNORM_SRGB"},
-	{DXGI_FORMAT_AYUV, "DXGI_FORMAT_AYUV"},
-	{DXGI_FORMAT_Y410, "DXGI_FORMAT_Y410"},
-	{DXGI_FORMAT_Y416, "DXGI_FORMAT_Y416"},
-	{DXGI_FORMAT_NV12, "DXGI_FORMAT_NV12"},
-	{DXGI_FORMAT_P010, "DXGI_FORMAT_P010"},
-	{DXGI_FORMAT_P016, "DXGI_FORMAT_P016"},
-	{DXGI_FORMAT_420_OPAQUE, "DXGI_FORMAT_420_OPAQUE"},
-	{DXGI_FORMAT_YUY2, "DXGI_FORMAT_YUY2"},
-	{DXGI_FORMAT_Y210, "DXGI_FORMAT_Y210"},
-	{DXGI_FORMAT_Y216, "DXGI_FORMAT_Y216"},
-	{DXGI_FORMAT_NV11, "DXGI_FORMAT_NV11"},
-	{DXGI_FORMAT_AI44, "DXGI_FORMAT_AI44"},
-	{DXGI_FORMAT_IA44, "DXGI_FORMAT_IA44"},
-	{DXGI_FORMAT_P8, "DXGI_FORMAT_P8"},
-	{DXGI_FORMAT_A8P8, "DXGI_FORMAT_A8P8"},
-	{DXGI_FORMAT_B4G4R4A4_UNORM, "DXGI_FORMAT_B4G4R4A4_UNORM"},
-	{DXGI_FORMAT_P208, "DXGI_FORMAT_P208"},
-	{DXGI_FORMAT_V208, "DXGI_FORMAT_V208"},
-	{DXGI_FORMAT_V408, "DXGI_FORMAT_V408"},
-	{DXGI_FORMAT_SAMPLER_FEEDBACK_MIN_MIP_OPAQUE, "DXGI_FORMAT_SAMPLER_FEEDBACK_MIN_MIP_OPAQUE"},
-	{DXGI_FORMAT_SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE, "DXGI_FORMAT_SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE"},
-	{DXGI_FORMAT_FORCE_UINT, "DXGI_FORMAT_FORCE_UINT"},
+// number of entries in the dxgi format tables, the formats after DXGI_FORMAT_V408 are not texture formats
+#define DXGI_FORMAT_TABLE_SIZE (DXGI_FORMAT_V408 + 1)
+
+// properties of a dxgi format
+struct DXGIFormatTraits
+{
+	const char* name = nullptr;
+	uint8_t blockWidth = 0; // pixels per block, 1 for formats that aren't block based
+	uint8_t blockHeight = 0;
+	uint8_t bytesPerBlock = 0; // bytes per pixel for formats that aren't block based
+	uint8_t bitsPerPixel = 0;
+
+	// whether the size of the format's data is known
+	constexpr bool HasSize() const { return blockWidth != 0; };
 };
 
+#define DXGI_TRAITS_NAME(fmt) table[fmt] = { #fmt }
+#define DXGI_TRAITS_PIXEL(fmt, bpp) table[fmt] = { #fmt, 1, 1, (bpp) / 8, bpp }
+#define DXGI_TRAITS_BLOCK(fmt, w, h, bytes) table[fmt] = { #fmt, w, h, bytes, (bytes) * 8 / ((w) * (h)) }
+
+// traits of every dxgi format, indexed by DXGI_FORMAT
+// planar video formats have a name but no size, they can't be used for textures
+static constexpr std::array<DXGIFormatTraits, DXGI_FORMAT_TABLE_SIZE> s_dxgiFormatTraits = []() constexpr
+{
+	std::array<DXGIFormatTraits, DXGI_FORMAT_TABLE_SIZE> table{};
+
+	DXGI_TRAITS_NAME(DXGI_FORMAT_UNKNOWN);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32A32_TYPELESS, 128);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32A32_FLOAT, 128);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32A32_UINT, 128);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32A32_SINT, 128);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32_TYPELESS, 96);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32_FLOAT, 96);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32_UINT, 96);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32B32_SINT, 96);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_TYPELESS, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_FLOAT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_UNORM, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_UINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_SNORM, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16B16A16_SINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32_TYPELESS, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32_FLOAT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32_UINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G32_SINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32G8X24_TYPELESS, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_D32_FLOAT_S8X24_UINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_X32_TYPELESS_G8X24_UINT, 64);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R10G10B10A2_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R10G10B10A2_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R10G10B10A2_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R11G11B10_FLOAT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_SNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8B8A8_SINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_FLOAT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_SNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16G16_SINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_D32_FLOAT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32_FLOAT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R32_SINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R24G8_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_D24_UNORM_S8_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R24_UNORM_X8_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_X24_TYPELESS_G8_UINT, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8_TYPELESS, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8_UNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8_UINT, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8_SNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8G8_SINT, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_TYPELESS, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_FLOAT, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_D16_UNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_UNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_UINT, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_SNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R16_SINT, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8_TYPELESS, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8_UNORM, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8_UINT, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8_SNORM, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R8_SINT, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_A8_UNORM, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R1_UNORM, 1);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R9G9B9E5_SHAREDEXP, 32);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_R8G8_B8G8_UNORM, 2, 1, 4);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_G8R8_G8B8_UNORM, 2, 1, 4);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC1_TYPELESS, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC1_UNORM, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC1_UNORM_SRGB, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC2_TYPELESS, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC2_UNORM, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC2_UNORM_SRGB, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC3_TYPELESS, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC3_UNORM, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC3_UNORM_SRGB, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC4_TYPELESS, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC4_UNORM, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC4_SNORM, 4, 4, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC5_TYPELESS, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC5_UNORM, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC5_SNORM, 4, 4, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B5G6R5_UNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B5G5R5A1_UNORM, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8A8_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8X8_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8A8_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8X8_TYPELESS, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B8G8R8X8_UNORM_SRGB, 32);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC6H_TYPELESS, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC6H_UF16, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC6H_SF16, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC7_TYPELESS, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC7_UNORM, 4, 4, 16);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_BC7_UNORM_SRGB, 4, 4, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_AYUV, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_Y410, 32);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_Y416, 64);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_NV12);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_P010);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_P016);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_420_OPAQUE);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_YUY2, 2, 1, 4);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_Y210, 2, 1, 8);
+	DXGI_TRAITS_BLOCK(DXGI_FORMAT_Y216, 2, 1, 8);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_NV11);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_AI44, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_IA44, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_P8, 8);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_A8P8, 16);
+	DXGI_TRAITS_PIXEL(DXGI_FORMAT_B4G4R4A4_UNORM, 16);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_P208);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_V208);
+	DXGI_TRAITS_NAME(DXGI_FORMAT_V408);
+
+	return table;
+}();
+
+#undef DXGI_TRAITS_NAME
+#undef DXGI_TRAITS_PIXEL
+#undef DXGI_TRAITS_BLOCK
+
 struct DDS_PIXELFORMAT {
 	DWORD dwSize;
 	DWORD dwFlags;
@@ -184,7 +212,57 @@ class dxutils
 public:
 	static std::string GetFormatAsString(DXGI_FORMAT fmt)
 	{
-		return _dxgi_to_string[fmt];
+		if (fmt >= DXGI_FORMAT_TABLE_SIZE || !s_dxgiFormatTraits[fmt].name)
+			return "DXGI_FORMAT_" + std::to_string(fmt);
+
+		return s_dxgiFormatTraits[fmt].name;
+	}
+
+	// looks up a format by name, the "DXGI_FORMAT_" prefix is optional
+	// returns DXGI_FORMAT_UNKNOWN if there is no format with that name
+	static DXGI_FORMAT GetFormatFromString(const std::string& name)
+	{
+		for (int i = 0; i < DXGI_FORMAT_TABLE_SIZE; ++i)
+		{
+			const char* fmtName = s_dxgiFormatTraits[i].name;
+
+			if (fmtName && (name == fmtName || "DXGI_FORMAT_" + name == fmtName))
+				return (DXGI_FORMAT)i;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	// whether the format stores colors in srgb space
+	static bool IsFormatSRGB(DXGI_FORMAT fmt)
+	{
+		return GetFormatAsString(fmt).find("_SRGB") != std::string::npos;
+	}
+
+	static constexpr const DXGIFormatTraits& GetFormatTraits(DXGI_FORMAT fmt)
+	{
+		return s_dxgiFormatTraits[fmt < DXGI_FORMAT_TABLE_SIZE ? fmt : DXGI_FORMAT_UNKNOWN];
+	}
+
+	// size of a single mip level in bytes, 0 if the format has no known size
+	static constexpr uint32_t GetMipSize(DXGI_FORMAT fmt, uint32_t width, uint32_t height, uint32_t mipLevel)
+	{
+		const DXGIFormatTraits& traits = GetFormatTraits(fmt);
+
+		if (!traits.HasSize())
+			return 0;
+
+		uint32_t mipWidth = (width >> mipLevel) > 1 ? (width >> mipLevel) : 1;
+		uint32_t mipHeight = (height >> mipLevel) > 1 ? (height >> mipLevel) : 1;
+
+		// pixel formats may have less than 8 bits per pixel, so rows are rounded up to whole bytes
+		if (traits.blockWidth == 1 && traits.blockHeight == 1)
+			return ((mipWidth * traits.bitsPerPixel + 7) / 8) * mipHeight;
+
+		uint32_t blocksWide = (mipWidth + traits.blockWidth - 1) / traits.blockWidth;
+		uint32_t blocksHigh = (mipHeight + traits.blockHeight - 1) / traits.blockHeight;
+
+		return blocksWide * blocksHigh * traits.bytesPerBlock;
 	}
 
 	static DXGI_FORMAT GetFormatFromHeader(DDS_HEADER hdr)
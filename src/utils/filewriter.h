@@ -0,0 +1,411 @@
+#pragma once
+
+// alignment of file offsets, sizes and buffers for unbuffered (direct) io
+// 4096 covers both 512 byte and 4k sector drives
+#define FILEWRITER_SECTOR_SIZE 4096
+
+// default size of the user-space write buffer
+#define FILEWRITER_BUFFER_SIZE (8 * 1024 * 1024)
+
+// piece of memory to be written by FileWriter::writeSpans
+struct FileWriteSpan
+{
+	const void* data;
+	uint64_t size;
+};
+
+//
+// buffered output file backend for BinaryIO
+// small writes are collected in a large buffer, large writes go straight to the file,
+// and writes to parts of the file that have already been flushed are done at their
+// offset without moving the end of the file (see writeAt)
+//
+class FileWriter
+{
+	// handle of the output file
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	// whether the file was opened with FILE_FLAG_NO_BUFFERING
+	bool directIO = false;
+
+	// user-space write buffer, sector aligned
+	uint8_t* buffer = nullptr;
+	uint64_t bufferSize = 0;
+	uint64_t bufferUsed = 0;
+
+	// file offset at which the buffer starts
+	uint64_t fileOffset = 0;
+	// position that the next write goes to, see seek
+	uint64_t position = 0;
+
+	// positional writes into the flushed part of the file are collected here
+	// so a field-by-field rewrite (e.g. of a header) becomes a single write
+	std::vector<uint8_t> patch;
+	uint64_t patchOffset = 0;
+
+public:
+	FileWriter() = default;
+	FileWriter(const FileWriter&) = delete;
+	FileWriter& operator=(const FileWriter&) = delete;
+
+	~FileWriter()
+	{
+		close();
+	}
+
+	// creates the file at the given path. Returns whether the operation was successful
+	bool open(const std::string& fileFullPath, bool unbuffered = false, uint64_t size = FILEWRITER_BUFFER_SIZE)
+	{
+		return openFile(fileFullPath, CREATE_ALWAYS, unbuffered, size);
+	}
+
+	// opens an existing file and keeps its first keepSize bytes, anything after them is discarded
+	// writes continue at keepSize, which has to be sector aligned in direct mode
+	// Returns whether the operation was successful
+	bool openAppend(const std::string& fileFullPath, uint64_t keepSize, bool unbuffered = false, uint64_t size = FILEWRITER_BUFFER_SIZE)
+	{
+		if (unbuffered && keepSize % FILEWRITER_SECTOR_SIZE != 0)
+			return false;
+
+		if (!openFile(fileFullPath, OPEN_EXISTING, unbuffered, size))
+			return false;
+
+		LARGE_INTEGER end;
+		end.QuadPart = keepSize;
+
+		if (!SetFilePointerEx(fileHandle, end, NULL, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+		{
+			close();
+			return false;
+		}
+
+		fileOffset = keepSize;
+		position = keepSize;
+
+		return true;
+	}
+
+
+	// flushes all pending data and closes the file
+	void close()
+	{
+		if (fileHandle != INVALID_HANDLE_VALUE)
+		{
+			uint64_t size = getSize();
+
+			flushPatch();
+
+			if (directIO && bufferUsed % FILEWRITER_SECTOR_SIZE != 0)
+			{
+				// unbuffered writes have to be whole sectors, so the file is cut back to size afterwards
+				uint64_t alignedUsed = alignToSector(bufferUsed);
+				memset(buffer + bufferUsed, 0, alignedUsed - bufferUsed);
+
+				writeFileAt(fileOffset, buffer, alignedUsed);
+
+				LARGE_INTEGER end;
+				end.QuadPart = size;
+
+				SetFilePointerEx(fileHandle, end, NULL, FILE_BEGIN);
+				SetEndOfFile(fileHandle);
+			}
+			else
+			{
+				writeFileAt(fileOffset, buffer, bufferUsed);
+			}
+
+			CloseHandle(fileHandle);
+		}
+
+		if (buffer)
+			_aligned_free(buffer);
+
+		fileHandle = INVALID_HANDLE_VALUE;
+		directIO = false;
+		buffer = nullptr;
+		bufferSize = 0;
+		bufferUsed = 0;
+		fileOffset = 0;
+		position = 0;
+		patch.clear();
+		patchOffset = 0;
+	}
+
+	bool isOpen() const
+	{
+		return fileHandle != INVALID_HANDLE_VALUE;
+	}
+
+	// total amount of bytes written to the file so far
+	uint64_t getSize() const
+	{
+		return fileOffset + bufferUsed;
+	}
+
+	uint64_t tell() const
+	{
+		return position;
+	}
+
+	// moves the write position. seeking back into the written data makes the
+	// following writes overwrite it in place until the end of the file is reached
+	void seek(uint64_t off)
+	{
+		position = off < getSize() ? off : getSize();
+	}
+
+	// writes data at the current position
+	void write(const void* data, uint64_t size)
+	{
+		const uint8_t* src = (const uint8_t*)data;
+
+		// overwrite what has already been written before appending the rest
+		if (position < getSize())
+		{
+			uint64_t overwriteSize = getSize() - position;
+			if (overwriteSize > size)
+				overwriteSize = size;
+
+			writeAt(position, src, overwriteSize);
+
+			position += overwriteSize;
+			src += overwriteSize;
+			size -= overwriteSize;
+		}
+
+		if (size == 0)
+			return;
+
+		append(src, size);
+		position = getSize();
+	}
+
+	// writes all spans back to back at the current position, one write per span
+	// spans go through the buffer like any other write, so only the large ones reach the file on their own
+	void writeSpans(const FileWriteSpan* spans, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			write(spans[i].data, spans[i].size);
+	}
+
+	// writes data at the specified offset without moving the write position
+	// the range must not go past the data that has been written so far
+	void writeAt(uint64_t offset, const void* data, uint64_t size)
+	{
+		const uint8_t* src = (const uint8_t*)data;
+
+		// part of the range that has already left the buffer
+		if (offset < fileOffset)
+		{
+			uint64_t flushedSize = fileOffset - offset;
+			if (flushedSize > size)
+				flushedSize = size;
+
+			addPatch(offset, src, flushedSize);
+
+			offset += flushedSize;
+			src += flushedSize;
+			size -= flushedSize;
+		}
+
+		// part of the range that is still in the buffer
+		if (size > 0)
+			memcpy(buffer + (offset - fileOffset), src, size);
+	}
+
+	// reads back data that has been written so far, from the file or from the buffer
+	// the range must not go past the data that has been written so far
+	void readAt(uint64_t offset, void* data, uint64_t size)
+	{
+		uint8_t* dst = (uint8_t*)data;
+
+		flushPatch();
+
+		// part of the range that has already left the buffer
+		if (offset < fileOffset)
+		{
+			uint64_t flushedSize = fileOffset - offset;
+			if (flushedSize > size)
+				flushedSize = size;
+
+			if (directIO)
+			{
+				// unbuffered reads have to be whole sectors, everything before fileOffset is
+				uint64_t start = offset - (offset % FILEWRITER_SECTOR_SIZE);
+				uint64_t end = alignToSector(offset + flushedSize);
+
+				uint8_t* sectors = (uint8_t*)_aligned_malloc(end - start, FILEWRITER_SECTOR_SIZE);
+
+				readFileAt(start, sectors, end - start);
+				memcpy(dst, sectors + (offset - start), flushedSize);
+
+				_aligned_free(sectors);
+			}
+			else
+			{
+				readFileAt(offset, dst, flushedSize);
+			}
+
+			offset += flushedSize;
+			dst += flushedSize;
+			size -= flushedSize;
+		}
+
+		// part of the range that is still in the buffer
+		if (size > 0)
+			memcpy(dst, buffer + (offset - fileOffset), size);
+	}
+
+private:
+	bool openFile(const std::string& fileFullPath, DWORD disposition, bool unbuffered, uint64_t size)
+	{
+		close();
+
+		DWORD flags = unbuffered ? (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH) : FILE_FLAG_SEQUENTIAL_SCAN;
+
+		// read access is needed to patch partial sectors in direct mode
+		fileHandle = CreateFileA(fileFullPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, disposition, FILE_ATTRIBUTE_NORMAL | flags, NULL);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		directIO = unbuffered;
+
+		bufferSize = alignToSector(size);
+		buffer = (uint8_t*)_aligned_malloc(bufferSize, FILEWRITER_SECTOR_SIZE);
+
+		if (!buffer)
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	static uint64_t alignToSector(uint64_t size)
+	{
+		return (size + FILEWRITER_SECTOR_SIZE - 1) & ~(uint64_t)(FILEWRITER_SECTOR_SIZE - 1);
+	}
+
+	// appends data to the end of the file
+	void append(const uint8_t* src, uint64_t size)
+	{
+		// blocks that would not fit into an empty buffer skip it entirely
+		if (!directIO && size >= bufferSize)
+		{
+			flushBuffer();
+			writeFileAt(fileOffset, src, size);
+			fileOffset += size;
+			return;
+		}
+
+		while (size > 0)
+		{
+			uint64_t chunkSize = bufferSize - bufferUsed;
+			if (chunkSize > size)
+				chunkSize = size;
+
+			memcpy(buffer + bufferUsed, src, chunkSize);
+			bufferUsed += chunkSize;
+			src += chunkSize;
+			size -= chunkSize;
+
+			if (bufferUsed == bufferSize)
+				flushBuffer();
+		}
+	}
+
+	// writes out the buffer. in direct mode only whole sectors are written,
+	// the remainder is moved to the front of the buffer
+	void flushBuffer()
+	{
+		uint64_t flushSize = bufferUsed;
+
+		if (directIO)
+			flushSize -= bufferUsed % FILEWRITER_SECTOR_SIZE;
+
+		if (flushSize == 0)
+			return;
+
+		writeFileAt(fileOffset, buffer, flushSize);
+
+		memmove(buffer, buffer + flushSize, bufferUsed - flushSize);
+		bufferUsed -= flushSize;
+		fileOffset += flushSize;
+	}
+
+	// collects a positional write into the pending patch, flushing it first if it isn't contiguous
+	void addPatch(uint64_t offset, const uint8_t* src, uint64_t size)
+	{
+		if (!patch.empty() && offset != patchOffset + patch.size())
+			flushPatch();
+
+		if (patch.empty())
+			patchOffset = offset;
+
+		patch.insert(patch.end(), src, src + size);
+	}
+
+	// writes the pending patch to the file
+	void flushPatch()
+	{
+		if (patch.empty())
+			return;
+
+		if (directIO)
+		{
+			// read-modify-write the sectors that the patch touches. everything before
+			// fileOffset has been flushed in whole sectors, so they can always be read back
+			uint64_t start = patchOffset - (patchOffset % FILEWRITER_SECTOR_SIZE);
+			uint64_t end = alignToSector(patchOffset + patch.size());
+
+			uint8_t* sectors = (uint8_t*)_aligned_malloc(end - start, FILEWRITER_SECTOR_SIZE);
+
+			readFileAt(start, sectors, end - start);
+			memcpy(sectors + (patchOffset - start), patch.data(), patch.size());
+			writeFileAt(start, sectors, end - start);
+
+			_aligned_free(sectors);
+		}
+		else
+		{
+			writeFileAt(patchOffset, patch.data(), patch.size());
+		}
+
+		patch.clear();
+	}
+
+	void writeFileAt(uint64_t offset, const void* data, uint64_t size)
+	{
+		const uint8_t* src = (const uint8_t*)data;
+
+		while (size > 0)
+		{
+			// WriteFile takes 32 bit sizes, keep chunks sector aligned for direct io
+			DWORD chunkSize = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+
+			OVERLAPPED ov{};
+			ov.Offset = (DWORD)offset;
+			ov.OffsetHigh = (DWORD)(offset >> 32);
+
+			DWORD written = 0;
+			if (!WriteFile(fileHandle, src, chunkSize, &written, &ov) || written != chunkSize)
+				Error("failed to write %u bytes at offset %lld to output file\n", chunkSize, offset);
+
+			offset += chunkSize;
+			src += chunkSize;
+			size -= chunkSize;
+		}
+	}
+
+	void readFileAt(uint64_t offset, void* data, uint64_t size)
+	{
+		OVERLAPPED ov{};
+		ov.Offset = (DWORD)offset;
+		ov.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD read = 0;
+		if (!ReadFile(fileHandle, data, (DWORD)size, &read, &ov) || read != size)
+			Error("failed to read back %lld bytes at offset %lld from output file\n", size, offset);
+	}
+};
@@ -0,0 +1,969 @@
+//=============================================================================//
+//
+// purpose: png and tga decoding for texture sources
+//
+//=============================================================================//
+#include "pch.h"
+#include "imageloader.h"
+
+//-----------------------------------------------------------------------------
+// zlib inflate (rfc 1950/1951) for png image data
+//-----------------------------------------------------------------------------
+
+// codes of up to this many bits are decoded with a single table lookup
+#define INFLATE_FAST_BITS 9
+
+struct InflateHuffman
+{
+	uint16_t counts[16]; // number of codes of each length
+	uint16_t symbols[288]; // symbols ordered by code
+	uint16_t fast[1 << INFLATE_FAST_BITS]; // symbol << 4 | length, 0 if the code is longer
+};
+
+class InflateStream
+{
+public:
+	InflateStream(const uint8_t* data, size_t size) : data(data), size(size) {};
+
+	// decompresses the whole zlib stream, returns false if it is malformed
+	bool Inflate(std::vector<uint8_t>& out)
+	{
+		if (size < 2)
+			return false;
+
+		// compression method 8 (deflate), no preset dictionary
+		if ((data[0] & 0xF) != 8 || (data[1] & 0x20) || ((data[0] << 8) | data[1]) % 31 != 0)
+			return false;
+
+		pos = 2;
+
+		bool lastBlock = false;
+		while (!lastBlock)
+		{
+			lastBlock = GetBits(1);
+
+			bool ok = false;
+			switch (GetBits(2))
+			{
+			case 0:
+				ok = InflateStored(out);
+				break;
+			case 1:
+				ok = InflateFixed(out);
+				break;
+			case 2:
+				ok = InflateDynamic(out);
+				break;
+			default:
+				break;
+			}
+
+			if (!ok || Overrun())
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+
+	uint64_t bitBuf = 0;
+	int bitCount = 0;
+
+	// whether more bytes have been consumed than the stream contains
+	bool Overrun() const
+	{
+		return pos - (bitCount / 8) > size;
+	}
+
+	void Refill()
+	{
+		// past the end of the stream zeros are shifted in, Overrun catches it
+		while (bitCount <= 56)
+		{
+			uint64_t byte = pos < size ? data[pos] : 0;
+			bitBuf |= byte << bitCount;
+			bitCount += 8;
+			pos++;
+		}
+	}
+
+	uint32_t GetBits(int n)
+	{
+		if (bitCount < n)
+			Refill();
+
+		uint32_t value = (uint32_t)(bitBuf & ((1ull << n) - 1));
+		bitBuf >>= n;
+		bitCount -= n;
+
+		return value;
+	}
+
+	static bool BuildHuffman(InflateHuffman& h, const uint8_t* lengths, int count)
+	{
+		memset(h.counts, 0, sizeof(h.counts));
+		memset(h.fast, 0, sizeof(h.fast));
+
+		for (int i = 0; i < count; ++i)
+			h.counts[lengths[i]]++;
+
+		h.counts[0] = 0;
+
+		// reject over-subscribed code sets
+		int left = 1;
+		for (int len = 1; len < 16; ++len)
+		{
+			left <<= 1;
+			left -= h.counts[len];
+			if (left < 0)
+				return false;
+		}
+
+		uint16_t offsets[16];
+		offsets[1] = 0;
+		for (int len = 1; len < 15; ++len)
+			offsets[len + 1] = offsets[len] + h.counts[len];
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (lengths[i] != 0)
+				h.symbols[offsets[lengths[i]]++] = i;
+		}
+
+		// canonical codes are assigned in symbol order, so walking the sorted symbols
+		// gives each short code's (bit reversed) table slots
+		int code = 0;
+		int index = 0;
+		for (int len = 1; len <= INFLATE_FAST_BITS; ++len)
+		{
+			for (int i = 0; i < h.counts[len]; ++i, ++code, ++index)
+			{
+				int reversed = 0;
+				for (int b = 0; b < len; ++b)
+					reversed |= ((code >> b) & 1) << (len - 1 - b);
+
+				for (int slot = reversed; slot < (1 << INFLATE_FAST_BITS); slot += 1 << len)
+					h.fast[slot] = (h.symbols[index] << 4) | len;
+			}
+
+			code <<= 1;
+		}
+
+		return true;
+	}
+
+	// returns the decoded symbol, or -1 for an invalid code
+	int Decode(const InflateHuffman& h)
+	{
+		if (bitCount < 16)
+			Refill();
+
+		uint16_t entry = h.fast[bitBuf & ((1 << INFLATE_FAST_BITS) - 1)];
+		if (entry != 0)
+		{
+			int len = entry & 0xF;
+			bitBuf >>= len;
+			bitCount -= len;
+
+			return entry >> 4;
+		}
+
+		// longer codes are decoded bit by bit
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for (int len = 1; len < 16; ++len)
+		{
+			code |= GetBits(1);
+
+			int count = h.counts[len];
+			if (code - count < first)
+				return h.symbols[index + (code - first)];
+
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+
+		return -1;
+	}
+
+	bool InflateStored(std::vector<uint8_t>& out)
+	{
+		// stored blocks start on a byte boundary
+		GetBits(bitCount % 8);
+
+		uint32_t len = GetBits(16);
+		uint32_t nlen = GetBits(16);
+
+		if (len != (~nlen & 0xFFFF))
+			return false;
+
+		// drain the bytes that are still buffered before copying from the stream
+		while (len > 0 && bitCount > 0)
+		{
+			out.push_back((uint8_t)GetBits(8));
+			len--;
+		}
+
+		// once the buffer is drained, pos is the next unread byte
+		if (len > 0 && pos + len > size)
+			return false;
+
+		out.insert(out.end(), data + pos, data + pos + len);
+		pos += len;
+
+		return true;
+	}
+
+	bool InflateFixed(std::vector<uint8_t>& out)
+	{
+		static InflateHuffman s_LengthCodes;
+		static InflateHuffman s_DistanceCodes;
+		static std::once_flag s_Built;
+
+		std::call_once(s_Built, []() {
+			uint8_t lengths[288];
+			int i = 0;
+			for (; i < 144; ++i) lengths[i] = 8;
+			for (; i < 256; ++i) lengths[i] = 9;
+			for (; i < 280; ++i) lengths[i] = 7;
+			for (; i < 288; ++i) lengths[i] = 8;
+			BuildHuffman(s_LengthCodes, lengths, 288);
+
+			for (i = 0; i < 30; ++i) lengths[i] = 5;
+			BuildHuffman(s_DistanceCodes, lengths, 30);
+		});
+
+		return InflateCodes(out, s_LengthCodes, s_DistanceCodes);
+	}
+
+	bool InflateDynamic(std::vector<uint8_t>& out)
+	{
+		static const uint8_t s_CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		int numLengthCodes = GetBits(5) + 257;
+		int numDistanceCodes = GetBits(5) + 1;
+		int numCodeLengthCodes = GetBits(4) + 4;
+
+		if (numLengthCodes > 286 || numDistanceCodes > 30)
+			return false;
+
+		uint8_t lengths[320]{};
+		for (int i = 0; i < numCodeLengthCodes; ++i)
+			lengths[s_CodeLengthOrder[i]] = GetBits(3);
+
+		InflateHuffman codeLengthCodes;
+		if (!BuildHuffman(codeLengthCodes, lengths, 19))
+			return false;
+
+		memset(lengths, 0, sizeof(lengths));
+
+		int index = 0;
+		while (index < numLengthCodes + numDistanceCodes)
+		{
+			int symbol = Decode(codeLengthCodes);
+
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 16)
+			{
+				lengths[index++] = symbol;
+				continue;
+			}
+
+			uint8_t repeated = 0;
+			int repeat = 0;
+
+			if (symbol == 16)
+			{
+				if (index == 0)
+					return false;
+
+				repeated = lengths[index - 1];
+				repeat = 3 + GetBits(2);
+			}
+			else if (symbol == 17)
+				repeat = 3 + GetBits(3);
+			else
+				repeat = 11 + GetBits(7);
+
+			if (index + repeat > numLengthCodes + numDistanceCodes)
+				return false;
+
+			while (repeat--)
+				lengths[index++] = repeated;
+		}
+
+		// the end of block code has to be present
+		if (lengths[256] == 0)
+			return false;
+
+		InflateHuffman lengthCodes;
+		InflateHuffman distanceCodes;
+
+		if (!BuildHuffman(lengthCodes, lengths, numLengthCodes) || !BuildHuffman(distanceCodes, lengths + numLengthCodes, numDistanceCodes))
+			return false;
+
+		return InflateCodes(out, lengthCodes, distanceCodes);
+	}
+
+	bool InflateCodes(std::vector<uint8_t>& out, const InflateHuffman& lengthCodes, const InflateHuffman& distanceCodes)
+	{
+		static const uint16_t s_LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t s_LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t s_DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t s_DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		// a truncated stream decodes to zeros, so stop once it is used up
+		while (!Overrun())
+		{
+			int symbol = Decode(lengthCodes);
+
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 256)
+			{
+				out.push_back((uint8_t)symbol);
+				continue;
+			}
+
+			if (symbol == 256)
+				return true;
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return false;
+
+			size_t len = s_LengthBase[symbol] + GetBits(s_LengthExtra[symbol]);
+
+			int distSymbol = Decode(distanceCodes);
+			if (distSymbol < 0 || distSymbol >= 30)
+				return false;
+
+			size_t dist = s_DistanceBase[distSymbol] + GetBits(s_DistanceExtra[distSymbol]);
+
+			if (dist > out.size() || Overrun())
+				return false;
+
+			// copies may overlap their own output, so this has to go byte by byte
+			size_t from = out.size() - dist;
+			for (size_t i = 0; i < len; ++i)
+				out.push_back(out[from + i]);
+		}
+
+		return false;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// png
+//-----------------------------------------------------------------------------
+
+static uint32_t ReadU32BE(const uint8_t* p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint8_t PaethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc)
+		return a;
+
+	return pb <= pc ? b : c;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: reverses the png row filters in place
+// returns: false if a row uses an unknown filter type
+//-----------------------------------------------------------------------------
+static bool UnfilterPNGRows(uint8_t* rows, uint32_t stride, uint32_t height, uint32_t bytesPerPixel)
+{
+	uint8_t* prev = nullptr;
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t filter = rows[0];
+		uint8_t* row = rows + 1;
+
+		for (uint32_t x = 0; x < stride; ++x)
+		{
+			int a = x >= bytesPerPixel ? row[x - bytesPerPixel] : 0;
+			int b = prev ? prev[x] : 0;
+			int c = prev && x >= bytesPerPixel ? prev[x - bytesPerPixel] : 0;
+
+			switch (filter)
+			{
+			case 0:
+				break;
+			case 1:
+				row[x] += a;
+				break;
+			case 2:
+				row[x] += b;
+				break;
+			case 3:
+				row[x] += (a + b) / 2;
+				break;
+			case 4:
+				row[x] += PaethPredictor(a, b, c);
+				break;
+			default:
+				return false;
+			}
+		}
+
+		prev = row;
+		rows += stride + 1;
+	}
+
+	return true;
+}
+
+struct PNGInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint8_t bitDepth;
+	uint8_t colorType;
+	uint8_t channels;
+
+	uint8_t palette[256][4];
+	uint32_t paletteSize;
+
+	// tRNS color key for gray and rgb images, in sample values
+	bool hasColorKey;
+	uint16_t colorKey[3];
+};
+
+static uint32_t GetPNGSample(const uint8_t* row, uint32_t index, uint8_t bitDepth)
+{
+	switch (bitDepth)
+	{
+	case 8:
+		return row[index];
+	case 16:
+		return (row[index * 2] << 8) | row[index * 2 + 1];
+	default:
+	{
+		uint32_t bit = index * bitDepth;
+		return (row[bit / 8] >> (8 - bitDepth - (bit % 8))) & ((1 << bitDepth) - 1);
+	}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: converts unfiltered png rows to rgba8, writing every pixel to
+//          (x0 + x * dx, y0 + y * dy) so interlaced passes can be placed directly
+//-----------------------------------------------------------------------------
+static void ConvertPNGRows(const PNGInfo& png, const uint8_t* rows, uint32_t stride, uint32_t width, uint32_t height, uint32_t x0, uint32_t y0, uint32_t dx, uint32_t dy, SourceImage& image)
+{
+	uint32_t maxSample = (1 << png.bitDepth) - 1;
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* row = rows + y * (stride + 1) + 1;
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t* out = &image.pixels[(((y0 + y * dy) * image.width) + x0 + x * dx) * 4];
+			uint32_t samples[4];
+
+			for (uint32_t c = 0; c < png.channels; ++c)
+				samples[c] = GetPNGSample(row, x * png.channels + c, png.bitDepth);
+
+			// palette indices are not scaled, everything else goes to 8 bits
+			auto scale = [&](uint32_t v) -> uint8_t {
+				return (uint8_t)(png.bitDepth == 16 ? v >> 8 : v * 255 / maxSample);
+			};
+
+			switch (png.colorType)
+			{
+			case 0: // gray
+				out[0] = out[1] = out[2] = scale(samples[0]);
+				out[3] = png.hasColorKey && samples[0] == png.colorKey[0] ? 0 : 255;
+				break;
+			case 2: // rgb
+				out[0] = scale(samples[0]);
+				out[1] = scale(samples[1]);
+				out[2] = scale(samples[2]);
+				out[3] = png.hasColorKey && samples[0] == png.colorKey[0] && samples[1] == png.colorKey[1] && samples[2] == png.colorKey[2] ? 0 : 255;
+				break;
+			case 3: // palette
+				memcpy(out, png.palette[samples[0] < png.paletteSize ? samples[0] : 0], 4);
+				break;
+			case 4: // gray + alpha
+				out[0] = out[1] = out[2] = scale(samples[0]);
+				out[3] = scale(samples[1]);
+				break;
+			case 6: // rgba
+				out[0] = scale(samples[0]);
+				out[1] = scale(samples[1]);
+				out[2] = scale(samples[2]);
+				out[3] = scale(samples[3]);
+				break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: decodes a png file into rgba8 pixels
+//-----------------------------------------------------------------------------
+void ImageLoader::LoadPNG(const std::string& filePath, const uint8_t* data, size_t size, SourceImage& image)
+{
+	static const uint8_t s_PNGSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	if (size < sizeof(s_PNGSignature) || memcmp(data, s_PNGSignature, sizeof(s_PNGSignature)) != 0)
+		Error("image file '%s' is not a valid png file (invalid signature)\n", filePath.c_str());
+
+	PNGInfo png{};
+	bool interlaced = false;
+	bool hasHeader = false;
+
+	// idat chunks form one zlib stream
+	std::vector<uint8_t> compressed;
+
+	size_t pos = sizeof(s_PNGSignature);
+	while (pos + 12 <= size)
+	{
+		uint32_t chunkSize = ReadU32BE(data + pos);
+		const uint8_t* chunkType = data + pos + 4;
+		const uint8_t* chunk = data + pos + 8;
+
+		if (chunkSize > size - pos - 12)
+			Error("image file '%s' is not a valid png file (truncated chunk)\n", filePath.c_str());
+
+		if (!memcmp(chunkType, "IHDR", 4) && chunkSize >= 13)
+		{
+			png.width = ReadU32BE(chunk);
+			png.height = ReadU32BE(chunk + 4);
+			png.bitDepth = chunk[8];
+			png.colorType = chunk[9];
+			interlaced = chunk[12] == 1;
+			hasHeader = true;
+		}
+		else if (!memcmp(chunkType, "PLTE", 4))
+		{
+			png.paletteSize = chunkSize / 3 > 256 ? 256 : chunkSize / 3;
+			for (uint32_t i = 0; i < png.paletteSize; ++i)
+			{
+				memcpy(png.palette[i], chunk + i * 3, 3);
+				png.palette[i][3] = 255;
+			}
+		}
+		else if (!memcmp(chunkType, "tRNS", 4))
+		{
+			if (png.colorType == 3)
+			{
+				for (uint32_t i = 0; i < chunkSize && i < 256; ++i)
+					png.palette[i][3] = chunk[i];
+			}
+			else
+			{
+				png.hasColorKey = true;
+				for (uint32_t i = 0; i < 3 && i * 2 + 1 < chunkSize; ++i)
+					png.colorKey[i] = (chunk[i * 2] << 8) | chunk[i * 2 + 1];
+			}
+		}
+		else if (!memcmp(chunkType, "IDAT", 4))
+		{
+			compressed.insert(compressed.end(), chunk, chunk + chunkSize);
+		}
+		else if (!memcmp(chunkType, "IEND", 4))
+		{
+			break;
+		}
+
+		pos += chunkSize + 12;
+	}
+
+	if (!hasHeader || png.width == 0 || png.height == 0)
+		Error("image file '%s' is not a valid png file (missing header)\n", filePath.c_str());
+
+	switch (png.colorType)
+	{
+	case 0: png.channels = 1; break;
+	case 2: png.channels = 3; break;
+	case 3: png.channels = 1; break;
+	case 4: png.channels = 2; break;
+	case 6: png.channels = 4; break;
+	default:
+		Error("image file '%s' uses unknown png color type %i\n", filePath.c_str(), png.colorType);
+	}
+
+	bool validDepth = png.bitDepth == 8 || png.bitDepth == 16;
+	if (png.colorType == 0 || png.colorType == 3)
+		validDepth = png.colorType == 3 ? png.bitDepth <= 8 : png.bitDepth <= 16;
+
+	if (!validDepth || png.bitDepth == 0 || (png.bitDepth & (png.bitDepth - 1)) != 0)
+		Error("image file '%s' uses invalid bit depth %i for png color type %i\n", filePath.c_str(), png.bitDepth, png.colorType);
+
+	if (png.colorType == 3 && png.paletteSize == 0)
+		Error("image file '%s' is a palette png without a palette\n", filePath.c_str());
+
+	// adam7 passes as x0, y0, dx, dy. non-interlaced images are a single pass over every pixel
+	static const uint32_t s_Adam7Passes[7][4] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+	static const uint32_t s_SinglePass[1][4] = { { 0, 0, 1, 1 } };
+
+	const uint32_t(*passes)[4] = interlaced ? s_Adam7Passes : s_SinglePass;
+	int numPasses = interlaced ? 7 : 1;
+
+	uint32_t bitsPerPixel = png.channels * png.bitDepth;
+	uint32_t bytesPerPixel = bitsPerPixel >= 8 ? bitsPerPixel / 8 : 1;
+
+	size_t expectedSize = 0;
+	for (int p = 0; p < numPasses; ++p)
+	{
+		uint64_t passWidth = (png.width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+		uint64_t passHeight = (png.height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+
+		if (png.width > passes[p][0] && png.height > passes[p][1])
+			expectedSize += passHeight * (1 + (passWidth * bitsPerPixel + 7) / 8);
+	}
+
+	std::vector<uint8_t> raw;
+	raw.reserve(expectedSize);
+
+	InflateStream inflate(compressed.data(), compressed.size());
+
+	if (!inflate.Inflate(raw) || raw.size() < expectedSize)
+		Error("image file '%s' has corrupt png image data\n", filePath.c_str());
+
+	image.width = png.width;
+	image.height = png.height;
+	image.pixels.resize((size_t)png.width * png.height * 4);
+
+	uint8_t* rows = raw.data();
+	for (int p = 0; p < numPasses; ++p)
+	{
+		// small images can have empty passes, which have no rows at all
+		if (png.width <= passes[p][0] || png.height <= passes[p][1])
+			continue;
+
+		uint32_t passWidth = (png.width - passes[p][0] + passes[p][2] - 1) / passes[p][2];
+		uint32_t passHeight = (png.height - passes[p][1] + passes[p][3] - 1) / passes[p][3];
+		uint32_t stride = (passWidth * bitsPerPixel + 7) / 8;
+
+		if (!UnfilterPNGRows(rows, stride, passHeight, bytesPerPixel))
+			Error("image file '%s' has corrupt png image data (invalid row filter)\n", filePath.c_str());
+
+		ConvertPNGRows(png, rows, stride, passWidth, passHeight, passes[p][0], passes[p][1], passes[p][2], passes[p][3], image);
+
+		rows += (size_t)passHeight * (stride + 1);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// tga
+//-----------------------------------------------------------------------------
+
+#pragma pack(push, 1)
+struct TGAHeader
+{
+	uint8_t idLength;
+	uint8_t colorMapType;
+	uint8_t imageType;
+	uint16_t colorMapFirst;
+	uint16_t colorMapLength;
+	uint8_t colorMapDepth;
+	uint16_t originX;
+	uint16_t originY;
+	uint16_t width;
+	uint16_t height;
+	uint8_t pixelDepth;
+	uint8_t descriptor;
+};
+#pragma pack(pop)
+
+//-----------------------------------------------------------------------------
+// purpose: converts one tga pixel to rgba8
+//-----------------------------------------------------------------------------
+static void ConvertTGAPixel(const uint8_t* src, uint8_t pixelDepth, bool gray, uint8_t* out)
+{
+	if (gray)
+	{
+		out[0] = out[1] = out[2] = src[0];
+		out[3] = pixelDepth == 16 ? src[1] : 255;
+		return;
+	}
+
+	switch (pixelDepth)
+	{
+	case 15:
+	case 16:
+	{
+		// a1r5g5b5
+		uint16_t v = src[0] | (src[1] << 8);
+		out[0] = (((v >> 10) & 0x1F) * 255) / 31;
+		out[1] = (((v >> 5) & 0x1F) * 255) / 31;
+		out[2] = ((v & 0x1F) * 255) / 31;
+		out[3] = pixelDepth == 16 && !(v & 0x8000) ? 0 : 255;
+		break;
+	}
+	case 24:
+		out[0] = src[2];
+		out[1] = src[1];
+		out[2] = src[0];
+		out[3] = 255;
+		break;
+	case 32:
+		out[0] = src[2];
+		out[1] = src[1];
+		out[2] = src[0];
+		out[3] = src[3];
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: decodes an uncompressed or rle truecolor/grayscale tga file into rgba8 pixels
+//-----------------------------------------------------------------------------
+void ImageLoader::LoadTGA(const std::string& filePath, const uint8_t* data, size_t size, SourceImage& image)
+{
+	if (size < sizeof(TGAHeader))
+		Error("image file '%s' is not a valid tga file (truncated header)\n", filePath.c_str());
+
+	const TGAHeader& hdr = *reinterpret_cast<const TGAHeader*>(data);
+
+	bool rle = hdr.imageType == 10 || hdr.imageType == 11;
+	bool gray = hdr.imageType == 3 || hdr.imageType == 11;
+
+	if (hdr.imageType != 2 && hdr.imageType != 3 && !rle)
+		Error("image file '%s' uses unsupported tga image type %i. only truecolor and grayscale images are supported\n", filePath.c_str(), hdr.imageType);
+
+	if ((gray && hdr.pixelDepth != 8 && hdr.pixelDepth != 16) || (!gray && hdr.pixelDepth != 15 && hdr.pixelDepth != 16 && hdr.pixelDepth != 24 && hdr.pixelDepth != 32))
+		Error("image file '%s' uses unsupported tga pixel depth %i\n", filePath.c_str(), hdr.pixelDepth);
+
+	if (hdr.width == 0 || hdr.height == 0)
+		Error("image file '%s' has invalid tga dimensions %ix%i\n", filePath.c_str(), hdr.width, hdr.height);
+
+	uint32_t bytesPerPixel = (hdr.pixelDepth + 7) / 8;
+	size_t pos = sizeof(TGAHeader) + hdr.idLength;
+
+	// color maps are allowed on truecolor images, but not used
+	if (hdr.colorMapType == 1)
+		pos += (size_t)hdr.colorMapLength * ((hdr.colorMapDepth + 7) / 8);
+
+	image.width = hdr.width;
+	image.height = hdr.height;
+	image.pixels.resize((size_t)hdr.width * hdr.height * 4);
+
+	// tga rows go from bottom to top unless the top-left origin bit is set
+	bool topDown = hdr.descriptor & 0x20;
+	bool rightToLeft = hdr.descriptor & 0x10;
+
+	size_t numPixels = (size_t)hdr.width * hdr.height;
+	size_t pixel = 0;
+
+	auto emit = [&](const uint8_t* src) {
+		uint32_t x = pixel % hdr.width;
+		uint32_t y = (uint32_t)(pixel / hdr.width);
+
+		if (!topDown)
+			y = hdr.height - 1 - y;
+
+		if (rightToLeft)
+			x = hdr.width - 1 - x;
+
+		ConvertTGAPixel(src, hdr.pixelDepth, gray, &image.pixels[((size_t)y * hdr.width + x) * 4]);
+		pixel++;
+	};
+
+	while (pixel < numPixels)
+	{
+		uint32_t count = 1;
+		bool repeat = false;
+
+		if (rle)
+		{
+			if (pos >= size)
+				break;
+
+			uint8_t packet = data[pos++];
+			count = (packet & 0x7F) + 1;
+			repeat = packet & 0x80;
+		}
+		else
+		{
+			count = (uint32_t)(numPixels < UINT32_MAX ? numPixels : UINT32_MAX);
+		}
+
+		if (count > numPixels - pixel)
+			count = (uint32_t)(numPixels - pixel);
+
+		size_t packetSize = (size_t)(repeat ? 1 : count) * bytesPerPixel;
+		if (pos + packetSize > size)
+			break;
+
+		for (uint32_t i = 0; i < count; ++i)
+			emit(data + pos + (repeat ? 0 : (size_t)i * bytesPerPixel));
+
+		pos += packetSize;
+	}
+
+	if (pixel < numPixels)
+		Error("image file '%s' has less pixel data than described by its tga header\n", filePath.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// purpose: loads an image file, picking the decoder from the file extension
+// returns: false if the file extension is not a supported image format
+//-----------------------------------------------------------------------------
+bool ImageLoader::LoadImageFile(const std::string& filePath, SourceImage& image)
+{
+	std::string extension = fs::path(filePath).extension().u8string();
+	for (auto& c : extension)
+		c = (char)tolower(c);
+
+	if (extension != ".png" && extension != ".tga")
+		return false;
+
+	BinaryIO input;
+	if (!input.open(filePath, BinaryIOMode::Read, BIO_MAPPED))
+		Error("failed to open image file '%s'\n", filePath.c_str());
+
+	if (extension == ".png")
+		LoadPNG(filePath, input.getData(), input.getSize(), image);
+	else
+		LoadTGA(filePath, input.getData(), input.getSize(), image);
+
+	input.close();
+
+	image.hasAlpha = false;
+	for (size_t i = 3; i < image.pixels.size(); i += 4)
+	{
+		if (image.pixels[i] != 255)
+		{
+			image.hasAlpha = true;
+			break;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: reads the dimensions of an image file without decoding its pixels
+//          mayHaveAlpha is set if the format can store transparency, the pixels
+//          themselves are not checked
+// returns: false if the file extension is not a supported image format
+//-----------------------------------------------------------------------------
+bool ImageLoader::GetImageInfo(const std::string& filePath, uint32_t& width, uint32_t& height, bool& mayHaveAlpha)
+{
+	std::string extension = fs::path(filePath).extension().u8string();
+	for (auto& c : extension)
+		c = (char)tolower(c);
+
+	if (extension != ".png" && extension != ".tga")
+		return false;
+
+	BinaryIO input;
+	if (!input.open(filePath, BinaryIOMode::Read, BIO_MAPPED))
+		Error("failed to open image file '%s'\n", filePath.c_str());
+
+	const uint8_t* data = input.getData();
+	size_t size = input.getSize();
+
+	width = 0;
+	height = 0;
+	mayHaveAlpha = false;
+
+	if (extension == ".png")
+	{
+		// chunks are walked up to the image data, tRNS has to come before it
+		size_t pos = 8;
+		while (pos + 12 <= size)
+		{
+			uint32_t chunkSize = ReadU32BE(data + pos);
+			const uint8_t* chunkType = data + pos + 4;
+			const uint8_t* chunk = data + pos + 8;
+
+			if (chunkSize > size - pos - 12 || !memcmp(chunkType, "IDAT", 4))
+				break;
+
+			if (!memcmp(chunkType, "IHDR", 4) && chunkSize >= 13)
+			{
+				width = ReadU32BE(chunk);
+				height = ReadU32BE(chunk + 4);
+				mayHaveAlpha = chunk[9] == 4 || chunk[9] == 6;
+			}
+			else if (!memcmp(chunkType, "tRNS", 4))
+			{
+				mayHaveAlpha = true;
+			}
+
+			pos += chunkSize + 12;
+		}
+	}
+	else if (size >= sizeof(TGAHeader))
+	{
+		const TGAHeader& hdr = *reinterpret_cast<const TGAHeader*>(data);
+
+		width = hdr.width;
+		height = hdr.height;
+
+		// 16 bit pixels are either gray with alpha or a1r5g5b5
+		mayHaveAlpha = hdr.pixelDepth == 32 || hdr.pixelDepth == 16;
+	}
+
+	input.close();
+
+	if (width == 0 || height == 0)
+		Error("image file '%s' has no valid image header\n", filePath.c_str());
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: keeps the decoded image of a file for its build
+// returns: false if the image doesn't fit in the cache or is already in it
+//-----------------------------------------------------------------------------
+bool SourceImageCache::Store(const std::string& filePath, SourceImage&& image)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	const uint64_t size = image.pixels.size();
+
+	if (m_nSize + size > m_nMaxSize || m_Images.count(filePath))
+		return false;
+
+	m_Images.emplace(filePath, std::move(image));
+	m_nSize += size;
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: moves the decoded image of a file out of the cache, each image is only
+//          built once so it isn't kept any longer
+// returns: false if the image isn't in the cache
+//-----------------------------------------------------------------------------
+bool SourceImageCache::Take(const std::string& filePath, SourceImage& image)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_Images.find(filePath);
+
+	if (it == m_Images.end())
+		return false;
+
+	m_nSize -= it->second.pixels.size();
+
+	image = std::move(it->second);
+	m_Images.erase(it);
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// decoded source image with 8 bits per channel rgba pixels, rows from top to bottom
+struct SourceImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	bool hasAlpha = false; // whether any pixel is not fully opaque
+	std::vector<uint8_t> pixels;
+};
+
+// size of the decoded images that can be kept between planning and building the textures
+#define SOURCE_IMAGE_CACHE_SIZE (1024ull * 1024 * 1024)
+
+//
+// decoded images that planning had to decode, kept for the build so they are only decoded once
+// images that don't fit in the size limit are decoded again when they are built
+//
+class SourceImageCache
+{
+public:
+	SourceImageCache(uint64_t maxSize) : m_nMaxSize(maxSize) {}
+
+	// keeps the image of a file. Returns false if it doesn't fit or is already kept
+	bool Store(const std::string& filePath, SourceImage&& image);
+
+	// moves the image of a file out of the cache. Returns false if it isn't kept
+	bool Take(const std::string& filePath, SourceImage& image);
+
+private:
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, SourceImage> m_Images;
+
+	uint64_t m_nMaxSize;
+	uint64_t m_nSize = 0;
+};
+
+//
+// decoders for the uncompressed image formats that textures can be built from
+//
+namespace ImageLoader
+{
+	// extensions of the source image formats that can be loaded, in lookup order
+	static const char* const s_SourceImageExtensions[] = { "png", "tga" };
+
+	bool LoadImageFile(const std::string& filePath, SourceImage& image);
+
+	// reads only the header of an image file, for planning ahead of a build
+	bool GetImageInfo(const std::string& filePath, uint32_t& width, uint32_t& height, bool& mayHaveAlpha);
+
+	void LoadPNG(const std::string& filePath, const uint8_t* data, size_t size, SourceImage& image);
+	void LoadTGA(const std::string& filePath, const uint8_t* data, size_t size, SourceImage& image);
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+//
+// read-only view of a whole file mapped into memory
+//
+class MappedFile
+{
+	// handle of the mapped file
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	// handle of the file mapping object
+	HANDLE mappingHandle = NULL;
+	// start of the mapped view
+	const uint8_t* data = nullptr;
+	// size of the mapped view
+	uint64_t size = 0;
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	// maps the file at the given path. Returns whether the operation was successful
+	bool open(const std::string& fileFullPath)
+	{
+		close();
+
+		fileHandle = CreateFileA(fileFullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize))
+		{
+			close();
+			return false;
+		}
+
+		size = fileSize.QuadPart;
+
+		// empty files can't be mapped, but there's nothing to read from them either
+		if (size == 0)
+			return true;
+
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mappingHandle == NULL)
+		{
+			close();
+			return false;
+		}
+
+		data = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+		if (!data)
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	// unmaps the file
+	void close()
+	{
+		if (data)
+			UnmapViewOfFile(data);
+
+		if (mappingHandle != NULL)
+			CloseHandle(mappingHandle);
+
+		if (fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(fileHandle);
+
+		data = nullptr;
+		mappingHandle = NULL;
+		fileHandle = INVALID_HANDLE_VALUE;
+		size = 0;
+	}
+
+	bool isOpen() const
+	{
+		return fileHandle != INVALID_HANDLE_VALUE;
+	}
+
+	const uint8_t* getData() const
+	{
+		return data;
+	}
+
+	uint64_t getSize() const
+	{
+		return size;
+	}
+};
@@ -0,0 +1,243 @@
+//=============================================================================//
+//
+// purpose: mip chain generation for texture sources
+//
+//=============================================================================//
+#include "pch.h"
+#include "imageloader.h"
+#include "mipgen.h"
+#include <emmintrin.h>
+
+// resolution of the table that converts filtered values back to 8 bits
+#define MIPGEN_ENCODE_TABLE_SIZE 4096
+
+// conversion between 8 bit channel values and the space that mips are filtered in
+struct MipTransferTables
+{
+	float decode[256];
+	uint8_t encode[MIPGEN_ENCODE_TABLE_SIZE + 1];
+};
+
+static MipTransferTables BuildTransferTables(bool srgb)
+{
+	MipTransferTables tables{};
+
+	for (int i = 0; i < 256; ++i)
+	{
+		float v = i / 255.f;
+
+		if (srgb)
+			v = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+
+		tables.decode[i] = v;
+	}
+
+	for (int i = 0; i <= MIPGEN_ENCODE_TABLE_SIZE; ++i)
+	{
+		float v = (float)i / MIPGEN_ENCODE_TABLE_SIZE;
+
+		if (srgb)
+			v = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.f / 2.4f) - 0.055f;
+
+		tables.encode[i] = (uint8_t)(v * 255.f + 0.5f);
+	}
+
+	return tables;
+}
+
+static const MipTransferTables s_LinearTables = BuildTransferTables(false);
+static const MipTransferTables s_SRGBTables = BuildTransferTables(true);
+
+// kaiser windowed sinc taps for halving a dimension. destination pixel x covers source
+// pixels 2x and 2x+1, the taps go over source pixels 2x-2 to 2x+3
+static const std::array<float, 6> s_KaiserWeights = []()
+{
+	const float alpha = 4.f;
+	const float halfWidth = 1.5f; // in destination pixels
+
+	// modified bessel function of the first kind, order 0
+	auto besselI0 = [](float x) {
+		float sum = 1.f;
+		float term = 1.f;
+		for (int k = 1; k < 20; ++k)
+		{
+			term *= (x / (2.f * k)) * (x / (2.f * k));
+			sum += term;
+		}
+
+		return sum;
+	};
+
+	std::array<float, 6> weights{};
+	float total = 0.f;
+
+	for (int k = 0; k < 6; ++k)
+	{
+		// distance of the source pixel center from the destination pixel center, in destination pixels
+		float t = (k - 2.5f) * 0.5f;
+		float sinc = sinf(3.14159265f * t) / (3.14159265f * t);
+		float window = besselI0(alpha * sqrtf(1.f - (t / halfWidth) * (t / halfWidth))) / besselI0(alpha);
+
+		weights[k] = sinc * window;
+		total += weights[k];
+	}
+
+	for (auto& it : weights)
+		it /= total;
+
+	return weights;
+}();
+
+static inline __m128 LoadPixel(const uint8_t* p, const MipTransferTables& tables)
+{
+	return _mm_set_ps(p[3] * (1.f / 255.f), tables.decode[p[2]], tables.decode[p[1]], tables.decode[p[0]]);
+}
+
+static inline void StorePixel(__m128 v, uint8_t* p, const MipTransferTables& tables)
+{
+	// sharpening filters can overshoot
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+	alignas(16) int32_t encoded[4];
+	_mm_store_si128((__m128i*)encoded, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set_ps(255.f, MIPGEN_ENCODE_TABLE_SIZE, MIPGEN_ENCODE_TABLE_SIZE, MIPGEN_ENCODE_TABLE_SIZE)), _mm_set1_ps(0.5f))));
+
+	p[0] = tables.encode[encoded[0]];
+	p[1] = tables.encode[encoded[1]];
+	p[2] = tables.encode[encoded[2]];
+	p[3] = (uint8_t)encoded[3];
+}
+
+//-----------------------------------------------------------------------------
+// purpose: gets the number of mips in a full chain down to 1x1
+//-----------------------------------------------------------------------------
+uint32_t MipGen::GetFullMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t size = width > height ? width : height;
+	uint32_t count = 1;
+
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: 2x2 average of each destination pixel's source pixels
+//-----------------------------------------------------------------------------
+static void DownsampleBox(const SourceImage& src, SourceImage& dst, const MipTransferTables& tables)
+{
+	const __m128 quarter = _mm_set1_ps(0.25f);
+
+	for (uint32_t y = 0; y < dst.height; ++y)
+	{
+		uint32_t y0 = 2 * y < src.height ? 2 * y : src.height - 1;
+		uint32_t y1 = 2 * y + 1 < src.height ? 2 * y + 1 : src.height - 1;
+
+		const uint8_t* row0 = src.pixels.data() + (size_t)y0 * src.width * 4;
+		const uint8_t* row1 = src.pixels.data() + (size_t)y1 * src.width * 4;
+		uint8_t* out = dst.pixels.data() + (size_t)y * dst.width * 4;
+
+		for (uint32_t x = 0; x < dst.width; ++x)
+		{
+			uint32_t x0 = (2 * x < src.width ? 2 * x : src.width - 1) * 4;
+			uint32_t x1 = (2 * x + 1 < src.width ? 2 * x + 1 : src.width - 1) * 4;
+
+			__m128 sum = _mm_add_ps(_mm_add_ps(LoadPixel(row0 + x0, tables), LoadPixel(row0 + x1, tables)),
+				_mm_add_ps(LoadPixel(row1 + x0, tables), LoadPixel(row1 + x1, tables)));
+
+			StorePixel(_mm_mul_ps(sum, quarter), out + x * 4, tables);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: separable kaiser filter, each destination row is built from the
+//          horizontally filtered source rows under it
+//-----------------------------------------------------------------------------
+static void DownsampleKaiser(const SourceImage& src, SourceImage& dst, const MipTransferTables& tables)
+{
+	const int numTaps = (int)s_KaiserWeights.size();
+
+	// horizontally filtered rows, one per vertical tap
+	std::vector<float> filteredRows((size_t)numTaps * dst.width * 4);
+
+	for (uint32_t y = 0; y < dst.height; ++y)
+	{
+		for (int k = 0; k < numTaps; ++k)
+		{
+			int64_t sy = (int64_t)y * 2 - 2 + k;
+			sy = sy < 0 ? 0 : (sy >= src.height ? src.height - 1 : sy);
+
+			const uint8_t* row = src.pixels.data() + (size_t)sy * src.width * 4;
+			float* filtered = filteredRows.data() + (size_t)k * dst.width * 4;
+
+			for (uint32_t x = 0; x < dst.width; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+
+				for (int j = 0; j < numTaps; ++j)
+				{
+					int64_t sx = (int64_t)x * 2 - 2 + j;
+					sx = sx < 0 ? 0 : (sx >= src.width ? src.width - 1 : sx);
+
+					sum = _mm_add_ps(sum, _mm_mul_ps(LoadPixel(row + sx * 4, tables), _mm_set1_ps(s_KaiserWeights[j])));
+				}
+
+				_mm_storeu_ps(filtered + x * 4, sum);
+			}
+		}
+
+		uint8_t* out = dst.pixels.data() + (size_t)y * dst.width * 4;
+
+		for (uint32_t x = 0; x < dst.width; ++x)
+		{
+			__m128 sum = _mm_setzero_ps();
+
+			for (int k = 0; k < numTaps; ++k)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(filteredRows.data() + ((size_t)k * dst.width + x) * 4), _mm_set1_ps(s_KaiserWeights[k])));
+
+			StorePixel(sum, out + x * 4, tables);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// purpose: builds the mip after src
+//-----------------------------------------------------------------------------
+void MipGen::Downsample(const SourceImage& src, SourceImage& dst, bool srgb, MipFilter filter)
+{
+	dst.width = src.width > 1 ? src.width / 2 : 1;
+	dst.height = src.height > 1 ? src.height / 2 : 1;
+	dst.hasAlpha = src.hasAlpha;
+	dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+	const MipTransferTables& tables = srgb ? s_SRGBTables : s_LinearTables;
+
+	if (filter == MipFilter::Kaiser)
+		DownsampleKaiser(src, dst, tables);
+	else
+		DownsampleBox(src, dst, tables);
+}
+
+//-----------------------------------------------------------------------------
+// purpose: builds the full mip chain of an image
+//-----------------------------------------------------------------------------
+void MipGen::GenerateMipChain(SourceImage image, bool srgb, MipFilter filter, std::vector<SourceImage>& mips)
+{
+	uint32_t mipCount = GetFullMipCount(image.width, image.height);
+
+	mips.clear();
+	mips.reserve(mipCount);
+	mips.push_back(std::move(image));
+
+	for (uint32_t i = 1; i < mipCount; ++i)
+	{
+		SourceImage mip;
+		Downsample(mips.back(), mip, srgb, filter);
+
+		mips.push_back(std::move(mip));
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// downsampling filter used for each mip
+enum class MipFilter
+{
+	Box = 0, // 2x2 average
+	Kaiser, // kaiser windowed sinc, sharper than box for detailed textures
+};
+
+//
+// mip chain generation for rgba8 images
+//
+namespace MipGen
+{
+	// number of mips in a full chain down to 1x1
+	uint32_t GetFullMipCount(uint32_t width, uint32_t height);
+
+	// builds the mip after src, halving each dimension down to 1
+	// srgb images are filtered in linear space, alpha is always linear
+	void Downsample(const SourceImage& src, SourceImage& dst, bool srgb, MipFilter filter);
+
+	// builds the full mip chain of an image, which is moved into mips[0]
+	void GenerateMipChain(SourceImage image, bool srgb, MipFilter filter, std::vector<SourceImage>& mips);
+};
@@ -22,22 +22,34 @@ uintmax_t Utils::GetFileSize(const std::string& filename) // !TODO: change to 'f
 	}
 }
 
+static const char s_Padding[4096]{};
+
 //-----------------------------------------------------------------------------
-// purpose: pad buffer to the specified alignment
-// returns: new buffer size
+// purpose: write the specified amount of zeroed padding bytes
 //-----------------------------------------------------------------------------
-size_t Utils::PadBuffer(char** buf, size_t size, size_t alignment)
+void Utils::WritePadding(BinaryIO& out, uint64_t size)
 {
-	size_t extra = alignment - (size % alignment);
-	size_t newSize = size + extra;
+	while (size > 0)
+	{
+		uint64_t chunkSize = size < sizeof(s_Padding) ? size : sizeof(s_Padding);
 
-	char* newbuf = new char[newSize]{};
-	memcpy_s(newbuf, size, *buf, size);
+		out.writeBytes(s_Padding, chunkSize);
+		size -= chunkSize;
+	}
+}
 
-	delete[] *buf;
+//-----------------------------------------------------------------------------
+// purpose: add spans of zeroed padding bytes with the specified total size
+//-----------------------------------------------------------------------------
+void Utils::AddPaddingSpans(std::vector<FileWriteSpan>& spans, uint64_t size)
+{
+	while (size > 0)
+	{
+		uint64_t chunkSize = size < sizeof(s_Padding) ? size : sizeof(s_Padding);
 
-	*buf = newbuf;
-	return newSize;
+		spans.push_back({ s_Padding, chunkSize });
+		size -= chunkSize;
+	}
 }
 
 //-----------------------------------------------------------------------------
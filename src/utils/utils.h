@@ -5,7 +5,9 @@ namespace Utils
 	uintmax_t GetFileSize(const std::string& filename);
 	FILETIME GetFileTimeBySystem();
 	
-	size_t PadBuffer(char** buf, size_t size, size_t alignment);
+	inline uint64_t AlignSize(uint64_t size, uint64_t alignment) { return (size + alignment - 1) / alignment * alignment; };
+	void WritePadding(BinaryIO& out, uint64_t size);
+	void AddPaddingSpans(std::vector<FileWriteSpan>& spans, uint64_t size);
 	size_t WriteStringVector(BinaryIO& out, std::vector<std::string>& dataVector);
 
 	void AppendSlash(std::string& in);
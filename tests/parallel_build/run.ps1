@@ -0,0 +1,61 @@
+# builds each map in this directory serially and with -j, and checks that the outputs are
+# byte for byte the same, apart from the file time in the rpak header
+#
+# usage: powershell -File tests/parallel_build/run.ps1 [-RePak <path to RePak.exe>] [-Jobs <threads>]
+param(
+    [string]$RePak = "$PSScriptRoot\..\..\bin\RePak.exe",
+    [int]$Jobs = 4
+)
+
+$ErrorActionPreference = "Stop"
+Set-Location $PSScriptRoot
+
+$failures = 0
+
+foreach ($map in Get-ChildItem -Filter "*.json")
+{
+    $outputDir = (Get-Content $map.FullName -Raw | ConvertFrom-Json).outputDir.TrimEnd("/", "\")
+    $serialDir = "$outputDir.serial"
+
+    Remove-Item -Recurse -Force $outputDir, $serialDir -ErrorAction SilentlyContinue
+
+    & $RePak $map.Name | Out-Null
+    if ($LASTEXITCODE -ne 0) { throw "serial build of $($map.Name) failed" }
+
+    Move-Item $outputDir $serialDir
+
+    & $RePak -j $Jobs $map.Name | Out-Null
+    if ($LASTEXITCODE -ne 0) { throw "parallel build of $($map.Name) failed" }
+
+    foreach ($file in Get-ChildItem $serialDir)
+    {
+        $serial = [IO.File]::ReadAllBytes($file.FullName)
+        $parallelPath = Join-Path $outputDir $file.Name
+
+        if (-not (Test-Path $parallelPath))
+        {
+            Write-Host "FAILED: $($map.Name): $($file.Name) is missing from the parallel build"
+            $failures++
+            continue
+        }
+
+        $parallel = [IO.File]::ReadAllBytes($parallelPath)
+
+        # the file time is at offset 8 of the rpak header
+        if ($file.Extension -eq ".rpak" -and $parallel.Length -ge 16)
+        {
+            for ($i = 8; $i -lt 16; $i++) { $parallel[$i] = $serial[$i] }
+        }
+
+        if (-not [Linq.Enumerable]::SequenceEqual([byte[]]$serial, [byte[]]$parallel))
+        {
+            Write-Host "FAILED: $($map.Name): $($file.Name) differs between the serial and the parallel build"
+            $failures++
+        }
+    }
+
+    Remove-Item -Recurse -Force $serialDir
+}
+
+Write-Host "$failures files differ"
+exit [int]($failures -gt 0)